@@ -30,7 +30,7 @@ struct SensorsHalV2_0 : public ::android::hardware::sensors::V2_X::implementatio
   Return<void> getSensorsList(V2_0::ISensors::getSensorsList_cb _hidl_cb) override {
     std::vector<V1_0::SensorInfo> sensors;
     for (const auto& sensor : mSensors) {
-      sensors.push_back(V2_1::implementation::convertToOldSensorInfo(sensor.second->getSensorInfo()));
+      sensors.push_back(V2_1::implementation::convertToOldSensorInfo(sensor->getSensorInfo()));
     }
 
     // Call the HIDL callback with the SensorInfo
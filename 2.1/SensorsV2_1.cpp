@@ -28,7 +28,7 @@ namespace implementation {
 Return<void> SensorsV2_1::getSensorsList_2_1(ISensors::getSensorsList_2_1_cb _hidl_cb) {
   std::vector<SensorInfo> sensors;
   for (const auto& sensor : mSensors) {
-    sensors.push_back(sensor.second->getSensorInfo());
+    sensors.push_back(sensor->getSensorInfo());
   }
 
   // Call the HIDL callback with the SensorInfo
@@ -41,11 +41,13 @@ Return<Result> SensorsV2_1::initialize_2_1(
   const ::android::hardware::MQDescriptorSync<V2_1::Event>& eventQueueDescriptor,
   const ::android::hardware::MQDescriptorSync<uint32_t>& wakeLockDescriptor,
   const sp<V2_1::ISensorsCallback>& sensorsCallback) {
-  auto eventQueue =
-    std::make_unique<MessageQueue<V2_1::Event, kSynchronizedReadWrite>>(eventQueueDescriptor, true /* resetPointers */);
+  using EventMessageQueueV2_1 = MessageQueue<V2_1::Event, kSynchronizedReadWrite>;
+  auto eventQueue = std::make_unique<EventMessageQueueV2_1>(eventQueueDescriptor, true /* resetPointers */);
+  std::unique_ptr<IEventQueueWriter> writer =
+    std::make_unique<bosch::sensors::EventQueueWriter<EventMessageQueueV2_1, V2_1::Event>>(eventQueue.get());
   std::unique_ptr<EventMessageQueueWrapperBase> wrapper = std::make_unique<EventMessageQueueWrapperV2_1>(eventQueue);
   mCallbackWrapper = new ISensorsCallbackWrapper(sensorsCallback);
-  return initializeBase(wrapper, wakeLockDescriptor, mCallbackWrapper);
+  return initializeBase(wrapper, writer, wakeLockDescriptor, mCallbackWrapper);
 }
 
 Return<Result> SensorsV2_1::injectSensorData_2_1(const V2_1::Event& event) {
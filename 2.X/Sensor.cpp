@@ -21,8 +21,8 @@
 #include <utils/SystemClock.h>
 
 #include <cmath>
-
-#include "iioHwctl.h"
+#include <memory>
+#include <new>
 
 namespace android {
 namespace hardware {
@@ -40,41 +40,62 @@ using ::android::hardware::sensors::V2_1::Event;
 using ::android::hardware::sensors::V2_1::SensorInfo;
 
 Sensor::Sensor(ISensorsEventCallback* callback)
-  : mIsEnabled(false), mSamplingPeriodNs(0), mLastSampleTimeNs(0), mCallback(callback) {
-  mRunThread = std::thread(startThread, this);
-}
+  : mIsEnabled(false), mMaxReportLatencyNs(0), mSamplingPeriodNs(0), mCallback(callback) {}
 
 Sensor::~Sensor() {
-  std::unique_lock<std::mutex> lock(mRunMutex);
-  mStopThread = true;
-  mIsEnabled = false;
-  mWaitCV.notify_all();
-  lock.release();
-  mRunThread.join();
+  if (mIioHub != nullptr) {
+    mIioHub->unsubscribe(this);
+    mIioHub->waitForDispatch(this);
+  } else {
+    ::rb::hardware::sensors::hwctl::SensorScheduler::get().remove(this);
+  }
 }
 
 const SensorInfo& Sensor::getSensorInfo() const { return mSensorInfo; }
 
-void Sensor::batch(int64_t samplingPeriodNs) {
+void Sensor::batch(int64_t samplingPeriodNs, int64_t maxReportLatencyNs) {
   if (samplingPeriodNs < mSensorInfo.minDelay * 1000LL) {
     samplingPeriodNs = mSensorInfo.minDelay * 1000LL;
   } else if (samplingPeriodNs > mSensorInfo.maxDelay * 1000LL) {
     samplingPeriodNs = mSensorInfo.maxDelay * 1000LL;
   }
 
+  std::unique_lock<std::mutex> lock(mRunMutex);
   if (mSamplingPeriodNs != samplingPeriodNs) {
     mSamplingPeriodNs = samplingPeriodNs;
-    // Wake up the 'run' thread to check if a new event should be generated now
-    mWaitCV.notify_all();
+    if (mIioHub != nullptr) {
+      mIioHub->setSamplingPeriod(this, mSamplingPeriodNs);
+    } else if (mIsEnabled) {
+      ::rb::hardware::sensors::hwctl::SensorScheduler::get().schedule(this, mSamplingPeriodNs);
+    }
   }
+  // Applied to the FIFO by the sampler with the next event
+  mMaxReportLatencyNs = maxReportLatencyNs;
 }
 
 void Sensor::activate(bool enable) {
   ALOGD("Sensor activate %s %d", mSensorInfo.name.c_str(), enable);
+  std::unique_lock<std::mutex> lock(mRunMutex);
   if (mIsEnabled != enable) {
-    std::unique_lock<std::mutex> lock(mRunMutex);
     mIsEnabled = enable;
-    mWaitCV.notify_all();
+    if (mIioHub != nullptr) {
+      // Sensors backed by an IIO device are sampled by the hub of the device
+      if (enable) {
+        mIioHub->subscribe(this, getSamplingPeriodNs());
+      } else {
+        mIioHub->unsubscribe(this);
+      }
+    } else if (enable) {
+      ::rb::hardware::sensors::hwctl::SensorScheduler::get().schedule(this, getSamplingPeriodNs());
+    } else {
+      ::rb::hardware::sensors::hwctl::SensorScheduler::get().schedule(this, 0);
+    }
+
+    if (!enable) {
+      // Only this final delivery may wait for an event write in progress
+      std::lock_guard<std::mutex> fifoLock(mFifoLock);
+      deliverFifo();
+    }
   }
 }
 
@@ -85,57 +106,119 @@ Result Sensor::flush() {
     return Result::BAD_VALUE;
   }
 
-  // Note: If a sensor supports batching, write all of the currently batched
-  // events for the sensor to the Event FMQ prior to writing the flush complete
-  // event.
+  // Write all of the currently batched events for the sensor to the Event FMQ
+  // prior to writing the flush complete event.
   Event ev;
   ev.sensorHandle = mSensorInfo.sensorHandle;
   ev.sensorType = SensorType::META_DATA;
   ev.u.meta.what = MetaDataEventType::META_DATA_FLUSH_COMPLETE;
-  std::vector<Event> evs{ev};
-  mCallback->postEvents(evs, isWakeUpSensor());
+  std::lock_guard<std::mutex> fifoLock(mFifoLock);
+  size_t count = mFifo.size() + 1;
+  Event* events = mCallback->beginWrite(count);
+  if (events != nullptr) {
+    mFifo.drain(events);
+    new (&events[count - 1]) Event(ev);
+    mCallback->commitWrite(count, isWakeUpSensor());
+  } else {
+    mFifo.clear();
+  }
 
   return Result::OK;
 }
 
-void Sensor::startThread(Sensor* sensor) { sensor->run(); }
+void Sensor::onDeadline(int64_t /* deadlineNs */, int64_t /* nowNs */) {
+  if (mIsEnabled) {
+    size_t count = readEvents(mReadEvents.data(), mReadEvents.size());
+    report(mReadEvents.data(), count);
+  }
+}
 
-void Sensor::run() {
-  std::unique_lock<std::mutex> runLock(mRunMutex);
-  constexpr int64_t kNanosecondsInSeconds = 1000 * 1000 * 1000;
+void Sensor::report(const Event* events, size_t count) {
+  std::lock_guard<std::mutex> lock(mFifoLock);
+  applyReportLatency();
+  if (!mFifo.isBatching()) {
+    post(events, count);
+    return;
+  }
 
-  while (!mStopThread) {
-    if (!mIsEnabled) {
-      mWaitCV.wait(runLock, [&] { return (mIsEnabled || mStopThread); });
-    } else {
-      timespec curTime;
-      clock_gettime(CLOCK_BOOTTIME, &curTime);
-      int64_t now = (curTime.tv_sec * kNanosecondsInSeconds) + curTime.tv_nsec;
-      int64_t nextSampleTime = mLastSampleTimeNs + mSamplingPeriodNs;
-
-      if (now >= nextSampleTime) {
-        mLastSampleTimeNs = now;
-        nextSampleTime = mLastSampleTimeNs + mSamplingPeriodNs;
-        mCallback->postEvents(readEvents(), isWakeUpSensor());
-      }
+  bool isDue = false;
+  for (size_t i = 0; i < count; i++) {
+    isDue = mFifo.push(events[i], events[i].timestamp) || isDue;
+  }
+  if (isDue) {
+    deliverFifo();
+  }
+}
+
+void Sensor::post(const Event* events, size_t count) {
+  Event* slots = mCallback->beginWrite(count);
+  if (slots != nullptr) {
+    std::uninitialized_copy_n(events, count, slots);
+    mCallback->commitWrite(count, isWakeUpSensor());
+  }
+}
 
-      mWaitCV.wait_for(runLock, std::chrono::nanoseconds(nextSampleTime - now));
+void Sensor::deliverFifo() {
+  size_t count = mFifo.size();
+  if (count == 0) {
+    return;
+  }
+  Event* events = mCallback->beginWrite(count);
+  if (events == nullptr) {
+    mFifo.clear();
+    return;
+  }
+  mFifo.drain(events);
+  mCallback->commitWrite(count, isWakeUpSensor());
+}
+
+void Sensor::applyReportLatency() {
+  int64_t maxReportLatencyNs = mMaxReportLatencyNs;
+  if (mFifo.getMaxReportLatency() != maxReportLatencyNs) {
+    // Deliver what was batched with the previous configuration before applying
+    // the new one. The FIFO is only allocated once batching is requested.
+    deliverFifo();
+    if (maxReportLatencyNs > 0 && mFifo.getCapacity() == 0) {
+      mFifo.setCapacity(mSensorInfo.fifoMaxEventCount);
     }
+    mFifo.setMaxReportLatency(maxReportLatencyNs);
   }
 }
 
+::rb::hardware::sensors::hwctl::PeriodicTimerStats Sensor::getSamplingStats() {
+  if (mIioHub != nullptr) {
+    return mIioHub->getStats();
+  }
+  return ::rb::hardware::sensors::hwctl::SensorScheduler::get().getStats(this);
+}
+
 bool Sensor::isWakeUpSensor() { return mSensorInfo.flags & static_cast<uint32_t>(SensorFlagBits::WAKE_UP); }
 
-std::vector<Event> Sensor::readEvents() {
-  std::vector<Event> events;
-  Event event;
+bool Sensor::canDropEvents() const {
+  return (mSensorInfo.flags & static_cast<uint32_t>(SensorFlagBits::MASK_REPORTING_MODE)) ==
+         static_cast<uint32_t>(SensorFlagBits::CONTINUOUS_MODE);
+}
+
+size_t Sensor::readEvents(Event* events, size_t count) {
+  if (count == 0) {
+    return 0;
+  }
+  Event& event = events[0];
   event.sensorHandle = mSensorInfo.sensorHandle;
   event.sensorType = mSensorInfo.type;
   event.timestamp = ::android::elapsedRealtimeNano();
   memset(&event.u, 0, sizeof(event.u));
-  readEventPayload(event.u);
-  events.push_back(event);
-  return events;
+  return 1;
+}
+
+uint32_t Sensor::getDirectReportFlags() const {
+  // Direct channels are not implemented by this HAL
+  return 0;
+}
+
+int64_t Sensor::getSamplingPeriodNs() const {
+  // Use the slowest rate until the framework has configured the sensor
+  return mSamplingPeriodNs > 0 ? mSamplingPeriodNs : mSensorInfo.maxDelay * 1000LL;
 }
 
 Result Sensor::setOperationMode(OperationMode mode) {
@@ -155,28 +238,40 @@ Result Sensor::injectEvent(const Event& event) {
   return Result::INVALID_OPERATION;
 }
 
-void Sensor::readEventPayload(EventPayload& payload) {
-  std::string values;
-  if (0 == ::rb::hardware::sensors::hwctl::readFromFile(&mIioFileName, values)) {
-    fillPayload(payload, values);
-  } else {
-    ALOGE("Sensor readEventPayload failed");
+void Sensor::onSample(const ::rb::hardware::sensors::hwctl::IioSample& sample) {
+  std::lock_guard<std::mutex> lock(mFifoLock);
+  applyReportLatency();
+  if (mFifo.isBatching()) {
+    Event event;
+    fillEvent(event, sample);
+    if (mFifo.push(event, event.timestamp)) {
+      deliverFifo();
+    }
+    return;
   }
-}
 
-void Sensor::fillPayload(EventPayload& payload, std::string& data) {
-  std::istringstream iss(data);
-  std::vector<std::string> results(std::istream_iterator<std::string>{iss}, std::istream_iterator<std::string>());
-  if (results.size() > 2) {
-    payload.vec3.x = ::atof(results[0].c_str()) * mSensorInfo.resolution;
-    payload.vec3.y = ::atof(results[1].c_str()) * mSensorInfo.resolution;
-    payload.vec3.z = ::atof(results[2].c_str()) * mSensorInfo.resolution;
-    payload.vec3.status = SensorStatus::ACCURACY_HIGH;
-  } else {
-    ALOGE("Sensor fillPayload failed");
+  // Build the event directly in the event queue
+  Event* event = mCallback->beginWrite(1);
+  if (event != nullptr) {
+    fillEvent(*new (event) Event(), sample);
+    mCallback->commitWrite(1, isWakeUpSensor());
   }
 }
 
+void Sensor::fillEvent(Event& event, const ::rb::hardware::sensors::hwctl::IioSample& sample) {
+  event.sensorHandle = mSensorInfo.sensorHandle;
+  event.sensorType = mSensorInfo.type;
+  event.timestamp = sample.timestamp;
+  fillPayload(event.u, &sample.values[mIioSlot]);
+}
+
+void Sensor::fillPayload(EventPayload& payload, const int64_t* data) {
+  payload.vec3.x = data[0] * mSensorInfo.resolution;
+  payload.vec3.y = data[1] * mSensorInfo.resolution;
+  payload.vec3.z = data[2] * mSensorInfo.resolution;
+  payload.vec3.status = SensorStatus::ACCURACY_HIGH;
+}
+
 }  // namespace implementation
 }  // namespace V2_X
 }  // namespace sensors
@@ -21,13 +21,16 @@
 #include <android/hardware/sensors/1.0/types.h>
 #include <android/hardware/sensors/2.1/types.h>
 
-#include <condition_variable>
+#include <array>
+#include <atomic>
 #include <memory>
 #include <mutex>
 #include <string>
-#include <thread>
 #include <vector>
 
+#include "eventFifo.h"
+#include "iioHub.h"
+
 namespace android {
 namespace hardware {
 namespace sensors {
@@ -40,9 +43,18 @@ public:
 
   virtual ~ISensorsEventCallback(){};
   virtual void postEvents(const std::vector<Event>& events, bool wakeup) = 0;
+
+  /**
+   * Reserves count events to be built in place by the caller. Returns nullptr
+   * if they cannot be written; otherwise commitWrite() must follow, writes of
+   * other sensors are blocked in between.
+   */
+  virtual Event* beginWrite(size_t count) = 0;
+  virtual void commitWrite(size_t count, bool wakeup) = 0;
 };
 
-class Sensor {
+class Sensor : public ::rb::hardware::sensors::hwctl::ISampleCallback,
+               public ::rb::hardware::sensors::hwctl::IScheduledJob {
 public:
   using OperationMode = ::android::hardware::sensors::V1_0::OperationMode;
   using Result = ::android::hardware::sensors::V1_0::Result;
@@ -55,7 +67,7 @@ public:
   virtual ~Sensor();
 
   const SensorInfo& getSensorInfo() const;
-  void batch(int64_t samplingPeriodNs);
+  void batch(int64_t samplingPeriodNs, int64_t maxReportLatencyNs);
   virtual void activate(bool enable);
   Result flush();
 
@@ -63,31 +75,66 @@ public:
   bool supportsDataInjection() const;
   Result injectEvent(const Event& event);
 
+  void onSample(const ::rb::hardware::sensors::hwctl::IioSample& sample) override;
+  void onDeadline(int64_t deadlineNs, int64_t nowNs) override;
+
+  ::rb::hardware::sensors::hwctl::PeriodicTimerStats getSamplingStats();
+
+  /**
+   * Returns true if events of the sensor may be dropped, oldest first, while
+   * the event queue is backed up. By default only the samples of continuous
+   * sensors are, since the next samples supersede them.
+   */
+  virtual bool canDropEvents() const;
+
 protected:
-  void run();
-  virtual std::vector<Event> readEvents();
-  static void startThread(Sensor* sensor);
+  /**
+   * Writes up to count events into the storage at events and returns the
+   * number written. Called from the sampler only.
+   */
+  virtual size_t readEvents(Event* events, size_t count);
+  // Posts the events or queues them in the FIFO while batching
+  void report(const Event* events, size_t count);
+  // Writes the events to the event queue in one transaction
+  void post(const Event* events, size_t count);
+  // Posts all batched events, must be called with mFifoLock held
+  void deliverFifo();
+  // Applies a new maximum report latency, must be called with mFifoLock held
+  void applyReportLatency();
+
+  void fillEvent(Event& event, const ::rb::hardware::sensors::hwctl::IioSample& sample);
 
   bool isWakeUpSensor();
+  int64_t getSamplingPeriodNs() const;
+  // SensorInfo flags advertising the direct channels the sensor supports
+  uint32_t getDirectReportFlags() const;
 
-  void readEventPayload(EventPayload&);
-  void fillPayload(EventPayload& payload, std::string& data);
+  void fillPayload(EventPayload& payload, const int64_t* data);
 
-  bool mIsEnabled;
+  // Read by the sampler without locking, written under mRunMutex
+  std::atomic_bool mIsEnabled;
+  std::atomic_int64_t mMaxReportLatencyNs;
+  // Protected by mRunMutex
   int64_t mSamplingPeriodNs;
-  int64_t mLastSampleTimeNs;
   SensorInfo mSensorInfo;
   int32_t* mMinDelay = &mSensorInfo.minDelay;
   int32_t* mMaxDelay = &mSensorInfo.maxDelay;
 
-  std::atomic_bool mStopThread;
-  std::condition_variable mWaitCV;
   std::mutex mRunMutex;
-  std::thread mRunThread;
+
+  // Events held back while batching, protected by mFifoLock. Only the sampler
+  // applies a new mMaxReportLatencyNs to the FIFO.
+  ::rb::hardware::sensors::hwctl::EventFifo<Event> mFifo;
+  std::mutex mFifoLock;
 
   ISensorsEventCallback* mCallback;
 
-  std::string mIioFileName;
+  std::shared_ptr<::rb::hardware::sensors::hwctl::IioHub> mIioHub;
+  size_t mIioSlot = 0;
+
+  // Storage for readEvents(), reused by every deadline of the sampler
+  static constexpr size_t kMaxReadEvents = 16;
+  std::array<Event, kMaxReadEvents> mReadEvents;
 };
 
 }  // namespace implementation
@@ -24,15 +24,27 @@
 #include <hardware_legacy/power.h>
 #include <hidl/MQDescriptor.h>
 #include <hidl/Status.h>
+#include <inttypes.h>
 #include <log/log.h>
+#include <stdio.h>
 
+#include <algorithm>
 #include <atomic>
+#include <condition_variable>
+#include <iterator>
 #include <memory>
 #include <thread>
+#include <vector>
 
 #include "BoschSensors.h"
 #include "EventMessageQueueWrapper.h"
+#include "EventQueueWriter.h"
 #include "Sensor.h"
+#include "SensorTable.h"
+#include "pendingEvents.h"
+#include "periodicTimer.h"
+#include "signalCoalescer.h"
+#include "wakeLock.h"
 
 namespace android {
 namespace hardware {
@@ -54,39 +66,58 @@ struct Sensors : public ISensorsInterface, public ISensorsEventCallback {
   using SensorType = ::android::hardware::sensors::V2_1::SensorType;
   using EventMessageQueue = MessageQueue<Event, kSynchronizedReadWrite>;
   using WakeLockMessageQueue = MessageQueue<uint32_t, kSynchronizedReadWrite>;
+  using IEventQueueWriter = bosch::sensors::IEventQueueWriter<V2_1::Event>;
 
   static constexpr const char* kWakeLockName = "SensorsHAL_WAKEUP";
+  // Events held while the Event FMQ is full, at least about 40 ms of two
+  // sensors at the highest rate. The ring grows to the FIFO reserved by all
+  // sensors together.
+  static constexpr size_t kPendingEventsCapacity = 256;
 
   Sensors()
     : mEventQueueFlag(nullptr),
-      mNextHandle(1),
-      mOutstandingWakeUpEvents(0),
+      mPendingEvents(kPendingEventsCapacity),
+      mIsWritePending(false),
+      mPendingWritesRun(false),
       mReadWakeLockQueueRun(false),
-      mAutoReleaseWakeLockTime(0),
-      mHasWakeLock(false) {
-    AddSensor<bosch::sensors::Smi240Accel<Sensor, ISensorsEventCallback, SensorType>>();
-    AddSensor<bosch::sensors::Smi240Gyro<Sensor, ISensorsEventCallback, SensorType>>();
+      mWakeLock(kWakeLockName, static_cast<int64_t>(SensorTimeout::WAKE_LOCK_SECONDS) * 1000 * 1000 * 1000),
+      mSignalCoalescer([this] { signalEventQueue(); }) {
+    for (const auto& device : bosch::sensors::getSmi240Devices()) {
+      AddSensor<bosch::sensors::Smi240Accel<Sensor, ISensorsEventCallback, SensorType>>(device);
+      AddSensor<bosch::sensors::Smi240Gyro<Sensor, ISensorsEventCallback, SensorType>>(device);
+    }
+
+    // Every advertised fifoReservedEventCount must fit even if all sensors
+    // batch at once
+    size_t fifoReservedEvents = 0;
+    for (const auto& sensor : mSensors) {
+      fifoReservedEvents += sensor->getSensorInfo().fifoReservedEventCount;
+    }
+    mPendingEvents.reserve(fifoReservedEvents);
   }
 
   virtual ~Sensors() {
-    deleteEventFlag();
-    mReadWakeLockQueueRun = false;
-    mWakeLockThread.join();
+    stopPendingWritesThread();
+    {
+      std::lock_guard<std::mutex> lock(mWriteLock);
+      deleteEventFlag();
+    }
+    stopReadWakeLockThread();
   }
 
   // Methods from ::android::hardware::sensors::V2_0::ISensors follow.
   Return<Result> setOperationMode(OperationMode mode) override {
     Result res = Result::OK;
-    for (auto sensor : mSensors) {
-      res = sensor.second->setOperationMode(mode);
+    for (const auto& sensor : mSensors) {
+      res = sensor->setOperationMode(mode);
     }
     return res;
   }
 
   Return<Result> activate(int32_t sensorHandle, bool enabled) override {
-    auto sensor = mSensors.find(sensorHandle);
-    if (sensor != mSensors.end()) {
-      sensor->second->activate(enabled);
+    auto* sensor = mSensors.find(sensorHandle);
+    if (sensor != nullptr) {
+      sensor->activate(enabled);
       return Result::OK;
     }
     return Result::BAD_VALUE;
@@ -96,40 +127,55 @@ struct Sensors : public ISensorsInterface, public ISensorsEventCallback {
                             const ::android::hardware::MQDescriptorSync<uint32_t>& wakeLockDescriptor,
                             const sp<ISensorsCallback>& sensorsCallback) override {
     auto eventQueue = std::make_unique<EventMessageQueue>(eventQueueDescriptor, true /* resetPointers */);
+    // V2_1 events are built in place in the V1_0 queue, which has the same
+    // layout, instead of being converted by the wrapper
+    std::unique_ptr<IEventQueueWriter> writer =
+      std::make_unique<bosch::sensors::EventQueueWriter<EventMessageQueue, V2_1::Event>>(eventQueue.get());
     std::unique_ptr<V2_1::implementation::EventMessageQueueWrapperBase> wrapper =
       std::make_unique<V2_1::implementation::EventMessageQueueWrapperV1_0>(eventQueue);
-    return initializeBase(wrapper, wakeLockDescriptor, sensorsCallback);
+    return initializeBase(wrapper, writer, wakeLockDescriptor, sensorsCallback);
   }
 
+  /**
+   * eventWriter writes to the queue owned by eventQueue.
+   */
   Return<Result> initializeBase(std::unique_ptr<V2_1::implementation::EventMessageQueueWrapperBase>& eventQueue,
+                                std::unique_ptr<IEventQueueWriter>& eventWriter,
                                 const ::android::hardware::MQDescriptorSync<uint32_t>& wakeLockDescriptor,
                                 const sp<ISensorsCallback>& sensorsCallback) {
     Result result = Result::OK;
 
     // Ensure that all sensors are disabled
-    for (auto sensor : mSensors) {
-      sensor.second->activate(false /* enable */);
+    for (const auto& sensor : mSensors) {
+      sensor->activate(false /* enable */);
     }
 
-    // Stop the Wake Lock thread if it is currently running
-    if (mReadWakeLockQueueRun.load()) {
-      mReadWakeLockQueueRun = false;
-      mWakeLockThread.join();
-    }
+    // Stop the Wake Lock and pending writes threads if they are currently
+    // running
+    stopReadWakeLockThread();
+    stopPendingWritesThread();
 
     // Save a reference to the callback
     mCallback = sensorsCallback;
 
-    // Save the event queue.
-    mEventQueue = std::move(eventQueue);
-
-    // Ensure that any existing EventFlag is properly deleted
-    deleteEventFlag();
-
-    // Create the EventFlag that is used to signal to the framework that sensor
-    // events have been written to the Event FMQ
-    if (EventFlag::createEventFlag(mEventQueue->getEventFlagWord(), &mEventQueueFlag) != OK) {
-      result = Result::BAD_VALUE;
+    // Save the event queue. The EventFlag is replaced under the write lock as
+    // well, since deferred signals are sent from the coalescer thread.
+    {
+      std::lock_guard<std::mutex> lock(mWriteLock);
+      mEventWriter = std::move(eventWriter);
+      mEventQueue = std::move(eventQueue);
+      mSignalCoalescer.clear();
+      // Pending events belong to the previous framework session
+      updateWakeLock(0 /* eventsWritten */, mPendingEvents.clear());
+
+      // Ensure that any existing EventFlag is properly deleted
+      deleteEventFlag();
+
+      // Create the EventFlag that is used to signal to the framework that sensor
+      // events have been written to the Event FMQ
+      if (EventFlag::createEventFlag(mEventQueue->getEventFlagWord(), &mEventQueueFlag) != OK) {
+        result = Result::BAD_VALUE;
+      }
     }
 
     // Create the Wake Lock FMQ that is used by the framework to communicate
@@ -145,35 +191,73 @@ struct Sensors : public ISensorsInterface, public ISensorsEventCallback {
     mReadWakeLockQueueRun = true;
     mWakeLockThread = std::thread(startReadWakeLockThread, this);
 
+    // Start the thread to write the events that did not fit into the Event FMQ
+    if (mEventQueueFlag != nullptr) {
+      mPendingWritesRun = true;
+      mPendingWritesThread = std::thread(startPendingWritesThread, this);
+    }
+
     return result;
   }
 
-  Return<Result> batch(int32_t sensorHandle, int64_t samplingPeriodNs, int64_t /* maxReportLatencyNs */) override {
-    auto sensor = mSensors.find(sensorHandle);
-    if (sensor != mSensors.end()) {
-      sensor->second->batch(samplingPeriodNs);
+  Return<Result> batch(int32_t sensorHandle, int64_t samplingPeriodNs, int64_t maxReportLatencyNs) override {
+    auto* sensor = mSensors.find(sensorHandle);
+    if (sensor != nullptr) {
+      sensor->batch(samplingPeriodNs, maxReportLatencyNs);
       return Result::OK;
     }
     return Result::BAD_VALUE;
   }
 
   Return<Result> flush(int32_t sensorHandle) override {
-    auto sensor = mSensors.find(sensorHandle);
-    if (sensor != mSensors.end()) {
-      return sensor->second->flush();
+    auto* sensor = mSensors.find(sensorHandle);
+    if (sensor != nullptr) {
+      return sensor->flush();
     }
     return Result::BAD_VALUE;
   }
 
   Return<Result> injectSensorData(const Event& event) override {
-    auto sensor = mSensors.find(event.sensorHandle);
-    if (sensor != mSensors.end()) {
-      return sensor->second->injectEvent(V2_1::implementation::convertToNewEvent(event));
+    auto* sensor = mSensors.find(event.sensorHandle);
+    if (sensor != nullptr) {
+      return sensor->injectEvent(V2_1::implementation::convertToNewEvent(event));
     }
 
     return Result::BAD_VALUE;
   }
 
+  Return<void> debug(const hidl_handle& fd, const hidl_vec<hidl_string>& /* args */) override {
+    if (fd.getNativeHandle() == nullptr || fd->numFds < 1) {
+      ALOGE("%s: missing fd for writing", __FUNCTION__);
+      return Void();
+    }
+
+    ::rb::hardware::sensors::hwctl::WakeLockStats stats = mWakeLock.getStats();
+    dprintf(fd->data[0], "Wake lock: %s, acquisitions %" PRIu64 " (%.3f/s), releases %" PRIu64
+            ", auto releases %" PRIu64 "\n",
+            stats.isHeld ? "held" : "released", stats.acquisitions, stats.acquisitionRateHz, stats.releases,
+            stats.autoReleases);
+
+    ::rb::hardware::sensors::hwctl::SignalCoalescerStats signalStats = mSignalCoalescer.getStats();
+    dprintf(fd->data[0], "Event FMQ: events %" PRIu64 ", signals %" PRIu64 " (%.3f/s), signal delay mean %" PRId64
+            " ns, max %" PRId64 " ns\n",
+            signalStats.events, signalStats.signals, signalStats.signalRateHz, signalStats.meanDelayNs,
+            signalStats.maxDelayNs);
+
+    for (const auto& sensor : mSensors) {
+      ::rb::hardware::sensors::hwctl::PeriodicTimerStats samplingStats = sensor->getSamplingStats();
+      dprintf(fd->data[0], "Sensor %s: achieved rate %.3f Hz, lateness mean %" PRId64 " ns, max %" PRId64
+              " ns, samples %" PRIu64 ", skipped %" PRIu64 "\n",
+              sensor->getSensorInfo().name.c_str(), samplingStats.achievedRateHz, samplingStats.meanLatenessNs,
+              samplingStats.maxLatenessNs, samplingStats.samples, samplingStats.skipped);
+    }
+
+    std::lock_guard<std::mutex> lock(mWriteLock);
+    dprintf(fd->data[0], "Pending events: %zu, dropped %" PRIu64 ", dropped undroppable %" PRIu64 "\n",
+            mPendingEvents.size(), mPendingEvents.getDropped(), mPendingEvents.getUndroppableDropped());
+    return Void();
+  }
+
   Return<void> registerDirectChannel(const SharedMemInfo& /* mem */,
                                      V2_0::ISensors::registerDirectChannel_cb _hidl_cb) override {
     _hidl_cb(Result::INVALID_OPERATION, -1 /* channelHandle */);
@@ -189,14 +273,58 @@ struct Sensors : public ISensorsInterface, public ISensorsEventCallback {
   }
 
   void postEvents(const std::vector<V2_1::Event>& events, bool wakeup) override {
-    std::lock_guard<std::mutex> lock(mWriteLock);
-    if (mEventQueue->write(events)) {
-      mEventQueueFlag->wake(static_cast<uint32_t>(EventQueueFlagBits::READ_AND_PROCESS));
+    V2_1::Event* slots = beginWrite(events.size());
+    if (slots != nullptr) {
+      std::uninitialized_copy(events.begin(), events.end(), slots);
+      commitWrite(events.size(), wakeup);
+    }
+  }
+
+  V2_1::Event* beginWrite(size_t count) override {
+    mWriteLock.lock();
+    V2_1::Event* events = nullptr;
+    if (mEventWriter != nullptr && count > 0) {
+      // Once events are pending, later ones queue up behind them to keep the
+      // order
+      if (mPendingEvents.empty()) {
+        events = mEventWriter->beginWrite(count);
+      }
+      mIsWritePending = events == nullptr;
+      if (mIsWritePending) {
+        // Grows once to the largest write and is reused afterwards
+        if (mPendingStaging.size() < count) {
+          mPendingStaging.resize(count);
+        }
+        events = mPendingStaging.data();
+      }
+    }
+    if (events == nullptr) {
+      mWriteLock.unlock();
+    }
+    mWriteEvents = events;
+    return events;
+  }
+
+  void commitWrite(size_t count, bool wakeup) override {
+    std::lock_guard<std::mutex> lock(mWriteLock, std::adopt_lock);
+    if (mIsWritePending) {
+      queuePendingEvents(mWriteEvents, count, wakeup);
+      return;
+    }
+
+    // WAKE_UP events and flush completions are not held back
+    bool urgent = wakeup || std::any_of(mWriteEvents, mWriteEvents + count, [](const V2_1::Event& event) {
+                    return event.sensorType == SensorType::META_DATA;
+                  });
+    if (mEventWriter->commitWrite()) {
+      if (mSignalCoalescer.onWrite(count, urgent)) {
+        mEventQueueFlag->wake(static_cast<uint32_t>(EventQueueFlagBits::READ_AND_PROCESS));
+      }
 
       if (wakeup) {
         // Keep track of the number of outstanding WAKE_UP events in order to
         // properly hold a wake lock until the framework has secured a wake lock
-        updateWakeLock(events.size(), 0 /* eventsHandled */);
+        updateWakeLock(count, 0 /* eventsHandled */);
       }
     }
   }
@@ -205,10 +333,12 @@ protected:
   /**
    * Add a new sensor
    */
-  template <class Sensor>
-  void AddSensor() {
-    std::shared_ptr<Sensor> sensor = std::make_shared<Sensor>(mNextHandle++ /* sensorHandle */, this /* callback */);
-    mSensors[sensor->getSensorInfo().sensorHandle] = sensor;
+  template <class Sensor, typename... Args>
+  void AddSensor(Args&&... args) {
+    std::shared_ptr<Sensor> sensor =
+      std::make_shared<Sensor>(mSensors.getNextHandle() /* sensorHandle */, this /* callback */,
+                               std::forward<Args>(args)...);
+    mSensors.add(sensor);
     ALOGD("AddSensor[%d] %s", sensor->getSensorInfo().sensorHandle, sensor->getSensorInfo().name.c_str());
   }
 
@@ -222,70 +352,172 @@ protected:
     }
   }
 
+  /**
+   * Signals the framework to read the Event FMQ, for the signals deferred by
+   * mSignalCoalescer
+   */
+  void signalEventQueue() {
+    std::lock_guard<std::mutex> lock(mWriteLock);
+    if (mEventQueueFlag != nullptr) {
+      mEventQueueFlag->wake(static_cast<uint32_t>(EventQueueFlagBits::READ_AND_PROCESS));
+    }
+  }
+
+  /**
+   * Queues events that do not fit into the Event FMQ for the pending writes
+   * thread. Must be called with mWriteLock held.
+   */
+  void queuePendingEvents(const V2_1::Event* events, size_t count, bool wakeup) {
+    bool wasEmpty = mPendingEvents.empty();
+    size_t droppedWakeUps = mPendingEvents.push(events, count, wakeup, [this](const V2_1::Event& event) {
+      const auto* sensor = mSensors.find(event.sensorHandle);
+      return event.sensorType != SensorType::META_DATA && sensor != nullptr && sensor->canDropEvents();
+    });
+    // Pending WAKE_UP events hold the wake lock as well, until they are
+    // handled by the framework or dropped. Queued ones may also be evicted by
+    // a batch of non wake-up events.
+    updateWakeLock(wakeup ? count : 0, droppedWakeUps);
+    if (wasEmpty) {
+      mPendingWritesCV.notify_one();
+    }
+  }
+
+  static void startPendingWritesThread(Sensors* sensors) { sensors->writePendingEvents(); }
+
+  void stopPendingWritesThread() {
+    if (!mPendingWritesThread.joinable()) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mWriteLock);
+      mPendingWritesRun = false;
+      mPendingWritesCV.notify_one();
+      mEventQueueFlag->wake(static_cast<uint32_t>(EventQueueFlagBits::EVENTS_READ));
+    }
+    mPendingWritesThread.join();
+  }
+
+  /**
+   * Function to write the pending events to the Event FMQ as the framework
+   * makes room in it
+   */
+  void writePendingEvents() {
+    // Bounds the wait in case the framework does not signal EVENTS_READ
+    constexpr int64_t kEventsReadTimeoutNs = 100 * 1000 * 1000;  // 100 ms
+    std::unique_lock<std::mutex> lock(mWriteLock);
+    while (mPendingWritesRun) {
+      if (mPendingEvents.empty()) {
+        mPendingWritesCV.wait(lock);
+        continue;
+      }
+
+      size_t count = 0;
+      const V2_1::Event* events = mPendingEvents.front(&count);
+      count = std::min(count, mEventQueue->availableToWrite());
+      if (count > 0 && mEventQueue->write(events, count)) {
+        mPendingEvents.pop(count);
+        mEventQueueFlag->wake(static_cast<uint32_t>(EventQueueFlagBits::READ_AND_PROCESS));
+        continue;
+      }
+
+      // The EventFlag is only replaced while this thread is stopped
+      EventFlag* eventQueueFlag = mEventQueueFlag;
+      lock.unlock();
+      uint32_t eventFlagState = 0;
+      eventQueueFlag->wait(static_cast<uint32_t>(EventQueueFlagBits::EVENTS_READ), &eventFlagState,
+                           kEventsReadTimeoutNs);
+      lock.lock();
+    }
+  }
+
   static void startReadWakeLockThread(Sensors* sensors) { sensors->readWakeLockFMQ(); }
 
+  void stopReadWakeLockThread() {
+    if (!mWakeLockThread.joinable()) {
+      return;
+    }
+    mReadWakeLockQueueRun = false;
+    mWakeLock.wakeWaiters();
+    // Unblock a pending read. A full queue has data to read already.
+    if (mWakeLockQueue != nullptr && mWakeLockQueue->availableToWrite() > 0) {
+      uint32_t kZero = 0;
+      mWakeLockQueue->writeBlocking(&kZero, 1 /* count */, 0 /* readNotification */,
+                                    static_cast<uint32_t>(WakeLockQueueFlagBits::DATA_WRITTEN));
+    }
+    mWakeLockThread.join();
+  }
+
   /**
    * Function to read the Wake Lock FMQ and release the wake lock when
    * appropriate
    */
   void readWakeLockFMQ() {
+    int64_t deadlineNs = 0;
     while (mReadWakeLockQueueRun.load()) {
-      constexpr int64_t kReadTimeoutNs = 500 * 1000 * 1000;  // 500 ms
       uint32_t eventsHandled = 0;
 
-      // Read events from the Wake Lock FMQ. Timeout after a reasonable amount
-      // of time to ensure that any held wake lock is able to be released if it
-      // is held for too long.
-      mWakeLockQueue->readBlocking(&eventsHandled, 1 /* count */, 0 /* readNotification */,
-                                   static_cast<uint32_t>(WakeLockQueueFlagBits::DATA_WRITTEN), kReadTimeoutNs);
-      updateWakeLock(0 /* eventsWritten */, eventsHandled);
+      if (deadlineNs == 0) {
+        // The wake lock is released, so no WAKE_UP event is outstanding. Park
+        // until one is written instead of polling the Wake Lock FMQ. Counts
+        // still queued are accounted first; the wake lock discards the ones
+        // of events it auto released, even if they are read after the next
+        // acquisition.
+        drainWakeLockFMQ();
+        mWakeLock.waitUntilHeld(mReadWakeLockQueueRun);
+      } else {
+        // Read events from the Wake Lock FMQ until the wake lock is due for
+        // release. A zero timeout would block forever.
+        int64_t timeoutNs = std::max<int64_t>(deadlineNs - ::rb::hardware::sensors::hwctl::PeriodicTimer::now(), 1);
+        mWakeLockQueue->readBlocking(&eventsHandled, 1 /* count */, 0 /* readNotification */,
+                                     static_cast<uint32_t>(WakeLockQueueFlagBits::DATA_WRITTEN), timeoutNs);
+      }
+      deadlineNs = updateWakeLock(0 /* eventsWritten */, eventsHandled);
     }
   }
 
   /**
-   * Responsible for acquiring and releasing a wake lock when there are
-   * unhandled WAKE_UP events
+   * Accounts all counts in the Wake Lock FMQ without blocking.
    */
-  void updateWakeLock(int32_t eventsWritten, int32_t eventsHandled) {
-    std::lock_guard<std::mutex> lock(mWakeLockLock);
-    int32_t newVal = mOutstandingWakeUpEvents + eventsWritten - eventsHandled;
-    if (newVal < 0) {
-      mOutstandingWakeUpEvents = 0;
-    } else {
-      mOutstandingWakeUpEvents = newVal;
-    }
-
-    if (eventsWritten > 0) {
-      // Update the time at which the last WAKE_UP event was sent
-      mAutoReleaseWakeLockTime =
-        ::android::uptimeMillis() + static_cast<uint32_t>(SensorTimeout::WAKE_LOCK_SECONDS) * 1000;
-    }
-
-    if (!mHasWakeLock && mOutstandingWakeUpEvents > 0 && acquire_wake_lock(PARTIAL_WAKE_LOCK, kWakeLockName) == 0) {
-      mHasWakeLock = true;
-    } else if (mHasWakeLock) {
-      // Check if the wake lock should be released automatically if
-      // SensorTimeout::WAKE_LOCK_SECONDS has elapsed since the last WAKE_UP
-      // event was written to the Wake Lock FMQ.
-      if (::android::uptimeMillis() > mAutoReleaseWakeLockTime) {
-        ALOGD(
-          "No events read from wake lock FMQ for %d seconds, auto releasing "
-          "wake lock",
-          SensorTimeout::WAKE_LOCK_SECONDS);
-        mOutstandingWakeUpEvents = 0;
+  void drainWakeLockFMQ() {
+    uint32_t eventsHandled[16];
+    size_t available;
+    while ((available = mWakeLockQueue->availableToRead()) > 0) {
+      size_t count = std::min(available, std::size(eventsHandled));
+      if (!mWakeLockQueue->read(eventsHandled, count)) {
+        break;
       }
-
-      if (mOutstandingWakeUpEvents == 0 && release_wake_lock(kWakeLockName) == 0) {
-        mHasWakeLock = false;
+      int64_t total = 0;
+      for (size_t i = 0; i < count; i++) {
+        total += eventsHandled[i];
       }
+      updateWakeLock(0 /* eventsWritten */, static_cast<int32_t>(std::min<int64_t>(total, INT32_MAX)));
     }
   }
 
+  /**
+   * Responsible for acquiring and releasing a wake lock when there are
+   * unhandled WAKE_UP events. Returns the next release deadline, see
+   * WakeLock::update().
+   */
+  int64_t updateWakeLock(int32_t eventsWritten, int32_t eventsHandled) {
+    return mWakeLock.update(eventsWritten, eventsHandled);
+  }
+
   /**
    * The Event FMQ where sensor events are written
    */
   std::unique_ptr<V2_1::implementation::EventMessageQueueWrapperBase> mEventQueue;
 
+  /**
+   * Writer building events in place in the Event FMQ, protected by mWriteLock
+   */
+  std::unique_ptr<IEventQueueWriter> mEventWriter;
+
+  /**
+   * Events of the write in progress, protected by mWriteLock
+   */
+  V2_1::Event* mWriteEvents = nullptr;
+
   /**
    * The Wake Lock FMQ that is read to determine when the framework has handled
    * WAKE_UP events
@@ -304,14 +536,9 @@ protected:
   sp<ISensorsCallback> mCallback;
 
   /**
-   * A map of the available sensors
+   * The available sensors, indexed by handle
    */
-  std::map<int32_t, std::shared_ptr<Sensor>> mSensors;
-
-  /**
-   * The next available sensor handle
-   */
-  int32_t mNextHandle;
+  bosch::sensors::SensorTable<Sensor> mSensors;
 
   /**
    * Lock to protect writes to the FMQs
@@ -319,15 +546,21 @@ protected:
   std::mutex mWriteLock;
 
   /**
-   * Lock to protect acquiring and releasing the wake lock
+   * Events waiting for room in the Event FMQ, the staging buffer the write in
+   * progress is built in if it goes there, and whether it does. Protected by
+   * mWriteLock.
    */
-  std::mutex mWakeLockLock;
+  ::rb::hardware::sensors::hwctl::PendingEvents<V2_1::Event> mPendingEvents;
+  std::vector<V2_1::Event> mPendingStaging;
+  bool mIsWritePending;
 
   /**
-   * Track the number of WAKE_UP events that have not been handled by the
-   * framework
+   * A thread to write the pending events, and the condition it waits on for
+   * them. mPendingWritesRun is protected by mWriteLock.
    */
-  uint32_t mOutstandingWakeUpEvents;
+  std::thread mPendingWritesThread;
+  std::condition_variable mPendingWritesCV;
+  bool mPendingWritesRun;
 
   /**
    * A thread to read the Wake Lock FMQ
@@ -340,14 +573,17 @@ protected:
   std::atomic_bool mReadWakeLockQueueRun;
 
   /**
-   * Track the time when the wake lock should automatically be released
+   * Wake lock held while WAKE_UP events have not been handled by the
+   * framework
    */
-  int64_t mAutoReleaseWakeLockTime;
+  ::rb::hardware::sensors::hwctl::WakeLock mWakeLock;
 
   /**
-   * Flag to indicate if a wake lock has been acquired
+   * Merges the signals of events written close together, so that the
+   * framework is woken up once for them. Declared last, so that its thread
+   * stops before the members it signals with are destroyed.
    */
-  bool mHasWakeLock;
+  ::rb::hardware::sensors::hwctl::SignalCoalescer mSignalCoalescer;
 };
 
 }  // namespace implementation
@@ -19,9 +19,11 @@
 
 #include <log/log.h>
 
+#include <algorithm>
 #include <cmath>
+#include <memory>
+#include <new>
 
-#include "iioHwctl.h"
 #include "utils/SystemClock.h"
 
 using ::ndk::ScopedAStatus;
@@ -32,42 +34,89 @@ namespace hardware {
 namespace sensors {
 
 Sensor::Sensor(ISensorsEventCallback* callback)
-  : mIsEnabled(false), mSamplingPeriodNs(0), mLastSampleTimeNs(0), mCallback(callback) {
-  mRunThread = std::thread(startThread, this);
-}
+  : mIsEnabled(false), mMaxReportLatencyNs(0), mSamplingPeriodNs(0), mCallback(callback) {}
 
 Sensor::~Sensor() {
-  std::unique_lock<std::mutex> lock(mRunMutex);
-  mStopThread = true;
-  mIsEnabled = false;
-  mWaitCV.notify_all();
-  lock.release();
-  mRunThread.join();
+  if (mIioHub != nullptr) {
+    mIioHub->unsubscribe(this);
+    mIioHub->waitForDispatch(this);
+  } else {
+    ::rb::hardware::sensors::hwctl::SensorScheduler::get().remove(this);
+  }
 }
 
 const SensorInfo& Sensor::getSensorInfo() const { return mSensorInfo; }
 
-void Sensor::batch(int64_t samplingPeriodNs) {
+void Sensor::batch(int64_t samplingPeriodNs, int64_t maxReportLatencyNs) {
   if (samplingPeriodNs < mSensorInfo.minDelayUs * 1000LL) {
     samplingPeriodNs = mSensorInfo.minDelayUs * 1000LL;
   } else if (samplingPeriodNs > mSensorInfo.maxDelayUs * 1000LL) {
     samplingPeriodNs = mSensorInfo.maxDelayUs * 1000LL;
   }
 
+  std::unique_lock<std::mutex> lock(mRunMutex);
   if (mSamplingPeriodNs != samplingPeriodNs) {
     mSamplingPeriodNs = samplingPeriodNs;
-    // Wake up the 'run' thread to check if a new event should be generated now
-    mWaitCV.notify_all();
+    updateSampling();
   }
+  // Applied to the FIFO by the sampler with the next event
+  mMaxReportLatencyNs = maxReportLatencyNs;
 }
 
 void Sensor::activate(bool enable) {
   ALOGD("Sensor activate %s %d", mSensorInfo.name.c_str(), enable);
+  std::unique_lock<std::mutex> lock(mRunMutex);
   if (mIsEnabled != enable) {
-    std::unique_lock<std::mutex> lock(mRunMutex);
     mIsEnabled = enable;
-    mWaitCV.notify_all();
+    updateSampling();
+
+    if (!enable) {
+      // Only this final delivery may wait for an event write in progress
+      std::lock_guard<std::mutex> fifoLock(mFifoLock);
+      deliverFifo();
+    }
+  }
+}
+
+void Sensor::configDirectReport(const std::shared_ptr<::rb::hardware::sensors::hwctl::DirectChannel>& channel,
+                                int32_t reportToken, int64_t periodNs) {
+  if (periodNs > 0) {
+    periodNs = std::max(periodNs, static_cast<int64_t>(mSensorInfo.minDelayUs) * 1000);
+  }
+
+  std::unique_lock<std::mutex> lock(mRunMutex);
+  mDirectReports.configure(channel, reportToken, periodNs);
+  updateSampling();
+}
+
+void Sensor::updateSampling() {
+  int64_t samplingPeriodNs = mIsEnabled ? getSamplingPeriodNs() : 0;
+  int64_t directPeriodNs = mDirectReports.getPeriod();
+  if (directPeriodNs > 0 && (samplingPeriodNs == 0 || directPeriodNs < samplingPeriodNs)) {
+    samplingPeriodNs = directPeriodNs;
+  }
+
+  if (mIioHub == nullptr) {
+    // A period of 0 pauses the sensor
+    ::rb::hardware::sensors::hwctl::SensorScheduler::get().schedule(this, samplingPeriodNs);
+  } else if (samplingPeriodNs > 0) {
+    // Sensors backed by an IIO device are sampled by the hub of the device
+    mIioHub->subscribe(this, samplingPeriodNs);
+  } else {
+    mIioHub->unsubscribe(this);
+  }
+}
+
+uint32_t Sensor::getDirectReportFlags() const {
+  // Direct reports are written from the samples of the IIO hub
+  int32_t rateLevel = mIioHub != nullptr
+                        ? ::rb::hardware::sensors::hwctl::getMaxDirectRateLevel(mSensorInfo.minDelayUs * 1000LL)
+                        : ::rb::hardware::sensors::hwctl::kDirectRateStop;
+  if (rateLevel == ::rb::hardware::sensors::hwctl::kDirectRateStop) {
+    return 0;
   }
+  return SensorInfo::SENSOR_FLAG_BITS_DIRECT_CHANNEL_ASHMEM |
+         (rateLevel << SensorInfo::SENSOR_FLAG_SHIFT_DIRECT_REPORT);
 }
 
 ScopedAStatus Sensor::flush() {
@@ -77,9 +126,8 @@ ScopedAStatus Sensor::flush() {
     return ScopedAStatus::fromServiceSpecificError(static_cast<int32_t>(BnSensors::ERROR_BAD_VALUE));
   }
 
-  // Note: If a sensor supports batching, write all of the currently batched
-  // events for the sensor to the Event FMQ prior to writing the flush complete
-  // event.
+  // Write all of the currently batched events for the sensor to the Event FMQ
+  // prior to writing the flush complete event.
   Event ev;
   ev.sensorHandle = mSensorInfo.sensorHandle;
   ev.sensorType = SensorType::META_DATA;
@@ -87,52 +135,110 @@ ScopedAStatus Sensor::flush() {
     .what = MetaDataEventType::META_DATA_FLUSH_COMPLETE,
   };
   ev.payload.set<EventPayload::Tag::meta>(meta);
-  std::vector<Event> evs{ev};
-  mCallback->postEvents(evs, isWakeUpSensor());
+  std::lock_guard<std::mutex> fifoLock(mFifoLock);
+  size_t count = mFifo.size() + 1;
+  Event* events = mCallback->beginWrite(count);
+  if (events != nullptr) {
+    mFifo.drain(events);
+    new (&events[count - 1]) Event(ev);
+    mCallback->commitWrite(count, isWakeUpSensor());
+  } else {
+    mFifo.clear();
+  }
 
   return ScopedAStatus::ok();
 }
 
-void Sensor::startThread(Sensor* sensor) { sensor->run(); }
+void Sensor::onDeadline(int64_t /* deadlineNs */, int64_t /* nowNs */) {
+  if (mIsEnabled) {
+    size_t count = readEvents(mReadEvents.data(), mReadEvents.size());
+    report(mReadEvents.data(), count);
+  }
+}
+
+void Sensor::report(const Event* events, size_t count) {
+  std::lock_guard<std::mutex> lock(mFifoLock);
+  applyReportLatency();
+  if (!mFifo.isBatching()) {
+    post(events, count);
+    return;
+  }
 
-void Sensor::run() {
-  std::unique_lock<std::mutex> runLock(mRunMutex);
-  constexpr int64_t kNanosecondsInSeconds = 1000 * 1000 * 1000;
+  bool isDue = false;
+  for (size_t i = 0; i < count; i++) {
+    isDue = mFifo.push(events[i], events[i].timestamp) || isDue;
+  }
+  if (isDue) {
+    deliverFifo();
+  }
+}
 
-  while (!mStopThread) {
-    if (!mIsEnabled) {
-      mWaitCV.wait(runLock, [&] { return (mIsEnabled || mStopThread); });
-    } else {
-      timespec curTime;
-      clock_gettime(CLOCK_BOOTTIME, &curTime);
-      int64_t now = (curTime.tv_sec * kNanosecondsInSeconds) + curTime.tv_nsec;
-      int64_t nextSampleTime = mLastSampleTimeNs + mSamplingPeriodNs;
+void Sensor::post(const Event* events, size_t count) {
+  Event* slots = mCallback->beginWrite(count);
+  if (slots != nullptr) {
+    std::uninitialized_copy_n(events, count, slots);
+    mCallback->commitWrite(count, isWakeUpSensor());
+  }
+}
 
-      if (now >= nextSampleTime) {
-        mLastSampleTimeNs = now;
-        nextSampleTime = mLastSampleTimeNs + mSamplingPeriodNs;
-        mCallback->postEvents(readEvents(), isWakeUpSensor());
-      }
+void Sensor::deliverFifo() {
+  size_t count = mFifo.size();
+  if (count == 0) {
+    return;
+  }
+  Event* events = mCallback->beginWrite(count);
+  if (events == nullptr) {
+    mFifo.clear();
+    return;
+  }
+  mFifo.drain(events);
+  mCallback->commitWrite(count, isWakeUpSensor());
+}
 
-      mWaitCV.wait_for(runLock, std::chrono::nanoseconds(nextSampleTime - now));
+void Sensor::applyReportLatency() {
+  int64_t maxReportLatencyNs = mMaxReportLatencyNs;
+  if (mFifo.getMaxReportLatency() != maxReportLatencyNs) {
+    // Deliver what was batched with the previous configuration before applying
+    // the new one. The FIFO is only allocated once batching is requested.
+    deliverFifo();
+    if (maxReportLatencyNs > 0 && mFifo.getCapacity() == 0) {
+      mFifo.setCapacity(mSensorInfo.fifoMaxEventCount);
     }
+    mFifo.setMaxReportLatency(maxReportLatencyNs);
+  }
+}
+
+::rb::hardware::sensors::hwctl::PeriodicTimerStats Sensor::getSamplingStats() {
+  if (mIioHub != nullptr) {
+    return mIioHub->getStats();
   }
+  return ::rb::hardware::sensors::hwctl::SensorScheduler::get().getStats(this);
 }
 
 bool Sensor::isWakeUpSensor() {
   return mSensorInfo.flags & static_cast<uint32_t>(SensorInfo::SENSOR_FLAG_BITS_WAKE_UP);
 }
 
-std::vector<Event> Sensor::readEvents() {
-  std::vector<Event> events;
-  Event event;
+bool Sensor::canDropEvents() const {
+  return (mSensorInfo.flags & static_cast<uint32_t>(SensorInfo::SENSOR_FLAG_BITS_MASK_REPORTING_MODE)) ==
+         static_cast<uint32_t>(SensorInfo::SENSOR_FLAG_BITS_CONTINUOUS_MODE);
+}
+
+int64_t Sensor::getSamplingPeriodNs() const {
+  // Use the slowest rate until the framework has configured the sensor
+  return mSamplingPeriodNs > 0 ? mSamplingPeriodNs : mSensorInfo.maxDelayUs * 1000LL;
+}
+
+size_t Sensor::readEvents(Event* events, size_t count) {
+  if (count == 0) {
+    return 0;
+  }
+  Event& event = events[0];
   event.sensorHandle = mSensorInfo.sensorHandle;
   event.sensorType = mSensorInfo.type;
   event.timestamp = ::android::elapsedRealtimeNano();
   memset(&event.payload, 0, sizeof(event.payload));
-  readEventPayload(event.payload);
-  events.push_back(event);
-  return events;
+  return 1;
 }
 
 ScopedAStatus Sensor::setOperationMode(OperationMode mode) {
@@ -161,28 +267,59 @@ ScopedAStatus Sensor::injectEvent(const Event& event) {
   return ScopedAStatus::fromServiceSpecificError(static_cast<int32_t>(BnSensors::ERROR_BAD_VALUE));
 }
 
-void Sensor::readEventPayload(EventPayload& payload) {
-  std::string values;
-  if (0 == ::rb::hardware::sensors::hwctl::readFromFile(&mIioFileName, values)) {
-    fillPayload(payload, values);
+void Sensor::onSample(const ::rb::hardware::sensors::hwctl::IioSample& sample) {
+  writeDirectReports(sample);
+  if (!mIsEnabled) {
+    return;
   }
-}
 
-void Sensor::fillPayload(EventPayload& payload, std::string& data) {
-  std::istringstream iss(data);
-  std::vector<std::string> results(std::istream_iterator<std::string>{iss}, std::istream_iterator<std::string>());
+  std::lock_guard<std::mutex> lock(mFifoLock);
+  applyReportLatency();
+  if (mFifo.isBatching()) {
+    Event event;
+    fillEvent(event, sample);
+    if (mFifo.push(event, event.timestamp)) {
+      deliverFifo();
+    }
+    return;
+  }
 
-  if (results.size() > 2) {
-    EventPayload::Vec3 vec3 = {
-      .x = std::stof(results[0]) * mSensorInfo.resolution,
-      .y = std::stof(results[1]) * mSensorInfo.resolution,
-      .z = std::stof(results[2]) * mSensorInfo.resolution,
-      .status = SensorStatus::ACCURACY_HIGH,
-    };
-    payload.set<EventPayload::Tag::vec3>(vec3);
+  // Build the event directly in the event queue
+  Event* event = mCallback->beginWrite(1);
+  if (event != nullptr) {
+    fillEvent(*new (event) Event(), sample);
+    mCallback->commitWrite(1, isWakeUpSensor());
   }
 }
 
+void Sensor::fillEvent(Event& event, const ::rb::hardware::sensors::hwctl::IioSample& sample) {
+  event.sensorHandle = mSensorInfo.sensorHandle;
+  event.sensorType = mSensorInfo.type;
+  event.timestamp = sample.timestamp;
+  fillPayload(event.payload, &sample.values[mIioSlot]);
+}
+
+void Sensor::writeDirectReports(const ::rb::hardware::sensors::hwctl::IioSample& sample) {
+  ::rb::hardware::sensors::hwctl::DirectReportEvent event = {};
+  event.type = static_cast<int32_t>(mSensorInfo.type);
+  event.timestamp = sample.timestamp;
+  event.u.vector.x = sample.values[mIioSlot] * mSensorInfo.resolution;
+  event.u.vector.y = sample.values[mIioSlot + 1] * mSensorInfo.resolution;
+  event.u.vector.z = sample.values[mIioSlot + 2] * mSensorInfo.resolution;
+  event.u.vector.status = static_cast<int8_t>(SensorStatus::ACCURACY_HIGH);
+  mDirectReports.write(event);
+}
+
+void Sensor::fillPayload(EventPayload& payload, const int64_t* data) {
+  EventPayload::Vec3 vec3 = {
+    .x = data[0] * mSensorInfo.resolution,
+    .y = data[1] * mSensorInfo.resolution,
+    .z = data[2] * mSensorInfo.resolution,
+    .status = SensorStatus::ACCURACY_HIGH,
+  };
+  payload.set<EventPayload::Tag::vec3>(vec3);
+}
+
 }  // namespace sensors
 }  // namespace hardware
 }  // namespace android
@@ -17,6 +17,9 @@
 #include "sensors-impl/SensorsHalAidl.h"
 
 #include <aidl/android/hardware/common/fmq/SynchronizedReadWrite.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <unistd.h>
 
 using ::aidl::android::hardware::common::fmq::MQDescriptor;
 using ::aidl::android::hardware::common::fmq::SynchronizedReadWrite;
@@ -25,6 +28,13 @@ using ::aidl::android::hardware::sensors::ISensors;
 using ::aidl::android::hardware::sensors::ISensorsCallback;
 using ::aidl::android::hardware::sensors::SensorInfo;
 using ::ndk::ScopedAStatus;
+using ::rb::hardware::sensors::hwctl::DirectChannel;
+using ::rb::hardware::sensors::hwctl::DirectReportEvent;
+using ::rb::hardware::sensors::hwctl::getDirectReportPeriodNs;
+using ::rb::hardware::sensors::hwctl::kDirectRateStop;
+using ::rb::hardware::sensors::hwctl::PeriodicTimerStats;
+using ::rb::hardware::sensors::hwctl::SignalCoalescerStats;
+using ::rb::hardware::sensors::hwctl::WakeLockStats;
 
 namespace aidl {
 namespace android {
@@ -32,9 +42,9 @@ namespace hardware {
 namespace sensors {
 
 ScopedAStatus SensorsHalAidl::activate(int32_t in_sensorHandle, bool in_enabled) {
-  auto sensor = mSensors.find(in_sensorHandle);
-  if (sensor != mSensors.end()) {
-    sensor->second->activate(in_enabled);
+  auto* sensor = mSensors.find(in_sensorHandle);
+  if (sensor != nullptr) {
+    sensor->activate(in_enabled);
     return ScopedAStatus::ok();
   }
 
@@ -42,27 +52,83 @@ ScopedAStatus SensorsHalAidl::activate(int32_t in_sensorHandle, bool in_enabled)
 }
 
 ScopedAStatus SensorsHalAidl::batch(int32_t in_sensorHandle, int64_t in_samplingPeriodNs,
-                                    int64_t /* in_maxReportLatencyNs */) {
-  auto sensor = mSensors.find(in_sensorHandle);
-  if (sensor != mSensors.end()) {
-    sensor->second->batch(in_samplingPeriodNs);
+                                    int64_t in_maxReportLatencyNs) {
+  auto* sensor = mSensors.find(in_sensorHandle);
+  if (sensor != nullptr) {
+    sensor->batch(in_samplingPeriodNs, in_maxReportLatencyNs);
     return ScopedAStatus::ok();
   }
 
   return ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
 }
 
-ScopedAStatus SensorsHalAidl::configDirectReport(int32_t /* in_sensorHandle */, int32_t /* in_channelHandle */,
-                                                 ISensors::RateLevel /* in_rate */, int32_t* _aidl_return) {
-  *_aidl_return = EX_UNSUPPORTED_OPERATION;
+ScopedAStatus SensorsHalAidl::configDirectReport(int32_t in_sensorHandle, int32_t in_channelHandle,
+                                                 ISensors::RateLevel in_rate, int32_t* _aidl_return) {
+  *_aidl_return = 0;
+  std::shared_ptr<DirectChannel> channel = getDirectChannel(in_channelHandle);
+  if (channel == nullptr) {
+    return ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+  }
+
+  int32_t rateLevel = static_cast<int32_t>(in_rate);
+  if (in_sensorHandle == -1) {
+    // All sensors of a channel can only be stopped together
+    if (rateLevel != kDirectRateStop) {
+      return ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
+    for (const auto& sensor : mSensors) {
+      sensor->configDirectReport(channel, 0 /* reportToken */, 0 /* periodNs */);
+    }
+    return ScopedAStatus::ok();
+  }
+
+  auto* sensor = mSensors.find(in_sensorHandle);
+  if (sensor == nullptr) {
+    return ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+  }
+  uint32_t flags = sensor->getSensorInfo().flags;
+  int32_t maxRateLevel =
+    (flags & SensorInfo::SENSOR_FLAG_BITS_MASK_DIRECT_REPORT) >> SensorInfo::SENSOR_FLAG_SHIFT_DIRECT_REPORT;
+  if (!(flags & SensorInfo::SENSOR_FLAG_BITS_DIRECT_CHANNEL_ASHMEM) || rateLevel > maxRateLevel) {
+    return ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+  }
+
+  // The sensor handle is unique within a channel and serves as report token
+  sensor->configDirectReport(channel, in_sensorHandle, getDirectReportPeriodNs(rateLevel));
+  *_aidl_return = rateLevel != kDirectRateStop ? in_sensorHandle : 0;
+  return ScopedAStatus::ok();
+}
 
-  return ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+binder_status_t SensorsHalAidl::dump(int fd, const char** /* args */, uint32_t /* numArgs */) {
+  WakeLockStats stats = mWakeLock.getStats();
+  dprintf(fd, "Wake lock: %s, acquisitions %" PRIu64 " (%.3f/s), releases %" PRIu64 ", auto releases %" PRIu64 "\n",
+          stats.isHeld ? "held" : "released", stats.acquisitions, stats.acquisitionRateHz, stats.releases,
+          stats.autoReleases);
+
+  SignalCoalescerStats signalStats = mSignalCoalescer.getStats();
+  dprintf(fd, "Event FMQ: events %" PRIu64 ", signals %" PRIu64 " (%.3f/s), signal delay mean %" PRId64
+          " ns, max %" PRId64 " ns\n",
+          signalStats.events, signalStats.signals, signalStats.signalRateHz, signalStats.meanDelayNs,
+          signalStats.maxDelayNs);
+
+  for (const auto& sensor : mSensors) {
+    PeriodicTimerStats samplingStats = sensor->getSamplingStats();
+    dprintf(fd, "Sensor %s: achieved rate %.3f Hz, lateness mean %" PRId64 " ns, max %" PRId64 " ns, samples %" PRIu64
+            ", skipped %" PRIu64 "\n",
+            sensor->getSensorInfo().name.c_str(), samplingStats.achievedRateHz, samplingStats.meanLatenessNs,
+            samplingStats.maxLatenessNs, samplingStats.samples, samplingStats.skipped);
+  }
+
+  std::lock_guard<std::mutex> lock(mWriteLock);
+  dprintf(fd, "Pending events: %zu, dropped %" PRIu64 ", dropped undroppable %" PRIu64 "\n", mPendingEvents.size(),
+          mPendingEvents.getDropped(), mPendingEvents.getUndroppableDropped());
+  return STATUS_OK;
 }
 
 ScopedAStatus SensorsHalAidl::flush(int32_t in_sensorHandle) {
-  auto sensor = mSensors.find(in_sensorHandle);
-  if (sensor != mSensors.end()) {
-    return sensor->second->flush();
+  auto* sensor = mSensors.find(in_sensorHandle);
+  if (sensor != nullptr) {
+    return sensor->flush();
   }
 
   return ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
@@ -70,7 +136,7 @@ ScopedAStatus SensorsHalAidl::flush(int32_t in_sensorHandle) {
 
 ScopedAStatus SensorsHalAidl::getSensorsList(std::vector<SensorInfo>* _aidl_return) {
   for (const auto& sensor : mSensors) {
-    _aidl_return->push_back(sensor.second->getSensorInfo());
+    _aidl_return->push_back(sensor->getSensorInfo());
   }
   return ScopedAStatus::ok();
 }
@@ -81,32 +147,42 @@ ScopedAStatus SensorsHalAidl::initialize(
   const std::shared_ptr<::aidl::android::hardware::sensors::ISensorsCallback>& in_sensorsCallback) {
   ScopedAStatus result = ScopedAStatus::ok();
 
-  mEventQueue =
-    std::make_unique<AidlMessageQueue<Event, SynchronizedReadWrite>>(in_eventQueueDescriptor, true /* resetPointers */);
-
   // Ensure that all sensors are disabled.
-  for (auto sensor : mSensors) {
-    sensor.second->activate(false);
+  for (const auto& sensor : mSensors) {
+    sensor->activate(false);
   }
 
-  // Stop the Wake Lock thread if it is currently running
-  if (mReadWakeLockQueueRun.load()) {
-    mReadWakeLockQueueRun = false;
-    mWakeLockThread.join();
-  }
+  // Stop the pending writes thread if it is currently running, it waits on
+  // the EventFlag without holding the write lock
+  stopPendingWritesThread();
 
-  // Save a reference to the callback
-  mCallback = in_sensorsCallback;
+  // The EventFlag is replaced under the write lock as well, since deferred
+  // signals are sent from the coalescer thread.
+  {
+    std::lock_guard<std::mutex> lock(mWriteLock);
+    mEventQueue = std::make_unique<EventMessageQueue>(in_eventQueueDescriptor, true /* resetPointers */);
+    mEventWriter =
+      std::make_unique<bosch::sensors::EventQueueWriter<EventMessageQueue, Event>>(mEventQueue.get());
+    mSignalCoalescer.clear();
+    // Pending events belong to the previous framework session
+    updateWakeLock(0 /* eventsWritten */, mPendingEvents.clear());
 
-  // Ensure that any existing EventFlag is properly deleted
-  deleteEventFlag();
+    // Ensure that any existing EventFlag is properly deleted
+    deleteEventFlag();
 
-  // Create the EventFlag that is used to signal to the framework that sensor
-  // events have been written to the Event FMQ
-  if (EventFlag::createEventFlag(mEventQueue->getEventFlagWord(), &mEventQueueFlag) != OK) {
-    result = ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    // Create the EventFlag that is used to signal to the framework that sensor
+    // events have been written to the Event FMQ
+    if (EventFlag::createEventFlag(mEventQueue->getEventFlagWord(), &mEventQueueFlag) != OK) {
+      result = ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
   }
 
+  // Stop the Wake Lock thread if it is currently running
+  stopReadWakeLockThread();
+
+  // Save a reference to the callback
+  mCallback = in_sensorsCallback;
+
   // Create the Wake Lock FMQ that is used by the framework to communicate
   // whenever WAKE_UP events have been successfully read and handled by the
   // framework.
@@ -120,34 +196,69 @@ ScopedAStatus SensorsHalAidl::initialize(
   // Start the thread to read events from the Wake Lock FMQ
   mReadWakeLockQueueRun = true;
   mWakeLockThread = std::thread(startReadWakeLockThread, this);
+
+  // Start the thread to write the events that did not fit into the Event FMQ
+  if (mEventQueueFlag != nullptr) {
+    mPendingWritesRun = true;
+    mPendingWritesThread = std::thread(startPendingWritesThread, this);
+  }
   return result;
 }
 
 ScopedAStatus SensorsHalAidl::injectSensorData(const Event& in_event) {
-  auto sensor = mSensors.find(in_event.sensorHandle);
-  if (sensor != mSensors.end()) {
-    return sensor->second->injectEvent(in_event);
+  auto* sensor = mSensors.find(in_event.sensorHandle);
+  if (sensor != nullptr) {
+    return sensor->injectEvent(in_event);
   }
   return ScopedAStatus::fromServiceSpecificError(static_cast<int32_t>(ERROR_BAD_VALUE));
 }
 
-ScopedAStatus SensorsHalAidl::registerDirectChannel(const ISensors::SharedMemInfo& /* in_mem */,
-                                                    int32_t* _aidl_return) {
-  *_aidl_return = EX_UNSUPPORTED_OPERATION;
+ScopedAStatus SensorsHalAidl::registerDirectChannel(const ISensors::SharedMemInfo& in_mem, int32_t* _aidl_return) {
+  *_aidl_return = -1;
+  if (in_mem.type != ISensors::SharedMemInfo::SharedMemType::ASHMEM ||
+      in_mem.format != ISensors::SharedMemInfo::SharedMemFormat::SENSORS_EVENT) {
+    return ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+  }
+  if (in_mem.memoryHandle.fds.empty() || in_mem.size < static_cast<int32_t>(sizeof(DirectReportEvent))) {
+    return ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+  }
+
+  auto channel = std::make_shared<DirectChannel>(dup(in_mem.memoryHandle.fds[0].get()), in_mem.size);
+  if (!channel->isValid()) {
+    return ScopedAStatus::fromServiceSpecificError(static_cast<int32_t>(BnSensors::ERROR_NO_MEMORY));
+  }
 
-  return ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+  std::lock_guard<std::mutex> lock(mDirectChannelLock);
+  *_aidl_return = mNextChannelHandle++;
+  mDirectChannels[*_aidl_return] = channel;
+  return ScopedAStatus::ok();
 }
 
 ScopedAStatus SensorsHalAidl::setOperationMode(OperationMode in_mode) {
   auto res = ScopedAStatus::ok();
-  for (auto sensor : mSensors) {
-    res = sensor.second->setOperationMode(in_mode);
+  for (const auto& sensor : mSensors) {
+    res = sensor->setOperationMode(in_mode);
   }
   return res;
 }
 
-ScopedAStatus SensorsHalAidl::unregisterDirectChannel(int32_t /* in_channelHandle */) {
-  return ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+ScopedAStatus SensorsHalAidl::unregisterDirectChannel(int32_t in_channelHandle) {
+  std::shared_ptr<DirectChannel> channel;
+  {
+    std::lock_guard<std::mutex> lock(mDirectChannelLock);
+    auto it = mDirectChannels.find(in_channelHandle);
+    if (it == mDirectChannels.end()) {
+      return ScopedAStatus::ok();
+    }
+    channel = it->second;
+    mDirectChannels.erase(it);
+  }
+
+  // The shared memory is unmapped once the last sensor has let go of it
+  for (const auto& sensor : mSensors) {
+    sensor->configDirectReport(channel, 0 /* reportToken */, 0 /* periodNs */);
+  }
+  return ScopedAStatus::ok();
 }
 
 }  // namespace sensors
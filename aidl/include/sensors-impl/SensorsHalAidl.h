@@ -22,10 +22,21 @@
 #include <fmq/AidlMessageQueue.h>
 #include <hardware_legacy/power.h>
 
+#include <algorithm>
+#include <condition_variable>
+#include <iterator>
 #include <map>
+#include <memory>
+#include <vector>
 
 #include "BoschSensors.h"
+#include "EventQueueWriter.h"
 #include "Sensor.h"
+#include "SensorTable.h"
+#include "pendingEvents.h"
+#include "periodicTimer.h"
+#include "signalCoalescer.h"
+#include "wakeLock.h"
 
 namespace aidl {
 namespace android {
@@ -40,23 +51,43 @@ using ::android::hardware::EventFlag;
 
 class SensorsHalAidl : public BnSensors, public ISensorsEventCallback {
   static constexpr const char* kWakeLockName = "SensorsHAL_WAKEUP";
+  // Events held while the Event FMQ is full, at least about 40 ms of two
+  // sensors at the highest rate. The ring grows to the FIFO reserved by all
+  // sensors together.
+  static constexpr size_t kPendingEventsCapacity = 256;
+  using EventMessageQueue = AidlMessageQueue<Event, SynchronizedReadWrite>;
 
 public:
   SensorsHalAidl()
     : mEventQueueFlag(nullptr),
-      mNextHandle(1),
-      mOutstandingWakeUpEvents(0),
+      mNextChannelHandle(1),
+      mPendingEvents(kPendingEventsCapacity),
+      mIsWritePending(false),
+      mPendingWritesRun(false),
       mReadWakeLockQueueRun(false),
-      mAutoReleaseWakeLockTime(0),
-      mHasWakeLock(false) {
-    AddSensor<bosch::sensors::Smi240Accel<Sensor, ISensorsEventCallback, SensorType>>();
-    AddSensor<bosch::sensors::Smi240Gyro<Sensor, ISensorsEventCallback, SensorType>>();
+      mWakeLock(kWakeLockName, static_cast<int64_t>(WAKE_LOCK_TIMEOUT_SECONDS) * 1000 * 1000 * 1000),
+      mSignalCoalescer([this] { signalEventQueue(); }) {
+    for (const auto& device : bosch::sensors::getSmi240Devices()) {
+      AddSensor<bosch::sensors::Smi240Accel<Sensor, ISensorsEventCallback, SensorType>>(device);
+      AddSensor<bosch::sensors::Smi240Gyro<Sensor, ISensorsEventCallback, SensorType>>(device);
+    }
+
+    // Every advertised fifoReservedEventCount must fit even if all sensors
+    // batch at once
+    size_t fifoReservedEvents = 0;
+    for (const auto& sensor : mSensors) {
+      fifoReservedEvents += static_cast<size_t>(std::max(sensor->getSensorInfo().fifoReservedEventCount, 0));
+    }
+    mPendingEvents.reserve(fifoReservedEvents);
   }
 
   virtual ~SensorsHalAidl() {
-    deleteEventFlag();
-    mReadWakeLockQueueRun = false;
-    mWakeLockThread.join();
+    stopPendingWritesThread();
+    {
+      std::lock_guard<std::mutex> lock(mWriteLock);
+      deleteEventFlag();
+    }
+    stopReadWakeLockThread();
   }
 
   ::ndk::ScopedAStatus activate(int32_t in_sensorHandle, bool in_enabled) override;
@@ -65,6 +96,7 @@ public:
   ::ndk::ScopedAStatus configDirectReport(int32_t in_sensorHandle, int32_t in_channelHandle,
                                           ::aidl::android::hardware::sensors::ISensors::RateLevel in_rate,
                                           int32_t* _aidl_return) override;
+  binder_status_t dump(int fd, const char** args, uint32_t numArgs) override;
   ::ndk::ScopedAStatus flush(int32_t in_sensorHandle) override;
   ::ndk::ScopedAStatus getSensorsList(
     std::vector<::aidl::android::hardware::sensors::SensorInfo>* _aidl_return) override;
@@ -82,27 +114,69 @@ public:
   ::ndk::ScopedAStatus unregisterDirectChannel(int32_t in_channelHandle) override;
 
   void postEvents(const std::vector<Event>& events, bool wakeup) override {
-    std::lock_guard<std::mutex> lock(mWriteLock);
-    if (mEventQueue == nullptr) {
+    Event* slots = beginWrite(events.size());
+    if (slots != nullptr) {
+      std::uninitialized_copy(events.begin(), events.end(), slots);
+      commitWrite(events.size(), wakeup);
+    }
+  }
+
+  Event* beginWrite(size_t count) override {
+    mWriteLock.lock();
+    Event* events = nullptr;
+    if (mEventWriter != nullptr && count > 0) {
+      // Once events are pending, later ones queue up behind them to keep the
+      // order
+      if (mPendingEvents.empty()) {
+        events = mEventWriter->beginWrite(count);
+      }
+      mIsWritePending = events == nullptr;
+      if (mIsWritePending) {
+        // Grows once to the largest write and is reused afterwards
+        if (mPendingStaging.size() < count) {
+          mPendingStaging.resize(count);
+        }
+        events = mPendingStaging.data();
+      }
+    }
+    if (events == nullptr) {
+      mWriteLock.unlock();
+    }
+    mWriteEvents = events;
+    return events;
+  }
+
+  void commitWrite(size_t count, bool wakeup) override {
+    std::lock_guard<std::mutex> lock(mWriteLock, std::adopt_lock);
+    if (mIsWritePending) {
+      queuePendingEvents(mWriteEvents, count, wakeup);
       return;
     }
-    if (mEventQueue->write(&events.front(), events.size())) {
-      mEventQueueFlag->wake(static_cast<uint32_t>(BnSensors::EVENT_QUEUE_FLAG_BITS_READ_AND_PROCESS));
+
+    // WAKE_UP events and flush completions are not held back
+    bool urgent = wakeup || std::any_of(mWriteEvents, mWriteEvents + count,
+                                        [](const Event& event) { return event.sensorType == SensorType::META_DATA; });
+    if (mEventWriter->commitWrite()) {
+      if (mSignalCoalescer.onWrite(count, urgent)) {
+        mEventQueueFlag->wake(static_cast<uint32_t>(BnSensors::EVENT_QUEUE_FLAG_BITS_READ_AND_PROCESS));
+      }
 
       if (wakeup) {
         // Keep track of the number of outstanding WAKE_UP events in order to
         // properly hold a wake lock until the framework has secured a wake lock
-        updateWakeLock(events.size(), 0 /* eventsHandled */);
+        updateWakeLock(count, 0 /* eventsHandled */);
       }
     }
   }
 
 protected:
   // Add a new sensor
-  template <class Sensor>
-  void AddSensor() {
-    std::shared_ptr<Sensor> sensor = std::make_shared<Sensor>(mNextHandle++ /* sensorHandle */, this /* callback */);
-    mSensors[sensor->getSensorInfo().sensorHandle] = sensor;
+  template <class Sensor, typename... Args>
+  void AddSensor(Args&&... args) {
+    std::shared_ptr<Sensor> sensor =
+      std::make_shared<Sensor>(mSensors.getNextHandle() /* sensorHandle */, this /* callback */,
+                               std::forward<Args>(args)...);
+    mSensors.add(sensor);
     ALOGD("AddSensor[%d] %s", sensor->getSensorInfo().sensorHandle, sensor->getSensorInfo().name.c_str());
   }
 
@@ -116,65 +190,162 @@ protected:
     }
   }
 
+  // Signals the framework to read the Event FMQ, for the signals deferred by
+  // mSignalCoalescer
+  void signalEventQueue() {
+    std::lock_guard<std::mutex> lock(mWriteLock);
+    if (mEventQueueFlag != nullptr) {
+      mEventQueueFlag->wake(static_cast<uint32_t>(BnSensors::EVENT_QUEUE_FLAG_BITS_READ_AND_PROCESS));
+    }
+  }
+
+  std::shared_ptr<::rb::hardware::sensors::hwctl::DirectChannel> getDirectChannel(int32_t channelHandle) {
+    std::lock_guard<std::mutex> lock(mDirectChannelLock);
+    auto it = mDirectChannels.find(channelHandle);
+    return it != mDirectChannels.end() ? it->second : nullptr;
+  }
+
+  // Queues events that do not fit into the Event FMQ for the pending writes
+  // thread. Must be called with mWriteLock held.
+  void queuePendingEvents(const Event* events, size_t count, bool wakeup) {
+    bool wasEmpty = mPendingEvents.empty();
+    size_t droppedWakeUps = mPendingEvents.push(events, count, wakeup, [this](const Event& event) {
+      const Sensor* sensor = mSensors.find(event.sensorHandle);
+      return event.sensorType != SensorType::META_DATA && sensor != nullptr && sensor->canDropEvents();
+    });
+    // Pending WAKE_UP events hold the wake lock as well, until they are
+    // handled by the framework or dropped. Queued ones may also be evicted by
+    // a batch of non wake-up events.
+    updateWakeLock(wakeup ? count : 0, droppedWakeUps);
+    if (wasEmpty) {
+      mPendingWritesCV.notify_one();
+    }
+  }
+
+  static void startPendingWritesThread(SensorsHalAidl* sensors) { sensors->writePendingEvents(); }
+
+  void stopPendingWritesThread() {
+    if (!mPendingWritesThread.joinable()) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mWriteLock);
+      mPendingWritesRun = false;
+      mPendingWritesCV.notify_one();
+      mEventQueueFlag->wake(static_cast<uint32_t>(BnSensors::EVENT_QUEUE_FLAG_BITS_EVENTS_READ));
+    }
+    mPendingWritesThread.join();
+  }
+
+  // Function to write the pending events to the Event FMQ as the framework
+  // makes room in it
+  void writePendingEvents() {
+    // Bounds the wait in case the framework does not signal EVENTS_READ
+    constexpr int64_t kEventsReadTimeoutNs = 100 * 1000 * 1000;  // 100 ms
+    std::unique_lock<std::mutex> lock(mWriteLock);
+    while (mPendingWritesRun) {
+      if (mPendingEvents.empty()) {
+        mPendingWritesCV.wait(lock);
+        continue;
+      }
+
+      size_t count = 0;
+      const Event* events = mPendingEvents.front(&count);
+      count = std::min(count, mEventQueue->availableToWrite());
+      if (count > 0 && mEventQueue->write(events, count)) {
+        mPendingEvents.pop(count);
+        mEventQueueFlag->wake(static_cast<uint32_t>(BnSensors::EVENT_QUEUE_FLAG_BITS_READ_AND_PROCESS));
+        continue;
+      }
+
+      // The EventFlag is only replaced while this thread is stopped
+      EventFlag* eventQueueFlag = mEventQueueFlag;
+      lock.unlock();
+      uint32_t eventFlagState = 0;
+      eventQueueFlag->wait(static_cast<uint32_t>(BnSensors::EVENT_QUEUE_FLAG_BITS_EVENTS_READ), &eventFlagState,
+                           kEventsReadTimeoutNs);
+      lock.lock();
+    }
+  }
+
   static void startReadWakeLockThread(SensorsHalAidl* sensors) { sensors->readWakeLockFMQ(); }
 
+  void stopReadWakeLockThread() {
+    if (!mWakeLockThread.joinable()) {
+      return;
+    }
+    mReadWakeLockQueueRun = false;
+    mWakeLock.wakeWaiters();
+    // Unblock a pending read. A full queue has data to read already.
+    if (mWakeLockQueue != nullptr && mWakeLockQueue->availableToWrite() > 0) {
+      int32_t kZero = 0;
+      mWakeLockQueue->writeBlocking(&kZero, 1 /* count */, 0 /* readNotification */,
+                                    static_cast<uint32_t>(WAKE_LOCK_QUEUE_FLAG_BITS_DATA_WRITTEN));
+    }
+    mWakeLockThread.join();
+  }
+
   // Function to read the Wake Lock FMQ and release the wake lock when
   // appropriate
   void readWakeLockFMQ() {
+    int64_t deadlineNs = 0;
     while (mReadWakeLockQueueRun.load()) {
-      constexpr int64_t kReadTimeoutNs = 500 * 1000 * 1000;  // 500 ms
       int32_t eventsHandled = 0;
 
-      // Read events from the Wake Lock FMQ. Timeout after a reasonable amount
-      // of time to ensure that any held wake lock is able to be released if it
-      // is held for too long.
-      mWakeLockQueue->readBlocking(&eventsHandled, 1 /* count */, 0 /* readNotification */,
-                                   static_cast<uint32_t>(WAKE_LOCK_QUEUE_FLAG_BITS_DATA_WRITTEN), kReadTimeoutNs);
-      updateWakeLock(0 /* eventsWritten */, eventsHandled);
+      if (deadlineNs == 0) {
+        // The wake lock is released, so no WAKE_UP event is outstanding. Park
+        // until one is written instead of polling the Wake Lock FMQ. Counts
+        // still queued are accounted first; the wake lock discards the ones
+        // of events it auto released, even if they are read after the next
+        // acquisition.
+        drainWakeLockFMQ();
+        mWakeLock.waitUntilHeld(mReadWakeLockQueueRun);
+      } else {
+        // Read events from the Wake Lock FMQ until the wake lock is due for
+        // release. A zero timeout would block forever.
+        int64_t timeoutNs = std::max<int64_t>(deadlineNs - ::rb::hardware::sensors::hwctl::PeriodicTimer::now(), 1);
+        mWakeLockQueue->readBlocking(&eventsHandled, 1 /* count */, 0 /* readNotification */,
+                                     static_cast<uint32_t>(WAKE_LOCK_QUEUE_FLAG_BITS_DATA_WRITTEN), timeoutNs);
+      }
+      deadlineNs = updateWakeLock(0 /* eventsWritten */, eventsHandled);
     }
   }
 
   /**
-   * Responsible for acquiring and releasing a wake lock when there are
-   * unhandled WAKE_UP events
+   * Accounts all counts in the Wake Lock FMQ without blocking.
    */
-  void updateWakeLock(int32_t eventsWritten, int32_t eventsHandled) {
-    std::lock_guard<std::mutex> lock(mWakeLockLock);
-    int32_t newVal = mOutstandingWakeUpEvents + eventsWritten - eventsHandled;
-    if (newVal < 0) {
-      mOutstandingWakeUpEvents = 0;
-    } else {
-      mOutstandingWakeUpEvents = newVal;
-    }
-
-    if (eventsWritten > 0) {
-      // Update the time at which the last WAKE_UP event was sent
-      mAutoReleaseWakeLockTime = ::android::uptimeMillis() + static_cast<uint32_t>(WAKE_LOCK_TIMEOUT_SECONDS) * 1000;
-    }
-
-    if (!mHasWakeLock && mOutstandingWakeUpEvents > 0 && acquire_wake_lock(PARTIAL_WAKE_LOCK, kWakeLockName) == 0) {
-      mHasWakeLock = true;
-    } else if (mHasWakeLock) {
-      // Check if the wake lock should be released automatically if
-      // SensorTimeout::WAKE_LOCK_SECONDS has elapsed since the last WAKE_UP
-      // event was written to the Wake Lock FMQ.
-      if (::android::uptimeMillis() > mAutoReleaseWakeLockTime) {
-        ALOGD(
-          "No events read from wake lock FMQ for %d seconds, auto releasing "
-          "wake lock",
-          WAKE_LOCK_TIMEOUT_SECONDS);
-        mOutstandingWakeUpEvents = 0;
+  void drainWakeLockFMQ() {
+    int32_t eventsHandled[16];
+    size_t available;
+    while ((available = mWakeLockQueue->availableToRead()) > 0) {
+      size_t count = std::min(available, std::size(eventsHandled));
+      if (!mWakeLockQueue->read(eventsHandled, count)) {
+        break;
       }
-
-      if (mOutstandingWakeUpEvents == 0 && release_wake_lock(kWakeLockName) == 0) {
-        mHasWakeLock = false;
+      int64_t total = 0;
+      for (size_t i = 0; i < count; i++) {
+        total += eventsHandled[i];
       }
+      updateWakeLock(0 /* eventsWritten */, static_cast<int32_t>(std::min<int64_t>(total, INT32_MAX)));
     }
   }
 
+  /**
+   * Responsible for acquiring and releasing a wake lock when there are
+   * unhandled WAKE_UP events. Returns the next release deadline, see
+   * WakeLock::update().
+   */
+  int64_t updateWakeLock(int32_t eventsWritten, int32_t eventsHandled) {
+    return mWakeLock.update(eventsWritten, eventsHandled);
+  }
+
 private:
   // The Event FMQ where sensor events are written
-  std::unique_ptr<AidlMessageQueue<Event, SynchronizedReadWrite>> mEventQueue;
+  std::unique_ptr<EventMessageQueue> mEventQueue;
+  // Writer building events in place in the Event FMQ, protected by mWriteLock
+  std::unique_ptr<bosch::sensors::EventQueueWriter<EventMessageQueue, Event>> mEventWriter;
+  // Events of the write in progress, protected by mWriteLock
+  Event* mWriteEvents = nullptr;
   // The Wake Lock FMQ that is read to determine when the framework has handled
   // WAKE_UP events
   std::unique_ptr<AidlMessageQueue<int32_t, SynchronizedReadWrite>> mWakeLockQueue;
@@ -183,25 +354,37 @@ private:
   EventFlag* mEventQueueFlag;
   // Callback for asynchronous events, such as dynamic sensor connections.
   std::shared_ptr<::aidl::android::hardware::sensors::ISensorsCallback> mCallback;
-  // A map of the available sensors.
-  std::map<int32_t, std::shared_ptr<Sensor>> mSensors;
-  // The next available sensor handle.
-  int32_t mNextHandle;
+  // The available sensors, indexed by handle.
+  bosch::sensors::SensorTable<Sensor> mSensors;
+  // The registered direct channels and the next available channel handle,
+  // protected by mDirectChannelLock.
+  std::map<int32_t, std::shared_ptr<::rb::hardware::sensors::hwctl::DirectChannel>> mDirectChannels;
+  int32_t mNextChannelHandle;
+  std::mutex mDirectChannelLock;
   // Lock to protect writes to the FMQs.
   std::mutex mWriteLock;
-  // Lock to protect acquiring and releasing the wake lock
-  std::mutex mWakeLockLock;
-  // Track the number of WAKE_UP events that have not been handled by the
-  // framework
-  uint32_t mOutstandingWakeUpEvents;
+  // Events waiting for room in the Event FMQ, the staging buffer the write in
+  // progress is built in if it goes there, and whether it does. Protected by
+  // mWriteLock.
+  ::rb::hardware::sensors::hwctl::PendingEvents<Event> mPendingEvents;
+  std::vector<Event> mPendingStaging;
+  bool mIsWritePending;
+  // A thread to write the pending events, and the condition it waits on for
+  // them. mPendingWritesRun is protected by mWriteLock.
+  std::thread mPendingWritesThread;
+  std::condition_variable mPendingWritesCV;
+  bool mPendingWritesRun;
   // A thread to read the Wake Lock FMQ
   std::thread mWakeLockThread;
   // Flag to indicate that the Wake Lock Thread should continue to run
   std::atomic_bool mReadWakeLockQueueRun;
-  // Track the time when the wake lock should automatically be released
-  int64_t mAutoReleaseWakeLockTime;
-  // Flag to indicate if a wake lock has been acquired
-  bool mHasWakeLock;
+  // Wake lock held while WAKE_UP events have not been handled by the
+  // framework
+  ::rb::hardware::sensors::hwctl::WakeLock mWakeLock;
+  // Merges the signals of events written close together, so that the
+  // framework is woken up once for them. Declared last, so that its thread
+  // stops before the members it signals with are destroyed.
+  ::rb::hardware::sensors::hwctl::SignalCoalescer mSignalCoalescer;
 };
 
 }  // namespace sensors
@@ -17,77 +17,118 @@
 #ifndef ANDROID_HARDWARE_BOSCH_SENSORS_H
 #define ANDROID_HARDWARE_BOSCH_SENSORS_H
 
+#include <stddef.h>
 #include <stdint.h>
 
-#include <cmath>
+#include <string>
+#include <vector>
 
+#include "iioDiscovery.h"
 #include "iioFiles.h"
+#include "iioHub.h"
 
 namespace bosch {
 namespace sensors {
 
+// Memory budget of the software batching FIFO of each sensor
+constexpr size_t kSmi240FifoBytes = 16 * 1024;
+
+/**
+ * Returns the SMI240 devices found on the system, or the default device if
+ * discovery did not find any, so that the sensor list does not change.
+ */
+inline std::vector<::rb::hardware::sensors::hwctl::IioDevice> getSmi240Devices() {
+  using ::rb::hardware::sensors::hwctl::IioDevice;
+  using ::rb::hardware::sensors::hwctl::IioDiscovery;
+
+  std::vector<IioDevice> devices = IioDiscovery::find(::rb::hardware::sensors::hwctl::SMI240NAME);
+  if (devices.empty()) {
+    IioDevice device;
+    device.name = ::rb::hardware::sensors::hwctl::SMI240NAME;
+    device.sysfsDir = ::rb::hardware::sensors::hwctl::SMI240DEVICE;
+    device.devNode = ::rb::hardware::sensors::hwctl::SMI240CHRDEV;
+    devices.push_back(device);
+  }
+  return devices;
+}
+
+// Sensor names of additional instances get the instance number appended
+inline std::string getSmi240SensorName(const std::string& name, uint32_t instance) {
+  return instance == 0 ? name : name + " " + std::to_string(instance + 1);
+}
+
 template <class Base, class EventCallback, typename SensorType>
 class Smi240Accel : public Base {
 public:
-  Smi240Accel(int32_t sensorHandle, EventCallback* callback);
-
-private:
-  constexpr float gravityToAcceleration(float gravity) { return gravity * 9.80665f; }
+  Smi240Accel(int32_t sensorHandle, EventCallback* callback, const ::rb::hardware::sensors::hwctl::IioDevice& device);
 };
 
 template <class Base, class EventCallback, typename SensorType>
 class Smi240Gyro : public Base {
 public:
-  Smi240Gyro(int32_t sensorHandle, EventCallback* callback);
-
-private:
-  constexpr float degreeToRad(float degree) { return degree * M_PI / 180.0f; }
+  Smi240Gyro(int32_t sensorHandle, EventCallback* callback, const ::rb::hardware::sensors::hwctl::IioDevice& device);
 };
 
 template <class Base, class EventCallback, typename SensorType>
-Smi240Accel<Base, EventCallback, SensorType>::Smi240Accel(int32_t sensorHandle, EventCallback* callback)
+Smi240Accel<Base, EventCallback, SensorType>::Smi240Accel(
+  int32_t sensorHandle, EventCallback* callback, const ::rb::hardware::sensors::hwctl::IioDevice& device)
   : Base(callback) {
   Base::mSensorInfo.sensorHandle = sensorHandle;
-  Base::mSensorInfo.name = "BOSCH SMI240 Accelerometer Sensor";
+  Base::mSensorInfo.name = getSmi240SensorName("BOSCH SMI240 Accelerometer Sensor", device.instance);
   Base::mSensorInfo.vendor = "Robert Bosch GmbH";
   Base::mSensorInfo.version = 1;
   Base::mSensorInfo.type = SensorType::ACCELEROMETER;
   Base::mSensorInfo.typeAsString = "android.sensor.accelerometer";
-  Base::mSensorInfo.maxRange = gravityToAcceleration(16);
-  Base::mSensorInfo.resolution = gravityToAcceleration(1.0f / 2000.0f);
+  Base::mSensorInfo.resolution = ::rb::hardware::sensors::hwctl::toAndroidScale(
+    device.getScale(::rb::hardware::sensors::hwctl::SMI240ACC_SCALE,
+                    ::rb::hardware::sensors::hwctl::SMI240ACC_DEFAULT_SCALE),
+    ::rb::hardware::sensors::hwctl::SMI240ACC_SCALE_UNIT);
+  Base::mSensorInfo.maxRange =
+    Base::mSensorInfo.resolution * ::rb::hardware::sensors::hwctl::SMI240ACC_FULL_SCALE_RAW;
   Base::mSensorInfo.power = 5.0f;
-  Base::mSensorInfo.fifoReservedEventCount = 0;
-  Base::mSensorInfo.fifoMaxEventCount = 0;
+  Base::mSensorInfo.fifoReservedEventCount = kSmi240FifoBytes / sizeof(typename Base::Event);
+  Base::mSensorInfo.fifoMaxEventCount = kSmi240FifoBytes / sizeof(typename Base::Event);
   Base::mSensorInfo.requiredPermission = "";
   Base::mSensorInfo.flags = 0;
 
   *Base::mMinDelay = 10000;
   *Base::mMaxDelay = 200000;
 
-  Base::mIioFileName = ::rb::hardware::sensors::hwctl::SMI240ACC;
+  Base::mIioHub = ::rb::hardware::sensors::hwctl::IioHub::get(device, ::rb::hardware::sensors::hwctl::SMI240CHANNELS,
+                                                              ::rb::hardware::sensors::hwctl::SMI240RAW);
+  Base::mIioSlot = ::rb::hardware::sensors::hwctl::SMI240ACC_SLOT;
+  Base::mSensorInfo.flags = Base::getDirectReportFlags();
 };
 
 template <class Base, class EventCallback, typename SensorType>
-Smi240Gyro<Base, EventCallback, SensorType>::Smi240Gyro(int32_t sensorHandle, EventCallback* callback)
+Smi240Gyro<Base, EventCallback, SensorType>::Smi240Gyro(
+  int32_t sensorHandle, EventCallback* callback, const ::rb::hardware::sensors::hwctl::IioDevice& device)
   : Base(callback) {
   Base::mSensorInfo.sensorHandle = sensorHandle;
-  Base::mSensorInfo.name = "BOSCH SMI240 Gyroscope Sensor";
+  Base::mSensorInfo.name = getSmi240SensorName("BOSCH SMI240 Gyroscope Sensor", device.instance);
   Base::mSensorInfo.vendor = "Robert Bosch GmbH";
   Base::mSensorInfo.version = 1;
   Base::mSensorInfo.type = SensorType::GYROSCOPE;
   Base::mSensorInfo.typeAsString = "android.sensor.gyroscope";
-  Base::mSensorInfo.maxRange = degreeToRad(300);
-  Base::mSensorInfo.resolution = degreeToRad(1.0f / 100.0f);
+  Base::mSensorInfo.resolution = ::rb::hardware::sensors::hwctl::toAndroidScale(
+    device.getScale(::rb::hardware::sensors::hwctl::SMI240GYRO_SCALE,
+                    ::rb::hardware::sensors::hwctl::SMI240GYRO_DEFAULT_SCALE),
+    ::rb::hardware::sensors::hwctl::SMI240GYRO_SCALE_UNIT);
+  Base::mSensorInfo.maxRange =
+    Base::mSensorInfo.resolution * ::rb::hardware::sensors::hwctl::SMI240GYRO_FULL_SCALE_RAW;
   Base::mSensorInfo.power = 5.0f;
-  Base::mSensorInfo.fifoReservedEventCount = 0;
-  Base::mSensorInfo.fifoMaxEventCount = 0;
+  Base::mSensorInfo.fifoReservedEventCount = kSmi240FifoBytes / sizeof(typename Base::Event);
+  Base::mSensorInfo.fifoMaxEventCount = kSmi240FifoBytes / sizeof(typename Base::Event);
   Base::mSensorInfo.requiredPermission = "";
   Base::mSensorInfo.flags = 0;
 
   *Base::mMinDelay = 10000;
   *Base::mMaxDelay = 200000;
 
-  Base::mIioFileName = ::rb::hardware::sensors::hwctl::SMI240GYRO;
+  Base::mIioHub = ::rb::hardware::sensors::hwctl::IioHub::get(device, ::rb::hardware::sensors::hwctl::SMI240CHANNELS,
+                                                              ::rb::hardware::sensors::hwctl::SMI240RAW);
+  Base::mIioSlot = ::rb::hardware::sensors::hwctl::SMI240GYRO_SLOT;
+  Base::mSensorInfo.flags = Base::getDirectReportFlags();
 };
 
 }  // namespace sensors
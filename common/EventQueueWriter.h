@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_BOSCH_EVENT_QUEUE_WRITER_H
+#define ANDROID_HARDWARE_BOSCH_EVENT_QUEUE_WRITER_H
+
+#include <stddef.h>
+
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace bosch {
+namespace sensors {
+
+/**
+ * Transactional writer of the Event FMQ, independent of the queue flavor.
+ */
+template <class Event>
+class IEventQueueWriter {
+public:
+  virtual ~IEventQueueWriter(){};
+
+  /**
+   * Reserves count events in the queue, to be built in place by the caller.
+   * Returns nullptr if the queue does not have room for them. Not thread safe,
+   * the owner must serialize the transactions.
+   */
+  virtual Event* beginWrite(size_t count) = 0;
+
+  /**
+   * Publishes the events reserved by the last successful beginWrite().
+   */
+  virtual bool commitWrite() = 0;
+};
+
+/**
+ * Event FMQ writer on top of the beginWrite()/commitWrite() transactions of a
+ * HIDL or AIDL message queue.
+ *
+ * The events are built directly in the shared memory of the queue. Only if a
+ * reservation wraps around the end of the ring, they are built in a staging
+ * buffer and copied into the two regions of the transaction on commit. Queue
+ * may hold a different event type with the same layout, as V1_0 events do for
+ * V2_1 events.
+ */
+template <class Queue, class Event>
+class EventQueueWriter : public IEventQueueWriter<Event> {
+  using Transaction = typename Queue::MemTransaction;
+  using QueueEvent = std::remove_pointer_t<decltype(std::declval<Transaction&>().getSlot(0))>;
+  static_assert(sizeof(QueueEvent) == sizeof(Event), "Event layout does not match the queue");
+
+public:
+  // The queue is owned by the caller and must outlive the writer
+  explicit EventQueueWriter(Queue* queue) : mQueue(queue), mCount(0), mIsStaged(false) {}
+
+  Event* beginWrite(size_t count) override {
+    mCount = 0;
+    if (mQueue == nullptr || count == 0 || !mQueue->beginWrite(count, &mTransaction)) {
+      return nullptr;
+    }
+    mCount = count;
+
+    auto region = mTransaction.getFirstRegion();
+    if (region.getLength() >= count) {
+      mIsStaged = false;
+      return reinterpret_cast<Event*>(region.getAddress());
+    }
+
+    // Grows once to the largest wrapped write and is reused afterwards
+    mIsStaged = true;
+    if (mStaging.size() < count) {
+      mStaging.resize(count);
+    }
+    return mStaging.data();
+  }
+
+  bool commitWrite() override {
+    if (mCount == 0) {
+      return false;
+    }
+    size_t count = mCount;
+    mCount = 0;
+    if (mIsStaged && !mTransaction.copyTo(reinterpret_cast<const QueueEvent*>(mStaging.data()), 0, count)) {
+      return false;
+    }
+    return mQueue->commitWrite(count);
+  }
+
+private:
+  Queue* mQueue;
+  Transaction mTransaction;
+  size_t mCount;
+  bool mIsStaged;
+  std::vector<Event> mStaging;
+};
+
+}  // namespace sensors
+}  // namespace bosch
+
+#endif  // ANDROID_HARDWARE_BOSCH_EVENT_QUEUE_WRITER_H
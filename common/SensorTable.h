@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_BOSCH_SENSOR_TABLE_H
+#define ANDROID_HARDWARE_BOSCH_SENSOR_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace bosch {
+namespace sensors {
+
+/**
+ * The sensors of a HAL, indexed by handle.
+ *
+ * Handles are dense and start at 1, so a lookup is an array access. The table
+ * is filled while the HAL is constructed and is read-only afterwards, which
+ * makes it safe to use from the binder threads without locking. Iterating
+ * yields const references, so no reference counts are touched.
+ */
+template <class Sensor>
+class SensorTable {
+  using Slots = std::vector<std::shared_ptr<Sensor>>;
+
+public:
+  using const_iterator = typename Slots::const_iterator;
+
+  /**
+   * Returns the handle the next added sensor must be created with.
+   */
+  int32_t getNextHandle() const { return static_cast<int32_t>(mSlots.size()) + 1; }
+
+  /**
+   * Adds a sensor created with the handle of getNextHandle(). Must only be
+   * called during the construction of the HAL.
+   */
+  void add(std::shared_ptr<Sensor> sensor) { mSlots.push_back(std::move(sensor)); }
+
+  /**
+   * Returns the sensor with the handle, or nullptr if there is none.
+   */
+  Sensor* find(int32_t handle) const {
+    // Handles below 1 wrap around to an index past the end
+    size_t index = static_cast<uint32_t>(handle) - 1u;
+    return index < mSlots.size() ? mSlots[index].get() : nullptr;
+  }
+
+  size_t size() const { return mSlots.size(); }
+  const_iterator begin() const { return mSlots.begin(); }
+  const_iterator end() const { return mSlots.end(); }
+
+private:
+  Slots mSlots;
+};
+
+}  // namespace sensors
+}  // namespace bosch
+
+#endif  // ANDROID_HARDWARE_BOSCH_SENSOR_TABLE_H
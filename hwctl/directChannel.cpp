@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "directChannel.h"
+
+#include <errno.h>
+#include <log/log.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace rb {
+namespace hardware {
+namespace sensors {
+namespace hwctl {
+
+int64_t getDirectReportPeriodNs(int32_t rateLevel) {
+  switch (rateLevel) {
+    case kDirectRateNormal:
+      return 20 * 1000 * 1000;
+    case kDirectRateFast:
+      return 5 * 1000 * 1000;
+    case kDirectRateVeryFast:
+      return 1250 * 1000;
+    default:
+      return 0;
+  }
+}
+
+int32_t getMaxDirectRateLevel(int64_t minPeriodNs) {
+  for (int32_t rateLevel = kDirectRateVeryFast; rateLevel > kDirectRateStop; rateLevel--) {
+    if (getDirectReportPeriodNs(rateLevel) >= minPeriodNs) {
+      return rateLevel;
+    }
+  }
+  return kDirectRateStop;
+}
+
+DirectChannel::DirectChannel(int fd, size_t size)
+  : mFd(fd), mMapSize(size), mRecords(nullptr), mRecordCount(size / sizeof(DirectReportEvent)), mWritePos(0),
+    mCounter(1) {
+  if (mFd < 0 || mRecordCount == 0) {
+    ALOGE("DirectChannel invalid shared memory: fd %d, size %zu", mFd, size);
+    return;
+  }
+
+  void* addr = mmap(nullptr, mMapSize, PROT_READ | PROT_WRITE, MAP_SHARED, mFd, 0);
+  if (addr == MAP_FAILED) {
+    ALOGE("DirectChannel failed to map shared memory: %d", errno);
+    return;
+  }
+  mRecords = static_cast<DirectReportEvent*>(addr);
+}
+
+DirectChannel::~DirectChannel() {
+  if (mRecords != nullptr) {
+    munmap(mRecords, mMapSize);
+  }
+  if (mFd >= 0) {
+    close(mFd);
+  }
+}
+
+void DirectChannel::write(const DirectReportEvent& event) {
+  std::lock_guard<std::mutex> lock(mLock);
+  if (mRecords == nullptr) {
+    return;
+  }
+
+  DirectReportEvent& record = mRecords[mWritePos];
+  // Everything but the counter first, then the counter to publish the record
+  char* dst = reinterpret_cast<char*>(&record);
+  const char* src = reinterpret_cast<const char*>(&event);
+  memcpy(dst + offsetof(DirectReportEvent, sensor), src + offsetof(DirectReportEvent, sensor),
+         offsetof(DirectReportEvent, reserved0) - offsetof(DirectReportEvent, sensor));
+  memcpy(dst + offsetof(DirectReportEvent, timestamp), src + offsetof(DirectReportEvent, timestamp),
+         sizeof(DirectReportEvent) - offsetof(DirectReportEvent, timestamp));
+  record.version = sizeof(DirectReportEvent);
+
+  __atomic_store_n(&record.reserved0, static_cast<int32_t>(mCounter), __ATOMIC_RELEASE);
+
+  mCounter = mCounter == UINT32_MAX ? 1 : mCounter + 1;
+  mWritePos = (mWritePos + 1) % mRecordCount;
+}
+
+void DirectReports::configure(const std::shared_ptr<DirectChannel>& channel, int32_t reportToken,
+                              int64_t periodNs) {
+  std::lock_guard<std::mutex> lock(mLock);
+  auto it = std::find_if(mReports.begin(), mReports.end(),
+                         [&](const Report& report) { return report.channel == channel; });
+  if (periodNs <= 0) {
+    if (it != mReports.end()) {
+      mReports.erase(it);
+    }
+  } else if (it != mReports.end()) {
+    it->reportToken = reportToken;
+    it->periodNs = periodNs;
+  } else {
+    mReports.push_back({channel, reportToken, periodNs, 0});
+  }
+}
+
+void DirectReports::clear() {
+  std::lock_guard<std::mutex> lock(mLock);
+  mReports.clear();
+}
+
+int64_t DirectReports::getPeriod() {
+  std::lock_guard<std::mutex> lock(mLock);
+  int64_t periodNs = 0;
+  for (const auto& report : mReports) {
+    if (periodNs == 0 || report.periodNs < periodNs) {
+      periodNs = report.periodNs;
+    }
+  }
+  return periodNs;
+}
+
+void DirectReports::write(DirectReportEvent& event) {
+  std::lock_guard<std::mutex> lock(mLock);
+  // The sensor may be sampled faster than a channel, e.g. for the event queue.
+  // A quarter period of tolerance absorbs the jitter of the sampling grid, and
+  // the reports stay on the grid of the channel period so the tolerance does
+  // not raise their rate. A channel that fell behind by more than a period is
+  // resynchronized to the event.
+  for (auto& report : mReports) {
+    int64_t dueNs = report.lastTimestampNs + report.periodNs;
+    if (event.timestamp >= dueNs - report.periodNs / 4) {
+      report.lastTimestampNs = event.timestamp - dueNs < report.periodNs ? dueNs : event.timestamp;
+      event.sensor = report.reportToken;
+      report.channel->write(event);
+    }
+  }
+}
+
+}  // namespace hwctl
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace rb
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace rb {
+namespace hardware {
+namespace sensors {
+namespace hwctl {
+
+/**
+ * Rate levels of direct reports, numbered as RateLevel of the sensors HAL.
+ */
+enum DirectRateLevel : int32_t {
+  kDirectRateStop = 0,
+  kDirectRateNormal = 1,
+  kDirectRateFast = 2,
+  kDirectRateVeryFast = 3,
+};
+
+/**
+ * Returns the period of the nominal rate of a level (50, 200 and 800 Hz), or
+ * 0 for kDirectRateStop and unknown levels.
+ */
+int64_t getDirectReportPeriodNs(int32_t rateLevel);
+
+/**
+ * Returns the highest rate level whose nominal rate can be sampled with the
+ * given minimum period, or kDirectRateStop if there is none.
+ */
+int32_t getMaxDirectRateLevel(int64_t minPeriodNs);
+
+/**
+ * One record of the SENSORS_EVENT shared memory format, laid out as
+ * sensors_event_t. reserved0 holds the atomic counter of the record.
+ */
+struct DirectReportEvent {
+  struct Vector {
+    float x;
+    float y;
+    float z;
+    int8_t status;
+    uint8_t reserved[3];
+  };
+
+  int32_t version;
+  // Report token of the sensor in the channel
+  int32_t sensor;
+  int32_t type;
+  int32_t reserved0;
+  int64_t timestamp;
+  union {
+    float data[16];
+    Vector vector;
+  } u;
+  uint32_t flags;
+  uint32_t reserved1[3];
+};
+static_assert(sizeof(DirectReportEvent) == 104, "DirectReportEvent must match sensors_event_t");
+
+/**
+ * Writer of a direct report channel in SENSORS_EVENT format.
+ *
+ * The shared memory is used as a ring of records. Each record is written
+ * completely before its counter is stored with release semantics, so a
+ * reader that sees a new counter also sees the whole record. The counter
+ * starts at 1 and skips 0, which marks a record that was never written.
+ */
+class DirectChannel {
+public:
+  /**
+   * Maps size bytes of the shared memory fd. The channel takes ownership of
+   * the fd.
+   */
+  DirectChannel(int fd, size_t size);
+  ~DirectChannel();
+
+  bool isValid() const { return mRecords != nullptr; }
+
+  /**
+   * Appends the event, setting its version and counter fields.
+   */
+  void write(const DirectReportEvent& event);
+
+private:
+  int mFd;
+  size_t mMapSize;
+  DirectReportEvent* mRecords;
+  size_t mRecordCount;
+
+  std::mutex mLock;
+  size_t mWritePos;
+  uint32_t mCounter;
+};
+
+/**
+ * Direct reports of one sensor: the channels it writes to, each with its own
+ * report token and rate. Configured from the HAL threads and written from the
+ * sampler.
+ */
+class DirectReports {
+public:
+  /**
+   * Starts or changes the reports to the channel, or stops them if periodNs
+   * is 0.
+   */
+  void configure(const std::shared_ptr<DirectChannel>& channel, int32_t reportToken, int64_t periodNs);
+
+  /**
+   * Stops the reports to all channels.
+   */
+  void clear();
+
+  /**
+   * Returns the shortest period of all channels, or 0 if there is none.
+   */
+  int64_t getPeriod();
+
+  /**
+   * Writes the event to every channel whose period has elapsed, with the
+   * report token of that channel.
+   */
+  void write(DirectReportEvent& event);
+
+private:
+  struct Report {
+    std::shared_ptr<DirectChannel> channel;
+    int32_t reportToken;
+    int64_t periodNs;
+    int64_t lastTimestampNs;
+  };
+
+  std::mutex mLock;
+  std::vector<Report> mReports;
+};
+
+}  // namespace hwctl
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace rb
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace rb {
+namespace hardware {
+namespace sensors {
+namespace hwctl {
+
+/**
+ * Software batching FIFO of one sensor.
+ *
+ * While a maximum report latency is set, events are held back in a ring and
+ * delivered in bulk once the oldest one has waited for that latency or the
+ * ring is full. The ring is allocated once with the capacity advertised in
+ * fifoMaxEventCount; if it overflows anyway, the oldest events are dropped.
+ *
+ * Not thread safe, the owner must serialize all calls.
+ */
+template <typename EventT>
+class EventFifo {
+public:
+  void setCapacity(size_t capacity) {
+    mEvents.resize(capacity);
+    mTimestamps.resize(capacity);
+    mHead = 0;
+    mCount = 0;
+  }
+
+  size_t getCapacity() const { return mEvents.size(); }
+  size_t size() const { return mCount; }
+  uint64_t getDropped() const { return mDropped; }
+
+  void setMaxReportLatency(int64_t maxReportLatencyNs) { mMaxReportLatencyNs = maxReportLatencyNs; }
+  int64_t getMaxReportLatency() const { return mMaxReportLatencyNs; }
+  bool isBatching() const { return mMaxReportLatencyNs > 0 && !mEvents.empty(); }
+
+  /**
+   * Queues the event. Returns true if the queued events are due for delivery.
+   */
+  bool push(const EventT& event, int64_t timestampNs) {
+    if (mCount == mEvents.size()) {
+      mHead = (mHead + 1) % mEvents.size();
+      mCount--;
+      mDropped++;
+    }
+    size_t index = (mHead + mCount) % mEvents.size();
+    mEvents[index] = event;
+    mTimestamps[index] = timestampNs;
+    mCount++;
+    // The latency is measured from the oldest event still queued, not from
+    // one that was dropped on overflow
+    return mCount == mEvents.size() || timestampNs - mTimestamps[mHead] >= mMaxReportLatencyNs;
+  }
+
+  /**
+   * Moves all queued events, oldest first, to the end of events.
+   */
+  void drain(std::vector<EventT>& events) {
+    events.reserve(events.size() + mCount);
+    for (size_t i = 0; i < mCount; i++) {
+      events.push_back(mEvents[(mHead + i) % mEvents.size()]);
+    }
+    mHead = 0;
+    mCount = 0;
+  }
+
+  /**
+   * Moves all queued events, oldest first, into the uninitialized storage at
+   * events, which must have room for size() events.
+   */
+  void drain(EventT* events) {
+    size_t first = std::min(mCount, mEvents.size() - mHead);
+    std::uninitialized_copy_n(mEvents.begin() + mHead, first, events);
+    std::uninitialized_copy_n(mEvents.begin(), mCount - first, events + first);
+    mHead = 0;
+    mCount = 0;
+  }
+
+  /**
+   * Discards all queued events, counting them as dropped.
+   */
+  void clear() {
+    mDropped += mCount;
+    mHead = 0;
+    mCount = 0;
+  }
+
+private:
+  std::vector<EventT> mEvents;
+  std::vector<int64_t> mTimestamps;
+  size_t mHead = 0;
+  size_t mCount = 0;
+  uint64_t mDropped = 0;
+  int64_t mMaxReportLatencyNs = 0;
+};
+
+}  // namespace hwctl
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace rb
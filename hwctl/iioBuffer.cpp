@@ -0,0 +1,341 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "iioBuffer.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <log/log.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace rb {
+namespace hardware {
+namespace sensors {
+namespace hwctl {
+
+namespace {
+
+int32_t readAttr(const std::string& path, std::string& value) {
+  char buf[64];
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return -errno;
+  }
+  ssize_t ret = read(fd, buf, sizeof(buf) - 1);
+  int err = errno;
+  close(fd);
+  if (ret < 0) {
+    return -err;
+  }
+  buf[ret] = '\0';
+  value.assign(buf, strcspn(buf, "\n"));
+  return 0;
+}
+
+int32_t writeAttr(const std::string& path, const std::string& value) {
+  int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return -errno;
+  }
+  ssize_t ret = write(fd, value.c_str(), value.size());
+  int err = errno;
+  close(fd);
+  if (ret < 0) {
+    return -err;
+  }
+  return 0;
+}
+
+}  // namespace
+
+IioBuffer::IioBuffer(const std::string& sysfsDir, const std::string& devNode,
+                     const std::vector<std::string>& channels)
+  : mSysfsDir(sysfsDir),
+    mDevNode(devNode),
+    mHasTimestamp(false),
+    mScanSize(0),
+    mFd(-1),
+    mPending(0),
+    mUsers(0) {
+  mTimestamp.name = "in_timestamp";
+  for (size_t i = 0; i < channels.size() && i < IioFrame::kMaxChannels; i++) {
+    IioChannel channel;
+    channel.name = channels[i];
+    mChannels.push_back(channel);
+  }
+}
+
+IioBuffer::~IioBuffer() { disable(); }
+
+int32_t IioBuffer::start() {
+  std::lock_guard<std::mutex> lock(mLock);
+  if (mUsers++ == 0) {
+    return enable(kBufferLength);
+  }
+  return isEnabled() ? 0 : -ENODEV;
+}
+
+void IioBuffer::stop() {
+  std::lock_guard<std::mutex> lock(mLock);
+  if (mUsers > 0 && --mUsers == 0) {
+    disable();
+  }
+}
+
+ssize_t IioBuffer::readAvailable(IioFrame* frames, size_t count) {
+  std::lock_guard<std::mutex> lock(mLock);
+  ssize_t ret = readFrames(frames, count);
+  return ret == 0 ? -EAGAIN : ret;
+}
+
+int32_t IioBuffer::parseType(const std::string& type, IioChannel& channel) {
+  char endian;
+  char sign;
+  uint32_t realBits;
+  uint32_t storageBits;
+  uint32_t repeat = 1;
+  uint32_t shift;
+
+  if (sscanf(type.c_str(), "%ce:%c%u/%uX%u>>%u", &endian, &sign, &realBits, &storageBits, &repeat, &shift) != 6 &&
+      sscanf(type.c_str(), "%ce:%c%u/%u>>%u", &endian, &sign, &realBits, &storageBits, &shift) != 5) {
+    return -EINVAL;
+  }
+  if ((endian != 'b' && endian != 'l') || (sign != 's' && sign != 'u') || storageBits == 0 || storageBits > 64 ||
+      storageBits % 8 != 0 || realBits == 0 || realBits + shift > storageBits || repeat == 0 ||
+      repeat > IioFrame::kMaxChannels) {
+    return -EINVAL;
+  }
+
+  channel.isBigEndian = (endian == 'b');
+  channel.isSigned = (sign == 's');
+  channel.realBits = realBits;
+  channel.storageBits = storageBits;
+  channel.repeat = repeat;
+  channel.shift = shift;
+  return 0;
+}
+
+int64_t IioBuffer::decode(const uint8_t* scan, const IioChannel& channel, uint32_t element) {
+  uint32_t bytes = channel.storageBits / 8;
+  const uint8_t* data = scan + channel.offset + element * bytes;
+  uint64_t raw = 0;
+
+  for (uint32_t i = 0; i < bytes; i++) {
+    raw = (raw << 8) | data[channel.isBigEndian ? i : bytes - 1 - i];
+  }
+  raw >>= channel.shift;
+
+  if (channel.realBits < 64) {
+    uint64_t mask = (1ULL << channel.realBits) - 1;
+    raw &= mask;
+    if (channel.isSigned && (raw & (1ULL << (channel.realBits - 1)))) {
+      raw |= ~mask;
+    }
+  }
+  return static_cast<int64_t>(raw);
+}
+
+int32_t IioBuffer::setupScanElements() {
+  std::string scanDir = mSysfsDir + "/scan_elements";
+  DIR* dir = opendir(scanDir.c_str());
+  if (dir == nullptr) {
+    ALOGE("Failed to open %s", scanDir.c_str());
+    return -errno;
+  }
+
+  // Enable exactly the requested channels, so the scan layout only depends on
+  // the channels known to this engine.
+  int32_t ret = 0;
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != nullptr) {
+    std::string file = entry->d_name;
+    if (file.size() <= 3 || file.compare(file.size() - 3, 3, "_en") != 0) {
+      continue;
+    }
+    std::string name = file.substr(0, file.size() - 3);
+    auto channel = std::find_if(mChannels.begin(), mChannels.end(), [&](const auto& c) { return c.name == name; });
+    bool wanted = (channel != mChannels.end()) || (mHasTimestamp && name == mTimestamp.name);
+
+    ret = writeAttr(scanDir + "/" + file, wanted ? "1" : "0");
+    if (ret < 0) {
+      ALOGE("Failed to write %s/%s", scanDir.c_str(), file.c_str());
+      break;
+    }
+  }
+  closedir(dir);
+  if (ret < 0) {
+    return ret;
+  }
+
+  std::vector<IioChannel*> ordered;
+  for (auto& channel : mChannels) {
+    ordered.push_back(&channel);
+  }
+  if (mHasTimestamp) {
+    ordered.push_back(&mTimestamp);
+  }
+
+  for (auto* channel : ordered) {
+    std::string value;
+    ret = readAttr(scanDir + "/" + channel->name + "_index", value);
+    if (ret == 0) {
+      channel->index = atoi(value.c_str());
+      ret = readAttr(scanDir + "/" + channel->name + "_type", value);
+    }
+    if (ret == 0) {
+      ret = parseType(value, *channel);
+    }
+    if (ret < 0) {
+      ALOGE("Failed to read scan element %s", channel->name.c_str());
+      return ret;
+    }
+  }
+
+  // Channels are packed in index order, each one aligned to its storage size,
+  // and the whole scan is padded to the largest alignment.
+  std::sort(ordered.begin(), ordered.end(), [](const auto* a, const auto* b) { return a->index < b->index; });
+
+  uint32_t offset = 0;
+  uint32_t maxAlign = 1;
+  for (auto* channel : ordered) {
+    uint32_t bytes = channel->storageBits / 8;
+    offset = (offset + bytes - 1) / bytes * bytes;
+    channel->offset = offset;
+    offset += bytes * channel->repeat;
+    maxAlign = std::max(maxAlign, bytes);
+  }
+  mScanSize = (offset + maxAlign - 1) / maxAlign * maxAlign;
+
+  if (mScanSize == 0) {
+    ALOGE("No scan element of %s is enabled", mSysfsDir.c_str());
+    return -EINVAL;
+  }
+  return 0;
+}
+
+bool IioBuffer::setupTimestamp() {
+  if (access((mSysfsDir + "/scan_elements/" + mTimestamp.name + "_en").c_str(), F_OK) != 0) {
+    return false;
+  }
+  // Kernel timestamps default to CLOCK_REALTIME, which is useless for events
+  int32_t ret = writeAttr(mSysfsDir + "/current_timestamp_clock", "boottime");
+  if (ret < 0) {
+    ALOGW("Failed to select boottime timestamps for %s: %d", mSysfsDir.c_str(), ret);
+    return false;
+  }
+  return true;
+}
+
+int32_t IioBuffer::enable(uint32_t length) {
+  if (mFd >= 0) {
+    return 0;
+  }
+
+  writeAttr(mSysfsDir + "/buffer/enable", "0");
+
+  mHasTimestamp = setupTimestamp();
+  int32_t ret = setupScanElements();
+  if (ret == 0) {
+    ret = writeAttr(mSysfsDir + "/buffer/length", std::to_string(length));
+  }
+  if (ret == 0) {
+    ret = writeAttr(mSysfsDir + "/buffer/enable", "1");
+  }
+  if (ret < 0) {
+    ALOGE("Failed to enable IIO buffer of %s: %d", mSysfsDir.c_str(), ret);
+    return ret;
+  }
+
+  mFd = open(mDevNode.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+  if (mFd < 0) {
+    ret = -errno;
+    ALOGE("Failed to open %s", mDevNode.c_str());
+    writeAttr(mSysfsDir + "/buffer/enable", "0");
+    return ret;
+  }
+
+  mScanBuffer.resize(mScanSize * kScansPerRead);
+  mPending = 0;
+  return 0;
+}
+
+void IioBuffer::disable() {
+  if (mFd < 0) {
+    return;
+  }
+  close(mFd);
+  mFd = -1;
+  writeAttr(mSysfsDir + "/buffer/enable", "0");
+}
+
+ssize_t IioBuffer::readFrames(IioFrame* frames, size_t count) {
+  if (mFd < 0) {
+    return -ENODEV;
+  }
+  if (mScanSize == 0) {
+    return -EINVAL;
+  }
+
+  size_t decoded = 0;
+  for (;;) {
+    size_t consumed = 0;
+    while (mPending - consumed >= mScanSize && decoded < count) {
+      decodeScan(mScanBuffer.data() + consumed, frames[decoded++]);
+      consumed += mScanSize;
+    }
+    // Keep a partial scan, or scans beyond count, for the next call
+    memmove(mScanBuffer.data(), mScanBuffer.data() + consumed, mPending - consumed);
+    mPending -= consumed;
+    if (decoded == count) {
+      break;
+    }
+
+    ssize_t ret = read(mFd, mScanBuffer.data() + mPending, mScanBuffer.size() - mPending);
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ret < 0 && errno != EAGAIN) {
+      return -errno;
+    }
+    if (ret <= 0) {
+      break;
+    }
+    mPending += ret;
+  }
+
+  return decoded;
+}
+
+void IioBuffer::decodeScan(const uint8_t* scan, IioFrame& frame) const {
+  size_t slot = 0;
+  for (const auto& channel : mChannels) {
+    for (uint32_t element = 0; element < channel.repeat && slot < IioFrame::kMaxChannels; element++) {
+      frame.values[slot++] = decode(scan, channel, element);
+    }
+  }
+  frame.timestamp = mHasTimestamp ? decode(scan, mTimestamp) : 0;
+}
+
+}  // namespace hwctl
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace rb
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace rb {
+namespace hardware {
+namespace sensors {
+namespace hwctl {
+
+/**
+ * Position and encoding of one channel inside a buffered IIO scan, as
+ * described by scan_elements/<channel>_index and scan_elements/<channel>_type.
+ */
+struct IioChannel {
+  std::string name;
+  int32_t index = -1;
+  bool isSigned = false;
+  bool isBigEndian = false;
+  uint32_t realBits = 0;
+  uint32_t storageBits = 0;
+  uint32_t repeat = 1;
+  uint32_t shift = 0;
+  uint32_t offset = 0;
+};
+
+/**
+ * One decoded scan. The values are stored in the order in which the channels
+ * were passed to the IioBuffer constructor, a channel with a repeat count
+ * taking that many consecutive slots. timestamp is the CLOCK_BOOTTIME capture
+ * time from the in_timestamp channel, or 0 if the device has none.
+ */
+struct IioFrame {
+  static constexpr size_t kMaxChannels = 8;
+  int64_t values[kMaxChannels];
+  int64_t timestamp;
+};
+
+/**
+ * Acquisition engine for the buffered mode of an IIO device.
+ *
+ * The buffer is configured through the sysfs directory of the device
+ * (scan_elements, buffer/length, buffer/enable) and the packed binary scans
+ * are read from its character device. Both paths are passed in so the engine
+ * can be run against a synthetic sysfs tree and a FIFO.
+ *
+ * If the device offers an in_timestamp channel, it is enabled with the
+ * timestamp clock of the device switched to boottime, so every frame carries
+ * the kernel capture time in the timebase of Android events.
+ */
+class IioBuffer {
+public:
+  IioBuffer(const std::string& sysfsDir, const std::string& devNode, const std::vector<std::string>& channels);
+  ~IioBuffer();
+
+  /**
+   * Reference counted enable/disable of the buffer. The buffer is enabled for
+   * the first user and disabled again once the last user has stopped. start()
+   * returns 0 or the negative errno of enabling the buffer, the user must call
+   * stop() in either case.
+   */
+  int32_t start();
+  void stop();
+
+  /**
+   * Reads up to count of the scans queued in the device, oldest first, so
+   * every scan is delivered exactly once. Returns the number of frames,
+   * -EAGAIN if no new scan was queued since the last call, or another
+   * negative errno if the buffer is not enabled or the read failed.
+   */
+  ssize_t readAvailable(IioFrame* frames, size_t count);
+
+  /**
+   * Reads and decodes up to count complete scans without blocking. Returns the
+   * number of decoded frames or a negative errno.
+   */
+  ssize_t readFrames(IioFrame* frames, size_t count);
+
+  int32_t enable(uint32_t length);
+  void disable();
+  bool isEnabled() const { return mFd >= 0; }
+  bool hasTimestamp() const { return mHasTimestamp; }
+  size_t getScanSize() const { return mScanSize; }
+
+  static int32_t parseType(const std::string& type, IioChannel& channel);
+  /**
+   * Decodes the element-th value of a channel with a repeat count.
+   */
+  static int64_t decode(const uint8_t* scan, const IioChannel& channel, uint32_t element = 0);
+
+private:
+  static constexpr uint32_t kBufferLength = 64;
+  static constexpr size_t kScansPerRead = 16;
+
+  int32_t setupScanElements();
+  bool setupTimestamp();
+  void decodeScan(const uint8_t* scan, IioFrame& frame) const;
+
+  std::string mSysfsDir;
+  std::string mDevNode;
+  // Requested channels, in frame order
+  std::vector<IioChannel> mChannels;
+  IioChannel mTimestamp;
+  bool mHasTimestamp;
+  size_t mScanSize;
+
+  int mFd;
+  std::vector<uint8_t> mScanBuffer;
+  size_t mPending;
+
+  std::mutex mLock;
+  uint32_t mUsers;
+};
+
+}  // namespace hwctl
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace rb
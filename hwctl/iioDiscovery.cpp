@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "iioDiscovery.h"
+
+#include <dirent.h>
+#include <log/log.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+#include "iioHwctl.h"
+
+namespace rb {
+namespace hardware {
+namespace sensors {
+namespace hwctl {
+
+namespace {
+
+constexpr const char* kDevicePrefix = "iio:device";
+
+std::vector<std::string> listDir(const std::string& path) {
+  std::vector<std::string> entries;
+  DIR* dir = opendir(path.c_str());
+  if (dir == nullptr) {
+    return entries;
+  }
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != nullptr) {
+    entries.push_back(entry->d_name);
+  }
+  closedir(dir);
+  return entries;
+}
+
+std::string readLine(const std::string& path) {
+  char buf[64];
+  SysfsAttribute attribute(path);
+  if (attribute.read(buf, sizeof(buf)) <= 0) {
+    return "";
+  }
+  return std::string(buf, strcspn(buf, "\n"));
+}
+
+}  // namespace
+
+float toAndroidScale(float scale, IioScaleUnit unit) {
+  switch (unit) {
+    case IioScaleUnit::kStandardGravity:
+      return scale * 9.80665f;
+    case IioScaleUnit::kDegreesPerSecond:
+      return scale * static_cast<float>(M_PI / 180.0);
+    case IioScaleUnit::kMetersPerSecondSquared:
+    case IioScaleUnit::kRadiansPerSecond:
+    default:
+      return scale;
+  }
+}
+
+float IioDevice::getScale(const std::string& attribute, float defaultScale) const {
+  auto scale = scales.find(attribute);
+  return (scale != scales.end() && scale->second > 0.0f) ? scale->second : defaultScale;
+}
+
+std::vector<IioDevice> IioDiscovery::find(const std::string& name) {
+  static const std::vector<IioDevice> sDevices = scan(kSysfsRoot, kDevRoot);
+
+  std::vector<IioDevice> devices;
+  std::copy_if(sDevices.begin(), sDevices.end(), std::back_inserter(devices),
+               [&](const auto& device) { return device.name == name; });
+  return devices;
+}
+
+std::vector<IioDevice> IioDiscovery::scan(const std::string& sysfsRoot, const std::string& devRoot) {
+  std::vector<std::pair<int32_t, IioDevice>> found;
+
+  for (const auto& entry : listDir(sysfsRoot)) {
+    if (entry.compare(0, strlen(kDevicePrefix), kDevicePrefix) != 0) {
+      continue;
+    }
+    IioDevice device;
+    device.sysfsDir = sysfsRoot + "/" + entry;
+    device.devNode = devRoot + "/" + entry;
+    device.name = readLine(device.getPath("name"));
+    if (device.name.empty()) {
+      continue;
+    }
+
+    for (const auto& attribute : listDir(device.sysfsDir)) {
+      if (attribute.size() > 6 && attribute.compare(attribute.size() - 6, 6, "_scale") == 0) {
+        device.scales[attribute] = strtof(readLine(device.getPath(attribute)).c_str(), nullptr);
+      }
+    }
+    found.emplace_back(atoi(entry.c_str() + strlen(kDevicePrefix)), device);
+  }
+
+  // readdir() order is arbitrary, instances follow the device numbers
+  std::sort(found.begin(), found.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+  std::vector<IioDevice> devices;
+  std::map<std::string, uint32_t> instances;
+  for (auto& entry : found) {
+    entry.second.instance = instances[entry.second.name]++;
+    ALOGI("Found IIO device %s (%s #%u)", entry.second.sysfsDir.c_str(), entry.second.name.c_str(),
+          entry.second.instance);
+    devices.push_back(entry.second);
+  }
+  return devices;
+}
+
+}  // namespace hwctl
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace rb
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace rb {
+namespace hardware {
+namespace sensors {
+namespace hwctl {
+
+/**
+ * Unit of the value of one LSB given by a <channel>_scale attribute. The IIO
+ * ABI specifies m/s^2 for accelerometers and rad/s for gyroscopes, but some
+ * drivers report g and degrees per second instead.
+ */
+enum class IioScaleUnit {
+  kMetersPerSecondSquared,
+  kStandardGravity,
+  kRadiansPerSecond,
+  kDegreesPerSecond,
+};
+
+/**
+ * Converts a scale to the unit of Android sensor events, i.e. m/s^2 or rad/s.
+ */
+float toAndroidScale(float scale, IioScaleUnit unit);
+
+/**
+ * One IIO device found on the system.
+ */
+struct IioDevice {
+  // Content of the name attribute, i.e. the driver name
+  std::string name;
+  // Index among the devices with the same name, in device number order
+  uint32_t instance = 0;
+  std::string sysfsDir;
+  std::string devNode;
+  // Values of all <channel>_scale attributes, keyed by attribute name
+  std::map<std::string, float> scales;
+
+  std::string getPath(const std::string& attribute) const { return sysfsDir + "/" + attribute; }
+  float getScale(const std::string& attribute, float defaultScale) const;
+};
+
+/**
+ * Discovery of the IIO devices through the name attribute of every
+ * /sys/bus/iio/devices/iio:deviceN directory.
+ */
+class IioDiscovery {
+public:
+  static constexpr const char* kSysfsRoot = "/sys/bus/iio/devices";
+  static constexpr const char* kDevRoot = "/dev";
+
+  /**
+   * Returns all devices with the given driver name. The system is scanned
+   * once on first use and the result is cached for the process lifetime.
+   */
+  static std::vector<IioDevice> find(const std::string& name);
+
+  /**
+   * Scans the given sysfs tree. The roots are passed in so discovery can be
+   * run against a synthetic sysfs tree.
+   */
+  static std::vector<IioDevice> scan(const std::string& sysfsRoot, const std::string& devRoot);
+};
+
+}  // namespace hwctl
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace rb
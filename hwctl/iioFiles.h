@@ -16,15 +16,53 @@
  
 #pragma once
 
+#include <stddef.h>
+
 #include <string>
+#include <vector>
+
+#include "iioDiscovery.h"
 
 namespace rb {
 namespace hardware {
 namespace sensors {
 namespace hwctl {
 
-const std::string SMI240ACC = "/sys/bus/iio/devices/iio:device0/in_accel_x&y&z_raw";
-const std::string SMI240GYRO = "/sys/bus/iio/devices/iio:device0/in_anglvel_x&y&z_raw";
+// Driver name reported by the name attribute of every SMI240 IIO device
+const std::string SMI240NAME = "smi240";
+
+// Device used if discovery does not find any SMI240
+const std::string SMI240DEVICE = "/sys/bus/iio/devices/iio:device0";
+const std::string SMI240CHRDEV = "/dev/iio:device0";
+
+// Attributes, relative to the sysfs directory of the device
+const std::string SMI240ACC = "in_accel_x&y&z_raw";
+const std::string SMI240GYRO = "in_anglvel_x&y&z_raw";
+const std::string SMI240ACC_SCALE = "in_accel_scale";
+const std::string SMI240GYRO_SCALE = "in_anglvel_scale";
+
+// The SMI240 driver reports its scales in g and degrees per second. The
+// defaults are used if a scale attribute is missing.
+constexpr IioScaleUnit SMI240ACC_SCALE_UNIT = IioScaleUnit::kStandardGravity;
+constexpr IioScaleUnit SMI240GYRO_SCALE_UNIT = IioScaleUnit::kDegreesPerSecond;
+constexpr float SMI240ACC_DEFAULT_SCALE = 1.0f / 2000.0f;
+constexpr float SMI240GYRO_DEFAULT_SCALE = 1.0f / 100.0f;
+
+// Raw values at the end of the measurement range, +-16 g and +-300 dps at the
+// default scales
+constexpr float SMI240ACC_FULL_SCALE_RAW = 32000.0f;
+constexpr float SMI240GYRO_FULL_SCALE_RAW = 30000.0f;
+
+// Channels enabled in buffered mode. The order defines the position of each
+// value in a decoded IioFrame.
+const std::vector<std::string> SMI240CHANNELS = {"in_accel_x",   "in_accel_y",   "in_accel_z",
+                                                 "in_anglvel_x", "in_anglvel_y", "in_anglvel_z"};
+constexpr size_t SMI240ACC_SLOT = 0;
+constexpr size_t SMI240GYRO_SLOT = 3;
+
+// Raw attributes read when buffered mode is not available, filling the same
+// slots as SMI240CHANNELS
+const std::vector<std::string> SMI240RAW = {SMI240ACC, SMI240GYRO};
 
 }  // namespace hwctl
 }  // namespace sensors
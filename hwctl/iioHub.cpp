@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "iioHub.h"
+
+#include <errno.h>
+#include <log/log.h>
+
+#include <algorithm>
+#include <map>
+
+#include "rawTriplet.h"
+
+namespace rb {
+namespace hardware {
+namespace sensors {
+namespace hwctl {
+
+IioHub::IioHub(const IioDevice& device, const std::vector<std::string>& channels,
+               const std::vector<std::string>& rawAttributes)
+  : mSubscriptions(std::make_shared<Subscriptions>()),
+    mSamplingPeriodNs(0),
+    mDispatching(nullptr),
+    mBuffer(device.sysfsDir, device.devNode, channels),
+    mRateController(device),
+    mIsStarted(false),
+    mRatePeriodNs(0) {
+  for (const auto& attribute : rawAttributes) {
+    mRawAttributes.push_back(std::make_unique<SysfsAttribute>(device.getPath(attribute)));
+  }
+}
+
+IioHub::~IioHub() {
+  SensorScheduler::get().remove(this);
+  if (mIsStarted) {
+    mBuffer.stop();
+  }
+}
+
+std::shared_ptr<IioHub> IioHub::get(const IioDevice& device, const std::vector<std::string>& channels,
+                                    const std::vector<std::string>& rawAttributes) {
+  static std::mutex sLock;
+  static std::map<std::string, std::weak_ptr<IioHub>> sHubs;
+
+  std::lock_guard<std::mutex> lock(sLock);
+  std::shared_ptr<IioHub> hub = sHubs[device.sysfsDir].lock();
+  if (hub == nullptr) {
+    hub = std::make_shared<IioHub>(device, channels, rawAttributes);
+    sHubs[device.sysfsDir] = hub;
+  }
+  return hub;
+}
+
+void IioHub::subscribe(ISampleCallback* listener, int64_t samplingPeriodNs) {
+  std::lock_guard<std::mutex> lock(mControlLock);
+  auto subscriptions = std::make_shared<Subscriptions>(*mSubscriptions);
+  auto it = std::find_if(subscriptions->begin(), subscriptions->end(),
+                         [&](const auto& subscription) { return subscription.listener == listener; });
+  if (it == subscriptions->end()) {
+    subscriptions->emplace_back(listener, samplingPeriodNs);
+  } else if (it->samplingPeriodNs != samplingPeriodNs) {
+    it->samplingPeriodNs = samplingPeriodNs;
+  } else {
+    return;
+  }
+  publish(subscriptions);
+}
+
+void IioHub::setSamplingPeriod(ISampleCallback* listener, int64_t samplingPeriodNs) {
+  std::lock_guard<std::mutex> lock(mControlLock);
+  auto subscriptions = std::make_shared<Subscriptions>(*mSubscriptions);
+  for (auto& subscription : *subscriptions) {
+    if (subscription.listener == listener) {
+      subscription.samplingPeriodNs = samplingPeriodNs;
+    }
+  }
+  publish(subscriptions);
+}
+
+void IioHub::unsubscribe(ISampleCallback* listener) {
+  std::lock_guard<std::mutex> lock(mControlLock);
+  auto subscriptions = std::make_shared<Subscriptions>(*mSubscriptions);
+  auto it = std::remove_if(subscriptions->begin(), subscriptions->end(),
+                           [&](const auto& subscription) { return subscription.listener == listener; });
+  if (it == subscriptions->end()) {
+    return;
+  }
+
+  subscriptions->erase(it, subscriptions->end());
+  publish(subscriptions);
+}
+
+void IioHub::waitForDispatch(ISampleCallback* listener) {
+  std::unique_lock<std::mutex> lock(mControlLock);
+  mDispatchCV.wait(lock, [&] { return mDispatching != listener; });
+}
+
+int64_t IioHub::getSamplingPeriod(const Subscriptions& subscriptions) {
+  int64_t samplingPeriodNs = 0;
+  for (const auto& subscription : subscriptions) {
+    if (samplingPeriodNs == 0 || subscription.samplingPeriodNs < samplingPeriodNs) {
+      samplingPeriodNs = subscription.samplingPeriodNs;
+    }
+  }
+  return samplingPeriodNs;
+}
+
+void IioHub::publish(std::shared_ptr<const Subscriptions> subscriptions) {
+  std::atomic_store(&mSubscriptions, subscriptions);
+
+  // Once the last subscriber is gone, the sampler releases the device and
+  // pauses itself on its next deadline.
+  int64_t samplingPeriodNs = getSamplingPeriod(*subscriptions);
+  if (samplingPeriodNs > 0 && mSamplingPeriodNs != samplingPeriodNs) {
+    mSamplingPeriodNs = samplingPeriodNs;
+    SensorScheduler::get().schedule(this, mSamplingPeriodNs);
+  }
+}
+
+void IioHub::release() {
+  {
+    std::lock_guard<std::mutex> lock(mControlLock);
+    // A subscriber may have arrived since the snapshot was taken
+    if (!mSubscriptions->empty()) {
+      return;
+    }
+    mSamplingPeriodNs = 0;
+    SensorScheduler::get().schedule(this, 0);
+  }
+
+  if (mIsStarted) {
+    mBuffer.stop();
+    mIsStarted = false;
+  }
+}
+
+void IioHub::onDeadline(int64_t deadlineNs, int64_t /* nowNs */) {
+  std::shared_ptr<const Subscriptions> subscriptions = std::atomic_load(&mSubscriptions);
+  if (subscriptions->empty()) {
+    release();
+    return;
+  }
+
+  int64_t samplingPeriodNs = getSamplingPeriod(*subscriptions);
+  if (samplingPeriodNs != mRatePeriodNs) {
+    applyRate(samplingPeriodNs);
+  }
+  if (!mIsStarted) {
+    mBuffer.start();
+    mIsStarted = true;
+  }
+
+  int32_t ret = mBuffer.isEnabled() ? readBuffer(samplingPeriodNs, *subscriptions) : -ENODEV;
+  if (ret == 0 || ret == -EAGAIN) {
+    return;
+  }
+
+  // Without the buffer the middle of the read is the best estimate of the
+  // capture time, which takes the read latency out of the timestamp.
+  IioSample sample;
+  int64_t readStartNs = PeriodicTimer::now();
+  if (readRawAttributes(sample) == 0) {
+    int64_t readEndNs = PeriodicTimer::now();
+    sample.timestamp = readStartNs + (readEndNs - readStartNs) / 2;
+    dispatch(sample, deadlineNs, samplingPeriodNs, *subscriptions);
+  }
+}
+
+void IioHub::applyRate(int64_t samplingPeriodNs) {
+  // Only done when the subscriptions change. A failed write is not retried
+  // before the next change, so it is logged once.
+  mRatePeriodNs = samplingPeriodNs;
+  float rateHz = 1e9f / samplingPeriodNs;
+  if (!mRateController.needsUpdate(rateHz)) {
+    return;
+  }
+
+  // Drivers reject rate changes with EBUSY while the buffer is enabled
+  if (mIsStarted) {
+    mBuffer.stop();
+    mIsStarted = false;
+  }
+  mRateController.setRate(rateHz);
+}
+
+PeriodicTimerStats IioHub::getStats() { return SensorScheduler::get().getStats(this); }
+
+int32_t IioHub::readBuffer(int64_t samplingPeriodNs, const Subscriptions& subscriptions) {
+  IioFrame frames[kFramesPerRead];
+  ssize_t count;
+  bool isFirstRead = true;
+
+  do {
+    count = mBuffer.readAvailable(frames, kFramesPerRead);
+    if (count < 0) {
+      // Running dry after a full read is the normal end of a drain
+      return isFirstRead ? count : 0;
+    }
+    isFirstRead = false;
+
+    // Scans without a kernel timestamp are placed on the period grid, ending
+    // at the read time
+    int64_t readTimeNs = PeriodicTimer::now();
+    for (ssize_t i = 0; i < count; i++) {
+      IioSample sample;
+      std::copy(std::begin(frames[i].values), std::end(frames[i].values), std::begin(sample.values));
+      sample.timestamp = frames[i].timestamp != 0 ? frames[i].timestamp
+                                                  : readTimeNs - (count - 1 - i) * samplingPeriodNs;
+      dispatch(sample, sample.timestamp, samplingPeriodNs, subscriptions);
+    }
+  } while (count == static_cast<ssize_t>(kFramesPerRead));
+  return 0;
+}
+
+int32_t IioHub::readRawAttributes(IioSample& sample) {
+  // Fallback to the raw sysfs attributes, one x&y&z triplet per attribute
+  char data[64];
+  for (size_t i = 0; i < mRawAttributes.size() && (i + 1) * 3 <= IioFrame::kMaxChannels; i++) {
+    int32_t raw[3];
+    if (mRawAttributes[i]->read(data, sizeof(data)) <= 0 || !parseRawTriplet(data, raw)) {
+      ALOGE("IioHub failed to read %s", mRawAttributes[i]->getPath().c_str());
+      return -EIO;
+    }
+    sample.values[i * 3] = raw[0];
+    sample.values[i * 3 + 1] = raw[1];
+    sample.values[i * 3 + 2] = raw[2];
+  }
+  return 0;
+}
+
+void IioHub::dispatch(const IioSample& sample, int64_t deadlineNs, int64_t samplingPeriodNs,
+                      const Subscriptions& subscriptions) {
+  // A subscriber is due if its next sample time falls within half a hub period
+  // of this deadline, so that slower subscribers stay on the grid of the hub.
+  for (const auto& subscription : subscriptions) {
+    int64_t lastSampleTimeNs = subscription.lastSampleTimeNs.load(std::memory_order_relaxed);
+    if (deadlineNs + samplingPeriodNs / 2 >= lastSampleTimeNs + subscription.samplingPeriodNs) {
+      subscription.lastSampleTimeNs.store(deadlineNs, std::memory_order_relaxed);
+      if (beginDispatch(subscription.listener)) {
+        subscription.listener->onSample(sample);
+        endDispatch();
+      }
+    }
+  }
+}
+
+bool IioHub::beginDispatch(ISampleCallback* listener) {
+  // The snapshot may be outdated, only call listeners that are still subscribed
+  std::lock_guard<std::mutex> lock(mControlLock);
+  auto it = std::find_if(mSubscriptions->begin(), mSubscriptions->end(),
+                         [&](const auto& subscription) { return subscription.listener == listener; });
+  if (it == mSubscriptions->end()) {
+    return false;
+  }
+  mDispatching = listener;
+  return true;
+}
+
+void IioHub::endDispatch() {
+  {
+    std::lock_guard<std::mutex> lock(mControlLock);
+    mDispatching = nullptr;
+  }
+  mDispatchCV.notify_all();
+}
+
+}  // namespace hwctl
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace rb
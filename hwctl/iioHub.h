@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "iioBuffer.h"
+#include "iioDiscovery.h"
+#include "iioHwctl.h"
+#include "rateController.h"
+#include "sensorScheduler.h"
+
+namespace rb {
+namespace hardware {
+namespace sensors {
+namespace hwctl {
+
+/**
+ * One acquisition of all channels of a device. The values are stored in the
+ * same slots as in IioFrame.
+ */
+struct IioSample {
+  // CLOCK_BOOTTIME capture time, from the kernel if the device provides it
+  int64_t timestamp;
+  int64_t values[IioFrame::kMaxChannels];
+};
+
+class ISampleCallback {
+public:
+  virtual ~ISampleCallback(){};
+  virtual void onSample(const IioSample& sample) = 0;
+};
+
+/**
+ * Acquisition hub of one IIO device.
+ *
+ * All sensors backed by the same device subscribe to the hub. The hub is a job
+ * of the SensorScheduler and reads every channel of the device once per period, either from the IIO
+ * buffer or, if buffered mode is not available, from the raw sysfs
+ * attributes, and hands the same sample to every subscriber that is due. In
+ * buffered mode every scan queued since the last period is handed on, in
+ * order, and a period without a new scan is skipped. The
+ * hub runs at the shortest period requested by its subscribers, and the output
+ * data rate of the device is set to match it.
+ */
+class IioHub : public IScheduledJob {
+public:
+  /**
+   * rawAttributes lists the x&y&z raw sysfs attributes of the device used as
+   * fallback; each of them fills three consecutive slots of a sample.
+   */
+  IioHub(const IioDevice& device, const std::vector<std::string>& channels,
+         const std::vector<std::string>& rawAttributes);
+  ~IioHub();
+
+  /**
+   * Returns the hub shared by all sensors of the given device, creating it on
+   * first use.
+   */
+  static std::shared_ptr<IioHub> get(const IioDevice& device, const std::vector<std::string>& channels,
+                                     const std::vector<std::string>& rawAttributes);
+
+  /**
+   * Subscription changes only publish a new configuration for the sampler and
+   * never wait for an acquisition or a callback in progress. subscribe() only
+   * changes the period of a listener that is already subscribed.
+   */
+  void subscribe(ISampleCallback* listener, int64_t samplingPeriodNs);
+  void setSamplingPeriod(ISampleCallback* listener, int64_t samplingPeriodNs);
+
+  /**
+   * Removes the listener. Once this returns, no new onSample() call is started
+   * on the listener, but one may still be in progress.
+   */
+  void unsubscribe(ISampleCallback* listener);
+
+  /**
+   * Waits until no onSample() call is in progress on the listener. Must be
+   * called after unsubscribe() before the listener is destroyed.
+   */
+  void waitForDispatch(ISampleCallback* listener);
+
+  PeriodicTimerStats getStats();
+
+  void onDeadline(int64_t deadlineNs, int64_t nowNs) override;
+
+private:
+  static constexpr size_t kFramesPerRead = 16;
+
+  struct Subscription {
+    ISampleCallback* listener;
+    int64_t samplingPeriodNs;
+    // Deadline of the last sample dispatched to the listener. Only written by
+    // the sampler, and carried over into the next snapshot by the copy.
+    mutable std::atomic<int64_t> lastSampleTimeNs;
+
+    Subscription(ISampleCallback* listener, int64_t samplingPeriodNs)
+      : listener(listener), samplingPeriodNs(samplingPeriodNs), lastSampleTimeNs(0) {}
+    Subscription(const Subscription& other)
+      : listener(other.listener),
+        samplingPeriodNs(other.samplingPeriodNs),
+        lastSampleTimeNs(other.lastSampleTimeNs.load(std::memory_order_relaxed)) {}
+    Subscription& operator=(const Subscription& other) {
+      listener = other.listener;
+      samplingPeriodNs = other.samplingPeriodNs;
+      lastSampleTimeNs.store(other.lastSampleTimeNs.load(std::memory_order_relaxed), std::memory_order_relaxed);
+      return *this;
+    }
+  };
+  using Subscriptions = std::vector<Subscription>;
+
+  static int64_t getSamplingPeriod(const Subscriptions& subscriptions);
+  void publish(std::shared_ptr<const Subscriptions> subscriptions);
+  void release();
+  void applyRate(int64_t samplingPeriodNs);
+  int32_t readBuffer(int64_t samplingPeriodNs, const Subscriptions& subscriptions);
+  int32_t readRawAttributes(IioSample& sample);
+  void dispatch(const IioSample& sample, int64_t deadlineNs, int64_t samplingPeriodNs,
+                const Subscriptions& subscriptions);
+  bool beginDispatch(ISampleCallback* listener);
+  void endDispatch();
+
+  // Control state. The subscriptions are replaced as a whole under
+  // mControlLock and read by the sampler through an atomic snapshot, so the
+  // control calls never wait for device I/O.
+  std::shared_ptr<const Subscriptions> mSubscriptions;
+  int64_t mSamplingPeriodNs;
+  ISampleCallback* mDispatching;
+  std::condition_variable mDispatchCV;
+  std::mutex mControlLock;
+
+  // Sampler state, only used from onDeadline()
+  IioBuffer mBuffer;
+  RateController mRateController;
+  std::vector<std::unique_ptr<SysfsAttribute>> mRawAttributes;
+  bool mIsStarted;
+  // Sampling period the rate of the device was last selected for
+  int64_t mRatePeriodNs;
+};
+
+}  // namespace hwctl
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace rb
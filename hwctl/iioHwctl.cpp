@@ -16,7 +16,10 @@
 
 #include "iioHwctl.h"
 
+#include <errno.h>
+#include <fcntl.h>
 #include <log/log.h>
+#include <unistd.h>
 
 #include <fstream>
 #include <string>
@@ -38,6 +41,91 @@ int32_t readFromFile(std::string* filename, std::string& result) {
   return 0;
 }
 
+SysfsAttribute::~SysfsAttribute() { close(); }
+
+void SysfsAttribute::setPath(const std::string& path) {
+  close();
+  mPath = path;
+}
+
+int32_t SysfsAttribute::open() {
+  mFd = ::open(mPath.c_str(), mFlags | O_CLOEXEC);
+  if (mFd < 0) {
+    int32_t err = -errno;
+    ALOGE("Failed to open file %s", mPath.c_str());
+    return err;
+  }
+  return 0;
+}
+
+void SysfsAttribute::close() {
+  if (mFd >= 0) {
+    ::close(mFd);
+    mFd = -1;
+  }
+}
+
+ssize_t SysfsAttribute::read(char* buf, size_t size) {
+  if (size == 0) {
+    return -EINVAL;
+  }
+
+  // A failed read, e.g. after the driver was rebound, is retried once on a
+  // freshly opened descriptor.
+  for (int attempt = 0; attempt < 2; attempt++) {
+    if (mFd < 0) {
+      int32_t ret = open();
+      if (ret < 0) {
+        return ret;
+      }
+    }
+
+    ssize_t ret;
+    do {
+      ret = pread(mFd, buf, size - 1, 0);
+    } while (ret < 0 && errno == EINTR);
+
+    if (ret >= 0) {
+      buf[ret] = '\0';
+      return ret;
+    }
+    ret = -errno;
+    close();
+    if (attempt > 0) {
+      ALOGE("Failed to read file %s", mPath.c_str());
+      return ret;
+    }
+  }
+  return -EIO;
+}
+
+ssize_t SysfsAttribute::write(const char* buf, size_t size) {
+  for (int attempt = 0; attempt < 2; attempt++) {
+    if (mFd < 0) {
+      int32_t ret = open();
+      if (ret < 0) {
+        return ret;
+      }
+    }
+
+    ssize_t ret;
+    do {
+      ret = pwrite(mFd, buf, size, 0);
+    } while (ret < 0 && errno == EINTR);
+
+    if (ret >= 0) {
+      return ret;
+    }
+    ret = -errno;
+    close();
+    if (attempt > 0) {
+      ALOGE("Failed to write file %s", mPath.c_str());
+      return ret;
+    }
+  }
+  return -EIO;
+}
+
 }  // namespace hwctl
 }  // namespace sensors
 }  // namespace hardware
@@ -16,6 +16,9 @@
 
 #pragma once
 
+#include <fcntl.h>
+#include <sys/types.h>
+
 #include <string>
 
 namespace rb {
@@ -25,7 +28,46 @@ namespace hwctl {
 
 int32_t readFromFile(std::string* filename, std::string& result);
 
-}
+/**
+ * Sysfs attribute that is opened once and re-read with pread() at offset 0,
+ * which makes the driver regenerate its content, or rewritten with pwrite().
+ * The descriptor is only reopened after a failed access.
+ */
+class SysfsAttribute {
+public:
+  SysfsAttribute() : mFlags(O_RDONLY), mFd(-1) {}
+  explicit SysfsAttribute(const std::string& path, int flags = O_RDONLY) : mPath(path), mFlags(flags), mFd(-1) {}
+  ~SysfsAttribute();
+
+  SysfsAttribute(const SysfsAttribute&) = delete;
+  SysfsAttribute& operator=(const SysfsAttribute&) = delete;
+
+  void setPath(const std::string& path);
+  const std::string& getPath() const { return mPath; }
+
+  /**
+   * Reads the attribute into buf and NUL-terminates it. Returns the number of
+   * bytes read or a negative errno.
+   */
+  ssize_t read(char* buf, size_t size);
+
+  /**
+   * Writes size bytes of buf to the attribute, which must have been opened
+   * with O_WRONLY or O_RDWR. Returns the number of bytes written or a negative
+   * errno.
+   */
+  ssize_t write(const char* buf, size_t size);
+
+private:
+  int32_t open();
+  void close();
+
+  std::string mPath;
+  int mFlags;
+  int mFd;
+};
+
+}  // namespace hwctl
 }  // namespace sensors
 }  // namespace hardware
 }  // namespace rb
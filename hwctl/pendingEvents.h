@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace rb {
+namespace hardware {
+namespace sensors {
+namespace hwctl {
+
+/**
+ * Bounded ring of events waiting for room in the Event FMQ.
+ *
+ * The ring is allocated once with its capacity. If it is full, droppable
+ * events, i.e. samples of continuous sensors that are superseded by the next
+ * ones, are dropped oldest first to make room. Other events, e.g. flush
+ * completions, are only dropped if the ring holds nothing droppable anymore,
+ * and are counted separately.
+ *
+ * Not thread safe, the owner must serialize all calls.
+ */
+template <typename EventT>
+class PendingEvents {
+public:
+  explicit PendingEvents(size_t capacity) : mEvents(capacity), mFlags(capacity) {}
+
+  size_t size() const { return mCount; }
+  size_t capacity() const { return mEvents.size(); }
+  bool empty() const { return mCount == 0; }
+  uint64_t getDropped() const { return mDropped; }
+  uint64_t getUndroppableDropped() const { return mUndroppableDropped; }
+
+  /**
+   * Grows the ring to hold at least capacity events. Must be called while the
+   * ring is empty.
+   */
+  void reserve(size_t capacity) {
+    if (mCount == 0 && capacity > mEvents.size()) {
+      mEvents.resize(capacity);
+      mFlags.resize(capacity);
+      mHead = 0;
+    }
+  }
+
+  /**
+   * Queues the events, each droppable if isDroppable(event) is true. Returns
+   * the number of wake-up events that were dropped, queued ones to make room
+   * or the new ones if there is none.
+   */
+  template <class IsDroppable>
+  size_t push(const EventT* events, size_t count, bool wakeup, IsDroppable isDroppable) {
+    size_t droppedWakeUps = 0;
+    size_t capacity = mEvents.size();
+    if (mCount + count > capacity) {
+      droppedWakeUps += dropOldest(mCount + count - capacity);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+      bool droppable = isDroppable(events[i]);
+      if (mCount == capacity) {
+        droppable ? mDropped++ : mUndroppableDropped++;
+        droppedWakeUps += wakeup ? 1 : 0;
+        continue;
+      }
+      size_t index = (mHead + mCount) % capacity;
+      mEvents[index] = events[i];
+      mFlags[index] = (droppable ? kDroppable : 0) | (wakeup ? kWakeUp : 0);
+      mCount++;
+    }
+    return droppedWakeUps;
+  }
+
+  /**
+   * Returns the oldest events that are contiguous in the ring, and their
+   * number in count.
+   */
+  const EventT* front(size_t* count) const {
+    *count = std::min(mCount, mEvents.size() - mHead);
+    return mEvents.data() + mHead;
+  }
+
+  /**
+   * Removes the count oldest events.
+   */
+  void pop(size_t count) {
+    count = std::min(count, mCount);
+    mHead = mEvents.empty() ? 0 : (mHead + count) % mEvents.size();
+    mCount -= count;
+  }
+
+  /**
+   * Discards all events, counting them as dropped. Returns the number of
+   * wake-up events among them.
+   */
+  size_t clear() {
+    size_t droppedWakeUps = 0;
+    for (size_t i = 0; i < mCount; i++) {
+      uint8_t flags = mFlags[(mHead + i) % mEvents.size()];
+      (flags & kDroppable) ? mDropped++ : mUndroppableDropped++;
+      droppedWakeUps += (flags & kWakeUp) ? 1 : 0;
+    }
+    mHead = 0;
+    mCount = 0;
+    return droppedWakeUps;
+  }
+
+private:
+  static constexpr uint8_t kDroppable = 1 << 0;
+  static constexpr uint8_t kWakeUp = 1 << 1;
+
+  /**
+   * Drops up to count droppable events, oldest first, and closes the gaps.
+   * Returns the number of wake-up events among them.
+   */
+  size_t dropOldest(size_t count) {
+    size_t capacity = mEvents.size();
+    size_t dropped = 0;
+    size_t droppedWakeUps = 0;
+    size_t kept = 0;
+    for (size_t i = 0; i < mCount; i++) {
+      size_t src = (mHead + i) % capacity;
+      if (dropped < count && (mFlags[src] & kDroppable)) {
+        dropped++;
+        droppedWakeUps += (mFlags[src] & kWakeUp) ? 1 : 0;
+        continue;
+      }
+      if (kept != i) {
+        size_t dst = (mHead + kept) % capacity;
+        mEvents[dst] = mEvents[src];
+        mFlags[dst] = mFlags[src];
+      }
+      kept++;
+    }
+    mCount = kept;
+    mDropped += dropped;
+    return droppedWakeUps;
+  }
+
+  std::vector<EventT> mEvents;
+  std::vector<uint8_t> mFlags;
+  size_t mHead = 0;
+  size_t mCount = 0;
+  uint64_t mDropped = 0;
+  uint64_t mUndroppableDropped = 0;
+};
+
+}  // namespace hwctl
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace rb
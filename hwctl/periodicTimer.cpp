@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "periodicTimer.h"
+
+#include <time.h>
+
+#include <algorithm>
+
+namespace rb {
+namespace hardware {
+namespace sensors {
+namespace hwctl {
+
+constexpr int64_t kNanosecondsInSeconds = 1000 * 1000 * 1000;
+
+PeriodicTimer::PeriodicTimer()
+  : mPeriodNs(0),
+    mNextDeadlineNs(0),
+    mStartTimeNs(0),
+    mSamples(0),
+    mSkipped(0),
+    mTotalLatenessNs(0),
+    mMaxLatenessNs(0) {}
+
+int64_t PeriodicTimer::now() {
+  timespec curTime;
+  clock_gettime(CLOCK_BOOTTIME, &curTime);
+  return (curTime.tv_sec * kNanosecondsInSeconds) + curTime.tv_nsec;
+}
+
+void PeriodicTimer::start(int64_t periodNs) {
+  mPeriodNs = periodNs;
+  mStartTimeNs = now();
+  mNextDeadlineNs = mStartTimeNs;
+  mSamples = 0;
+  mSkipped = 0;
+  mTotalLatenessNs = 0;
+  mMaxLatenessNs = 0;
+}
+
+void PeriodicTimer::setPeriod(int64_t periodNs) {
+  if (mPeriodNs == periodNs) {
+    return;
+  }
+  if (mSamples > 0) {
+    mNextDeadlineNs += periodNs - mPeriodNs;
+  }
+  mPeriodNs = periodNs;
+}
+
+void PeriodicTimer::advance(int64_t nowNs) {
+  int64_t latenessNs = std::max<int64_t>(nowNs - mNextDeadlineNs, 0);
+  mSamples++;
+  mTotalLatenessNs += latenessNs;
+  mMaxLatenessNs = std::max(mMaxLatenessNs, latenessNs);
+
+  mNextDeadlineNs += mPeriodNs;
+  if (mPeriodNs > 0 && nowNs - mNextDeadlineNs >= kMaxCatchUpPeriods * mPeriodNs) {
+    // Too far behind, e.g. after a suspend: skip to the first deadline that is
+    // still ahead instead of bursting through the missed ones.
+    int64_t missed = (nowNs - mNextDeadlineNs) / mPeriodNs + 1;
+    mNextDeadlineNs += missed * mPeriodNs;
+    mSkipped += missed;
+  }
+}
+
+PeriodicTimerStats PeriodicTimer::getStats() const {
+  PeriodicTimerStats stats;
+  int64_t elapsedNs = now() - mStartTimeNs;
+
+  stats.samples = mSamples;
+  stats.skipped = mSkipped;
+  stats.meanLatenessNs = mSamples > 0 ? mTotalLatenessNs / static_cast<int64_t>(mSamples) : 0;
+  stats.maxLatenessNs = mMaxLatenessNs;
+  stats.achievedRateHz =
+    (mSamples > 0 && elapsedNs > 0) ? static_cast<float>(mSamples) * kNanosecondsInSeconds / elapsedNs : 0.0f;
+  return stats;
+}
+
+}  // namespace hwctl
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace rb
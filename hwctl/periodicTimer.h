@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+namespace rb {
+namespace hardware {
+namespace sensors {
+namespace hwctl {
+
+struct PeriodicTimerStats {
+  // Number of deadlines served and skipped since the timer was started
+  uint64_t samples;
+  uint64_t skipped;
+  // Delay between a deadline and the time it was served
+  int64_t meanLatenessNs;
+  int64_t maxLatenessNs;
+  // Deadlines served per second since the timer was started
+  float achievedRateHz;
+};
+
+/**
+ * Sampling timer on a fixed grid of absolute CLOCK_BOOTTIME deadlines.
+ *
+ * Each served deadline advances the next one by exactly one period, so read
+ * latency and wakeup lateness do not accumulate into the delivered rate. A
+ * deadline that is missed by less than a period is served late (catch up);
+ * if more time has passed, the missed deadlines are skipped and counted.
+ *
+ * The timer only does the deadline bookkeeping; waiting for the deadlines is
+ * left to SensorScheduler. It is not thread safe and must be protected by the
+ * owner.
+ */
+class PeriodicTimer {
+public:
+  PeriodicTimer();
+
+  static int64_t now();
+
+  /**
+   * Restarts the grid with the first deadline at the current time.
+   */
+  void start(int64_t periodNs);
+
+  /**
+   * Changes the period, keeping the grid anchored at the last served deadline.
+   */
+  void setPeriod(int64_t periodNs);
+
+  int64_t getPeriod() const { return mPeriodNs; }
+  int64_t getNextDeadline() const { return mNextDeadlineNs; }
+  bool isDue(int64_t nowNs) const { return mPeriodNs > 0 && nowNs >= mNextDeadlineNs; }
+
+  /**
+   * Marks the current deadline as served at nowNs and moves to the next one.
+   */
+  void advance(int64_t nowNs);
+
+  PeriodicTimerStats getStats() const;
+
+private:
+  // Deadlines missed by up to this many periods are still served
+  static constexpr int64_t kMaxCatchUpPeriods = 1;
+
+  int64_t mPeriodNs;
+  int64_t mNextDeadlineNs;
+  int64_t mStartTimeNs;
+
+  uint64_t mSamples;
+  uint64_t mSkipped;
+  int64_t mTotalLatenessNs;
+  int64_t mMaxLatenessNs;
+};
+
+}  // namespace hwctl
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace rb
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rateController.h"
+
+#include <errno.h>
+#include <log/log.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace rb {
+namespace hardware {
+namespace sensors {
+namespace hwctl {
+
+RateController::RateController(const IioDevice& device)
+  : mIsSupported(false), mFrequency(device.getPath("sampling_frequency"), O_WRONLY), mRateHz(0.0f), mFailedRateHz(0.0f) {
+  if (access(mFrequency.getPath().c_str(), W_OK) != 0) {
+    ALOGI("%s has no writable sampling_frequency, the rate is not controlled", device.sysfsDir.c_str());
+    return;
+  }
+  mIsSupported = true;
+
+  char data[256];
+  SysfsAttribute available(device.getPath("sampling_frequency_available"));
+  if (access(available.getPath().c_str(), R_OK) == 0 && available.read(data, sizeof(data)) > 0) {
+    char* next = data;
+    for (;;) {
+      char* end;
+      float rate = strtof(next, &end);
+      if (end == next) {
+        break;
+      }
+      mAvailable.push_back(rate);
+      next = end;
+    }
+    std::sort(mAvailable.begin(), mAvailable.end());
+  }
+}
+
+float RateController::selectRate(const std::vector<float>& available, float rateHz) {
+  if (available.empty()) {
+    return rateHz;
+  }
+  // Rates are sorted, use the fastest one if none is fast enough
+  auto rate = std::lower_bound(available.begin(), available.end(), rateHz);
+  return rate != available.end() ? *rate : available.back();
+}
+
+bool RateController::needsUpdate(float rateHz) const {
+  return mIsSupported && rateHz > 0.0f && selectRate(mAvailable, rateHz) != mRateHz;
+}
+
+int32_t RateController::setRate(float rateHz) {
+  if (!needsUpdate(rateHz)) {
+    return 0;
+  }
+
+  float selected = selectRate(mAvailable, rateHz);
+
+  char data[32];
+  int len = snprintf(data, sizeof(data), "%.6g", selected);
+  ssize_t ret = mFrequency.write(data, len);
+  if (ret < 0) {
+    if (selected != mFailedRateHz) {
+      ALOGE("Failed to set %s to %s Hz: %zd", mFrequency.getPath().c_str(), data, ret);
+      mFailedRateHz = selected;
+    }
+    return ret;
+  }
+  mRateHz = selected;
+  mFailedRateHz = 0.0f;
+  return 0;
+}
+
+}  // namespace hwctl
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace rb
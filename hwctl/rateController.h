@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "iioDiscovery.h"
+#include "iioHwctl.h"
+
+namespace rb {
+namespace hardware {
+namespace sensors {
+namespace hwctl {
+
+/**
+ * Output data rate control of one IIO device.
+ *
+ * The rate is written to the sampling_frequency attribute of the device
+ * through a persistent descriptor. A requested rate is rounded up to the next
+ * rate listed in sampling_frequency_available, and nothing is written if that
+ * does not change the rate of the device.
+ *
+ * Not thread safe, the owner must serialize all calls.
+ */
+class RateController {
+public:
+  explicit RateController(const IioDevice& device);
+
+  /**
+   * Sets the device to the lowest supported rate of at least rateHz. Returns 0
+   * on success or a negative errno.
+   */
+  int32_t setRate(float rateHz);
+  float getRate() const { return mRateHz; }
+
+  /**
+   * Returns true if setRate(rateHz) would write a new rate to the device.
+   */
+  bool needsUpdate(float rateHz) const;
+
+  static float selectRate(const std::vector<float>& available, float rateHz);
+
+private:
+  bool mIsSupported;
+  SysfsAttribute mFrequency;
+  std::vector<float> mAvailable;
+  float mRateHz;
+  // Last rate the device rejected, only logged on its first failure
+  float mFailedRateHz;
+};
+
+}  // namespace hwctl
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace rb
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+namespace rb {
+namespace hardware {
+namespace sensors {
+namespace hwctl {
+
+/**
+ * Parses the three decimal integers of an in_<type>_x&y&z_raw attribute in
+ * place, without allocation and independent of the locale. The values may be
+ * separated by blanks, tabs, commas or newlines. Returns false if fewer than
+ * three values are found, a value is not a plain integer or does not fit into
+ * 32 bits.
+ */
+inline bool parseRawTriplet(const char* data, int32_t values[3]) {
+  const char* p = data;
+
+  for (int i = 0; i < 3; i++) {
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == ',') {
+      p++;
+    }
+
+    bool negative = (*p == '-');
+    p += (negative || *p == '+');
+
+    uint32_t digit = static_cast<uint32_t>(*p - '0');
+    if (digit > 9) {
+      return false;
+    }
+
+    int64_t value = 0;
+    do {
+      value = value * 10 + digit;
+      if (value > 2147483648LL) {
+        return false;
+      }
+      digit = static_cast<uint32_t>(*++p - '0');
+    } while (digit <= 9);
+
+    if (*p != '\0' && *p != ' ' && *p != '\t' && *p != '\n' && *p != ',') {
+      return false;
+    }
+
+    value = negative ? -value : value;
+    if (value > INT32_MAX) {
+      return false;
+    }
+    values[i] = static_cast<int32_t>(value);
+  }
+
+  return true;
+}
+
+/**
+ * Parses a raw triplet and converts it to the output unit of the sensor in the
+ * same step.
+ */
+inline bool parseScaledTriplet(const char* data, float scale, float values[3]) {
+  int32_t raw[3];
+  if (!parseRawTriplet(data, raw)) {
+    return false;
+  }
+  values[0] = raw[0] * scale;
+  values[1] = raw[1] * scale;
+  values[2] = raw[2] * scale;
+  return true;
+}
+
+}  // namespace hwctl
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace rb
@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sensorScheduler.h"
+
+#include <errno.h>
+#include <log/log.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+namespace rb {
+namespace hardware {
+namespace sensors {
+namespace hwctl {
+
+constexpr int64_t kNanosecondsInSeconds = 1000 * 1000 * 1000;
+
+SensorScheduler::SensorScheduler() : mNextGeneration(0), mRunningJob(nullptr), mStopThread(false) {
+  mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+  mTimerFd = timerfd_create(CLOCK_BOOTTIME, TFD_CLOEXEC | TFD_NONBLOCK);
+  mEventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (mEpollFd < 0 || mTimerFd < 0 || mEventFd < 0) {
+    ALOGE("SensorScheduler failed to create file descriptors: %d", errno);
+  } else {
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = mTimerFd;
+    epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mTimerFd, &event);
+    event.data.fd = mEventFd;
+    epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mEventFd, &event);
+  }
+  mRunThread = std::thread(startThread, this);
+}
+
+SensorScheduler::~SensorScheduler() {
+  {
+    std::lock_guard<std::mutex> lock(mLock);
+    mStopThread = true;
+    interrupt();
+  }
+  mRunThread.join();
+
+  for (int fd : {mEpollFd, mTimerFd, mEventFd}) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+}
+
+SensorScheduler& SensorScheduler::get() {
+  static SensorScheduler sScheduler;
+  return sScheduler;
+}
+
+void SensorScheduler::schedule(IScheduledJob* job, int64_t periodNs) {
+  std::lock_guard<std::mutex> lock(mLock);
+  auto it = mJobs.find(job);
+  if (it == mJobs.end()) {
+    Job& entry = mJobs[job];
+    entry.timer.start(periodNs);
+    push(job, entry);
+  } else if (it->second.timer.getPeriod() <= 0) {
+    it->second.timer.start(periodNs);
+    push(job, it->second);
+  } else if (it->second.timer.getPeriod() != periodNs) {
+    it->second.timer.setPeriod(periodNs);
+    push(job, it->second);
+  } else {
+    return;
+  }
+  interrupt();
+}
+
+void SensorScheduler::remove(IScheduledJob* job) {
+  std::unique_lock<std::mutex> lock(mLock);
+  mJobs.erase(job);
+  // Stale heap entries are dropped by the scheduler thread. A job may remove
+  // itself from its own callback, so only wait on other threads.
+  if (std::this_thread::get_id() != mRunThread.get_id()) {
+    mIdleCV.wait(lock, [&] { return mRunningJob != job; });
+  }
+}
+
+PeriodicTimerStats SensorScheduler::getStats(IScheduledJob* job) {
+  std::lock_guard<std::mutex> lock(mLock);
+  auto it = mJobs.find(job);
+  if (it == mJobs.end()) {
+    return PeriodicTimerStats{};
+  }
+  return it->second.timer.getStats();
+}
+
+void SensorScheduler::push(IScheduledJob* job, Job& entry) {
+  entry.generation = mNextGeneration++;
+  if (entry.timer.getPeriod() > 0) {
+    mDeadlines.push({entry.timer.getNextDeadline(), job, entry.generation});
+  }
+}
+
+bool SensorScheduler::isStale(const Deadline& deadline) const {
+  auto it = mJobs.find(deadline.job);
+  return it == mJobs.end() || it->second.generation != deadline.generation;
+}
+
+void SensorScheduler::startThread(SensorScheduler* scheduler) { scheduler->run(); }
+
+void SensorScheduler::run() {
+  std::unique_lock<std::mutex> runLock(mLock);
+
+  while (!mStopThread) {
+    while (!mDeadlines.empty() && isStale(mDeadlines.top())) {
+      mDeadlines.pop();
+    }
+
+    int64_t now = PeriodicTimer::now();
+    if (mDeadlines.empty() || mDeadlines.top().deadlineNs > now) {
+      int64_t deadlineNs = mDeadlines.empty() ? 0 : mDeadlines.top().deadlineNs;
+      runLock.unlock();
+      wait(deadlineNs);
+      runLock.lock();
+      continue;
+    }
+
+    Deadline deadline = mDeadlines.top();
+    mDeadlines.pop();
+    Job& entry = mJobs[deadline.job];
+    entry.timer.advance(now);
+    mDeadlines.push({entry.timer.getNextDeadline(), deadline.job, deadline.generation});
+
+    mRunningJob = deadline.job;
+    runLock.unlock();
+    deadline.job->onDeadline(deadline.deadlineNs, now);
+    runLock.lock();
+    mRunningJob = nullptr;
+    mIdleCV.notify_all();
+  }
+}
+
+void SensorScheduler::wait(int64_t deadlineNs) {
+  // A zero deadline disarms the timer, so only a reconfiguration wakes us up
+  itimerspec spec = {};
+  spec.it_value.tv_sec = deadlineNs / kNanosecondsInSeconds;
+  spec.it_value.tv_nsec = deadlineNs % kNanosecondsInSeconds;
+  if (timerfd_settime(mTimerFd, TFD_TIMER_ABSTIME, &spec, nullptr) < 0) {
+    ALOGE("SensorScheduler failed to arm timer: %d", errno);
+  }
+
+  epoll_event events[2];
+  int count = epoll_wait(mEpollFd, events, 2, -1);
+  for (int i = 0; i < count; i++) {
+    uint64_t value;
+    read(events[i].data.fd, &value, sizeof(value));
+  }
+}
+
+void SensorScheduler::interrupt() {
+  uint64_t value = 1;
+  write(mEventFd, &value, sizeof(value));
+}
+
+}  // namespace hwctl
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace rb
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "periodicTimer.h"
+
+namespace rb {
+namespace hardware {
+namespace sensors {
+namespace hwctl {
+
+class IScheduledJob {
+public:
+  virtual ~IScheduledJob(){};
+  /**
+   * Called on the scheduler thread for every served deadline. nowNs is the
+   * time at which the deadline is served.
+   */
+  virtual void onDeadline(int64_t deadlineNs, int64_t nowNs) = 0;
+};
+
+/**
+ * Single event loop that runs all periodic sampling jobs of the HAL.
+ *
+ * Every job keeps its own PeriodicTimer grid. The pending deadlines are kept
+ * in a min-heap, and the scheduler thread sleeps in epoll on one timerfd armed
+ * with the earliest deadline and one eventfd used to signal reconfiguration.
+ * Adding sensors therefore does not add threads, and a disabled sensor costs
+ * no wakeups.
+ *
+ * Jobs run one after the other on the scheduler thread and must not block.
+ */
+class SensorScheduler {
+public:
+  SensorScheduler();
+  ~SensorScheduler();
+
+  SensorScheduler(const SensorScheduler&) = delete;
+  SensorScheduler& operator=(const SensorScheduler&) = delete;
+
+  /**
+   * Returns the scheduler shared by all sensors of the process.
+   */
+  static SensorScheduler& get();
+
+  /**
+   * Schedules the job with the first deadline at the current time, or changes
+   * its period if it is already scheduled. A period of 0 pauses the job.
+   */
+  void schedule(IScheduledJob* job, int64_t periodNs);
+
+  /**
+   * Removes the job. Once this returns, onDeadline() is not running and is not
+   * called on the job anymore, so the caller must not hold a lock that is
+   * taken by onDeadline().
+   */
+  void remove(IScheduledJob* job);
+
+  PeriodicTimerStats getStats(IScheduledJob* job);
+
+private:
+  struct Job {
+    PeriodicTimer timer;
+    // Changes on every reschedule; heap entries of older generations are stale
+    uint64_t generation;
+  };
+
+  struct Deadline {
+    int64_t deadlineNs;
+    IScheduledJob* job;
+    uint64_t generation;
+
+    bool operator>(const Deadline& other) const { return deadlineNs > other.deadlineNs; }
+  };
+
+  static void startThread(SensorScheduler* scheduler);
+  void run();
+  void push(IScheduledJob* job, Job& entry);
+  bool isStale(const Deadline& deadline) const;
+  void wait(int64_t deadlineNs);
+  void interrupt();
+
+  int mEpollFd;
+  int mTimerFd;
+  int mEventFd;
+
+  std::map<IScheduledJob*, Job> mJobs;
+  std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>> mDeadlines;
+  uint64_t mNextGeneration;
+  IScheduledJob* mRunningJob;
+
+  bool mStopThread;
+  std::condition_variable mIdleCV;
+  std::mutex mLock;
+  std::thread mRunThread;
+};
+
+}  // namespace hwctl
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace rb
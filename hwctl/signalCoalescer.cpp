@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "signalCoalescer.h"
+
+#include <cutils/properties.h>
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+#include "periodicTimer.h"
+
+namespace rb {
+namespace hardware {
+namespace sensors {
+namespace hwctl {
+
+constexpr int64_t kNanosecondsInSeconds = 1000 * 1000 * 1000;
+
+int64_t SignalCoalescer::getConfiguredWindowNs() {
+  int64_t windowUs = property_get_int64(kWindowProperty, -1);
+  return windowUs >= 0 ? windowUs * 1000 : kDefaultWindowNs;
+}
+
+size_t SignalCoalescer::getConfiguredMaxPending() {
+  int64_t maxPending = property_get_int64(kMaxPendingProperty, -1);
+  return maxPending >= 0 ? static_cast<size_t>(maxPending) : kDefaultMaxPending;
+}
+
+SignalCoalescer::SignalCoalescer(std::function<void()> signal, int64_t windowNs, size_t maxPending)
+  : mSignal(std::move(signal)),
+    mWindowNs(std::max<int64_t>(windowNs, 0)),
+    mMaxPending(maxPending > 0 ? maxPending : std::numeric_limits<size_t>::max()),
+    mCreateTimeNs(PeriodicTimer::now()),
+    mPending(0),
+    mFirstPendingNs(0),
+    mStopThread(false),
+    mEvents(0),
+    mSignals(0),
+    mTotalDelayNs(0),
+    mMaxDelayNs(0) {
+  // Without a window every write is signalled by the writer itself
+  if (mWindowNs > 0) {
+    mThread = std::thread(startThread, this);
+  }
+}
+
+SignalCoalescer::~SignalCoalescer() {
+  {
+    std::lock_guard<std::mutex> lock(mLock);
+    mStopThread = true;
+    mPendingCV.notify_one();
+  }
+  if (mThread.joinable()) {
+    mThread.join();
+  }
+}
+
+bool SignalCoalescer::onWrite(size_t count, bool urgent) {
+  std::lock_guard<std::mutex> lock(mLock);
+  int64_t nowNs = PeriodicTimer::now();
+  mEvents += count;
+  if (mPending == 0) {
+    mFirstPendingNs = nowNs;
+  }
+  mPending += count;
+
+  if (urgent || mPending >= mMaxPending || nowNs - mFirstPendingNs >= mWindowNs) {
+    signalLocked(nowNs);
+    return true;
+  }
+  if (mPending == count) {
+    // First event of a batch, arm the end of the window
+    mPendingCV.notify_one();
+  }
+  return false;
+}
+
+void SignalCoalescer::clear() {
+  std::lock_guard<std::mutex> lock(mLock);
+  mPending = 0;
+}
+
+SignalCoalescerStats SignalCoalescer::getStats() {
+  std::lock_guard<std::mutex> lock(mLock);
+  SignalCoalescerStats stats;
+  int64_t elapsedNs = PeriodicTimer::now() - mCreateTimeNs;
+
+  stats.events = mEvents;
+  stats.signals = mSignals;
+  stats.signalRateHz = elapsedNs > 0 ? static_cast<float>(mSignals) * kNanosecondsInSeconds / elapsedNs : 0.0f;
+  stats.meanDelayNs = mSignals > 0 ? mTotalDelayNs / static_cast<int64_t>(mSignals) : 0;
+  stats.maxDelayNs = mMaxDelayNs;
+  return stats;
+}
+
+void SignalCoalescer::startThread(SignalCoalescer* coalescer) { coalescer->run(); }
+
+void SignalCoalescer::run() {
+  std::unique_lock<std::mutex> lock(mLock);
+  while (!mStopThread) {
+    if (mPending == 0) {
+      mPendingCV.wait(lock);
+      continue;
+    }
+
+    int64_t nowNs = PeriodicTimer::now();
+    int64_t deadlineNs = mFirstPendingNs + mWindowNs;
+    if (nowNs < deadlineNs) {
+      mPendingCV.wait_for(lock, std::chrono::nanoseconds(deadlineNs - nowNs));
+      continue;
+    }
+
+    signalLocked(nowNs);
+    lock.unlock();
+    mSignal();
+    lock.lock();
+  }
+}
+
+void SignalCoalescer::signalLocked(int64_t nowNs) {
+  int64_t delayNs = nowNs - mFirstPendingNs;
+  mSignals++;
+  mTotalDelayNs += delayNs;
+  mMaxDelayNs = std::max(mMaxDelayNs, delayNs);
+  mPending = 0;
+}
+
+}  // namespace hwctl
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace rb
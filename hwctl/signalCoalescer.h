@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace rb {
+namespace hardware {
+namespace sensors {
+namespace hwctl {
+
+struct SignalCoalescerStats {
+  uint64_t events;
+  // Signals sent to the reader, each waking it up once
+  uint64_t signals;
+  float signalRateHz;
+  // Time the signal of an event was held back, for the first event of a batch
+  int64_t meanDelayNs;
+  int64_t maxDelayNs;
+};
+
+/**
+ * Coalesces the signals that tell the framework to read the Event FMQ.
+ *
+ * The events are written to the queue as they are produced, only the signal
+ * is held back. The events of all sensors written within a window after the
+ * first unsignalled one share a single signal, which is sent by the writer
+ * that finds the window expired or the count threshold reached, or else by a
+ * background thread at the end of the window. Urgent events, i.e. events of
+ * wake-up sensors and flush completions, are signalled immediately together
+ * with everything pending. A window of 0 signals every write, a threshold of 0
+ * leaves only the window.
+ *
+ * The defaults can be overridden with the system properties
+ * vendor.sensors.coalescing.window_us and vendor.sensors.coalescing.max_pending.
+ *
+ * Thread safe.
+ */
+class SignalCoalescer {
+public:
+  static constexpr int64_t kDefaultWindowNs = 1000 * 1000;
+  static constexpr size_t kDefaultMaxPending = 32;
+  static constexpr const char* kWindowProperty = "vendor.sensors.coalescing.window_us";
+  static constexpr const char* kMaxPendingProperty = "vendor.sensors.coalescing.max_pending";
+
+  /**
+   * Returns the window and the threshold configured by the system properties,
+   * or the defaults if unset or invalid.
+   */
+  static int64_t getConfiguredWindowNs();
+  static size_t getConfiguredMaxPending();
+
+  /**
+   * signal is called from the background thread, without any lock of the
+   * coalescer held.
+   */
+  explicit SignalCoalescer(std::function<void()> signal, int64_t windowNs = getConfiguredWindowNs(),
+                           size_t maxPending = getConfiguredMaxPending());
+  ~SignalCoalescer();
+
+  SignalCoalescer(const SignalCoalescer&) = delete;
+  SignalCoalescer& operator=(const SignalCoalescer&) = delete;
+
+  /**
+   * Accounts count events written to the queue. Returns true if the caller
+   * must signal the reader now, otherwise the signal is deferred.
+   */
+  bool onWrite(size_t count, bool urgent);
+
+  /**
+   * Forgets the pending events, e.g. when the queue is replaced.
+   */
+  void clear();
+
+  SignalCoalescerStats getStats();
+
+private:
+  static void startThread(SignalCoalescer* coalescer);
+  void run();
+  void signalLocked(int64_t nowNs);
+
+  const std::function<void()> mSignal;
+  const int64_t mWindowNs;
+  const size_t mMaxPending;
+  const int64_t mCreateTimeNs;
+
+  std::mutex mLock;
+  std::condition_variable mPendingCV;
+  size_t mPending;
+  int64_t mFirstPendingNs;
+  bool mStopThread;
+
+  uint64_t mEvents;
+  uint64_t mSignals;
+  int64_t mTotalDelayNs;
+  int64_t mMaxDelayNs;
+
+  std::thread mThread;
+};
+
+}  // namespace hwctl
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace rb
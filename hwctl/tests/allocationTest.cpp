@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <string>
+
+#include "directChannel.h"
+#include "eventFifo.h"
+#include "iioBuffer.h"
+#include "iioHwctl.h"
+#include "pendingEvents.h"
+#include "rawTriplet.h"
+
+namespace {
+
+std::atomic<uint64_t> gAllocations(0);
+
+}  // namespace
+
+// Counts every allocation of the test binary
+void* operator new(size_t size) {
+  gAllocations++;
+  void* ptr = malloc(size > 0 ? size : 1);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept { free(ptr); }
+
+void operator delete(void* ptr, size_t /* size */) noexcept { free(ptr); }
+
+namespace rb {
+namespace hardware {
+namespace sensors {
+namespace hwctl {
+namespace {
+
+constexpr size_t kSamples = 1000;
+constexpr size_t kFifoCapacity = 16;
+constexpr int64_t kSamplingPeriodNs = 2500 * 1000;
+constexpr int64_t kMaxReportLatencyNs = 10 * kSamplingPeriodNs;
+
+/**
+ * Event of the steady state path, the size of a sensors event.
+ */
+struct TestEvent {
+  int32_t sensorHandle;
+  int64_t timestamp;
+  float values[16];
+};
+
+/**
+ * Checks that the per-sample path, once set up, does not allocate: sysfs
+ * reads, parsing, buffered IIO reads, software batching, pending events and
+ * direct reports.
+ */
+class AllocationTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    char dir[] = "/tmp/allocationTest.XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    mRoot = dir;
+  }
+
+  void TearDown() override { std::filesystem::remove_all(mRoot); }
+
+  void writeFile(const std::string& name, const std::string& data) {
+    std::filesystem::create_directories(std::filesystem::path(mRoot + "/" + name).parent_path());
+    std::ofstream file(mRoot + "/" + name, std::ios::binary | std::ios::trunc);
+    file << data;
+  }
+
+  std::string mRoot;
+};
+
+TEST_F(AllocationTest, CountsAllocations) {
+  writeFile("in_accel_raw", "2000 -1000 0\n");
+  std::string path = mRoot + "/in_accel_raw";
+  std::string data;
+  uint64_t allocations = gAllocations;
+  ASSERT_EQ(readFromFile(&path, data), 0);
+  EXPECT_GT(gAllocations - allocations, 0u);
+}
+
+TEST_F(AllocationTest, PolledSampleDoesNotAllocate) {
+  writeFile("in_accel_raw", "2000 -1000 0\n");
+  SysfsAttribute attribute(mRoot + "/in_accel_raw");
+  EventFifo<TestEvent> fifo;
+  fifo.setCapacity(kFifoCapacity);
+  fifo.setMaxReportLatency(kMaxReportLatencyNs);
+  PendingEvents<TestEvent> pending(kFifoCapacity);
+  TestEvent delivered[kFifoCapacity];
+  auto isDroppable = [](const TestEvent&) { return true; };
+
+  auto sample = [&](int64_t timestampNs) {
+    char buf[64];
+    TestEvent event = {};
+    event.sensorHandle = 1;
+    event.timestamp = timestampNs;
+    ASSERT_GT(attribute.read(buf, sizeof(buf)), 0);
+    ASSERT_TRUE(parseScaledTriplet(buf, 1.0f / 2000.0f, event.values));
+    if (fifo.push(event, timestampNs)) {
+      size_t count = fifo.size();
+      fifo.drain(delivered);
+      pending.push(delivered, count, false, isDroppable);
+      while (!pending.empty()) {
+        pending.front(&count);
+        pending.pop(count);
+      }
+    }
+  };
+
+  // The first read opens the attribute
+  sample(0);
+  uint64_t allocations = gAllocations;
+  for (size_t i = 1; i <= kSamples; i++) {
+    sample(static_cast<int64_t>(i) * kSamplingPeriodNs);
+  }
+  EXPECT_EQ(gAllocations - allocations, 0u);
+  EXPECT_FLOAT_EQ(delivered[0].values[0], 1.0f);
+  EXPECT_EQ(fifo.getDropped(), 0u);
+}
+
+TEST_F(AllocationTest, BufferedScanDoesNotAllocate) {
+  writeFile("buffer/enable", "0");
+  writeFile("buffer/length", "0");
+  writeFile("scan_elements/in_accel_en", "0");
+  writeFile("scan_elements/in_accel_index", "0");
+  writeFile("scan_elements/in_accel_type", "le:s16/16X3>>0");
+  writeFile("dev", "");
+
+  int fd = memfd_create("allocationTest", MFD_CLOEXEC);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(ftruncate(fd, 4 * sizeof(DirectReportEvent)), 0);
+  auto channel = std::make_shared<DirectChannel>(fd, 4 * sizeof(DirectReportEvent));
+  DirectReports reports;
+  reports.configure(channel, 1, 4 * kSamplingPeriodNs);
+
+  IioBuffer buffer(mRoot, mRoot + "/dev", {"in_accel"});
+  ASSERT_EQ(buffer.start(), 0);
+  int writer = open((mRoot + "/dev").c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+  ASSERT_GE(writer, 0);
+
+  const int16_t scans[] = {1, 2, 3, 4, 5, 6};
+  IioFrame frames[4];
+  int64_t timestampNs = 0;
+  auto readScans = [&]() {
+    ASSERT_EQ(::write(writer, scans, sizeof(scans)), static_cast<ssize_t>(sizeof(scans)));
+    ssize_t count = buffer.readAvailable(frames, 4);
+    ASSERT_EQ(count, 2);
+    for (ssize_t i = 0; i < count; i++) {
+      DirectReportEvent event = {};
+      event.timestamp = timestampNs += kSamplingPeriodNs;
+      event.u.vector.x = static_cast<float>(frames[i].values[0]);
+      reports.write(event);
+    }
+    ASSERT_EQ(buffer.readAvailable(frames, 4), -EAGAIN);
+  };
+
+  readScans();
+  uint64_t allocations = gAllocations;
+  for (size_t i = 0; i < kSamples; i++) {
+    readScans();
+  }
+  EXPECT_EQ(gAllocations - allocations, 0u);
+  EXPECT_EQ(frames[1].values[2], 6);
+
+  close(writer);
+  buffer.stop();
+}
+
+}  // namespace
+}  // namespace hwctl
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace rb
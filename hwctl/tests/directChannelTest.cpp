@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <memory>
+
+#include "directChannel.h"
+
+namespace rb {
+namespace hardware {
+namespace sensors {
+namespace hwctl {
+namespace {
+
+constexpr size_t kRecordCount = 3;
+constexpr size_t kMemorySize = kRecordCount * sizeof(DirectReportEvent);
+
+TEST(DirectChannelTest, LayoutMatchesSensorsEvent) {
+  EXPECT_EQ(sizeof(DirectReportEvent), 104u);
+  EXPECT_EQ(offsetof(DirectReportEvent, version), 0u);
+  EXPECT_EQ(offsetof(DirectReportEvent, sensor), 4u);
+  EXPECT_EQ(offsetof(DirectReportEvent, type), 8u);
+  EXPECT_EQ(offsetof(DirectReportEvent, reserved0), 12u);
+  EXPECT_EQ(offsetof(DirectReportEvent, timestamp), 16u);
+  EXPECT_EQ(offsetof(DirectReportEvent, u), 24u);
+  EXPECT_EQ(offsetof(DirectReportEvent, flags), 88u);
+}
+
+TEST(DirectChannelTest, RateLevels) {
+  EXPECT_EQ(getDirectReportPeriodNs(kDirectRateStop), 0);
+  EXPECT_EQ(getDirectReportPeriodNs(kDirectRateNormal), 20 * 1000 * 1000);
+  EXPECT_EQ(getMaxDirectRateLevel(2500 * 1000), kDirectRateFast);
+  EXPECT_EQ(getMaxDirectRateLevel(1000 * 1000), kDirectRateVeryFast);
+  EXPECT_EQ(getMaxDirectRateLevel(100 * 1000 * 1000), kDirectRateStop);
+}
+
+/**
+ * A channel over a memfd, with a second mapping standing in for the reader.
+ */
+class DirectChannelMemoryTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    int fd = memfd_create("directChannelTest", MFD_CLOEXEC);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(ftruncate(fd, kMemorySize), 0);
+    void* addr = mmap(nullptr, kMemorySize, PROT_READ, MAP_SHARED, fd, 0);
+    ASSERT_NE(addr, MAP_FAILED);
+    mReader = static_cast<const DirectReportEvent*>(addr);
+    mChannel = std::make_unique<DirectChannel>(fd, kMemorySize);
+    ASSERT_TRUE(mChannel->isValid());
+  }
+
+  void TearDown() override {
+    mChannel.reset();
+    if (mReader != nullptr) {
+      munmap(const_cast<DirectReportEvent*>(mReader), kMemorySize);
+    }
+  }
+
+  void write(int32_t sensor, int64_t timestamp) {
+    DirectReportEvent event = {};
+    event.sensor = sensor;
+    event.type = 1;
+    event.timestamp = timestamp;
+    event.u.vector.x = 1.0f;
+    event.reserved0 = 12345;
+    mChannel->write(event);
+  }
+
+  std::unique_ptr<DirectChannel> mChannel;
+  const DirectReportEvent* mReader = nullptr;
+};
+
+TEST_F(DirectChannelMemoryTest, WritesRecordsWithCounter) {
+  EXPECT_EQ(mReader[0].reserved0, 0);
+
+  write(7, 1000);
+  EXPECT_EQ(mReader[0].version, static_cast<int32_t>(sizeof(DirectReportEvent)));
+  EXPECT_EQ(mReader[0].sensor, 7);
+  EXPECT_EQ(mReader[0].type, 1);
+  EXPECT_EQ(mReader[0].reserved0, 1);
+  EXPECT_EQ(mReader[0].timestamp, 1000);
+  EXPECT_FLOAT_EQ(mReader[0].u.vector.x, 1.0f);
+  EXPECT_EQ(mReader[1].reserved0, 0);
+
+  write(7, 2000);
+  EXPECT_EQ(mReader[1].reserved0, 2);
+  EXPECT_EQ(mReader[1].timestamp, 2000);
+}
+
+TEST_F(DirectChannelMemoryTest, WrapsAroundTheRing) {
+  for (int64_t i = 1; i <= static_cast<int64_t>(kRecordCount) + 1; i++) {
+    write(7, i * 1000);
+  }
+  EXPECT_EQ(mReader[0].reserved0, static_cast<int32_t>(kRecordCount) + 1);
+  EXPECT_EQ(mReader[0].timestamp, static_cast<int64_t>(kRecordCount + 1) * 1000);
+  EXPECT_EQ(mReader[1].reserved0, 2);
+}
+
+TEST_F(DirectChannelMemoryTest, ReportsFollowChannelPeriod) {
+  std::shared_ptr<DirectChannel> channel(std::move(mChannel));
+  DirectReports reports;
+  reports.configure(channel, 42, getDirectReportPeriodNs(kDirectRateNormal));
+  EXPECT_EQ(reports.getPeriod(), getDirectReportPeriodNs(kDirectRateNormal));
+
+  // Sampled at 200 Hz, reported at 50 Hz within the tolerance of a quarter period
+  DirectReportEvent event = {};
+  for (int64_t i = 1; i <= 10; i++) {
+    event.timestamp = i * 5 * 1000 * 1000;
+    reports.write(event);
+  }
+  EXPECT_EQ(mReader[0].sensor, 42);
+  EXPECT_EQ(mReader[0].timestamp, 15 * 1000 * 1000);
+  EXPECT_EQ(mReader[1].timestamp, 35 * 1000 * 1000);
+  EXPECT_EQ(mReader[2].reserved0, 0);
+
+  reports.configure(channel, 42, 0);
+  EXPECT_EQ(reports.getPeriod(), 0);
+}
+
+}  // namespace
+}  // namespace hwctl
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace rb
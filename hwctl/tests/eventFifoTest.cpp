@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "eventFifo.h"
+
+namespace rb {
+namespace hardware {
+namespace sensors {
+namespace hwctl {
+namespace {
+
+constexpr int64_t kMaxReportLatencyNs = 100;
+
+TEST(EventFifoTest, DueAfterMaxReportLatency) {
+  EventFifo<int64_t> fifo;
+  fifo.setCapacity(8);
+  fifo.setMaxReportLatency(kMaxReportLatencyNs);
+  ASSERT_TRUE(fifo.isBatching());
+
+  EXPECT_FALSE(fifo.push(0, 0));
+  EXPECT_FALSE(fifo.push(50, 50));
+  EXPECT_TRUE(fifo.push(100, 100));
+
+  std::vector<int64_t> events;
+  fifo.drain(events);
+  EXPECT_EQ(events, (std::vector<int64_t>{0, 50, 100}));
+  EXPECT_EQ(fifo.size(), 0u);
+
+  // The latency restarts with the first event after a drain
+  EXPECT_FALSE(fifo.push(150, 150));
+  EXPECT_FALSE(fifo.push(240, 240));
+  EXPECT_TRUE(fifo.push(250, 250));
+}
+
+TEST(EventFifoTest, DueWhenFull) {
+  EventFifo<int64_t> fifo;
+  fifo.setCapacity(3);
+  fifo.setMaxReportLatency(kMaxReportLatencyNs);
+
+  EXPECT_FALSE(fifo.push(0, 0));
+  EXPECT_FALSE(fifo.push(1, 1));
+  EXPECT_TRUE(fifo.push(2, 2));
+}
+
+TEST(EventFifoTest, OverflowDropsOldestAndKeepsOrder) {
+  EventFifo<int64_t> fifo;
+  fifo.setCapacity(3);
+  fifo.setMaxReportLatency(kMaxReportLatencyNs);
+
+  for (int64_t timestamp = 0; timestamp < 5; timestamp++) {
+    fifo.push(timestamp, timestamp);
+  }
+  EXPECT_EQ(fifo.size(), 3u);
+  EXPECT_EQ(fifo.getDropped(), 2u);
+
+  int64_t events[3];
+  fifo.drain(events);
+  EXPECT_EQ(events[0], 2);
+  EXPECT_EQ(events[1], 3);
+  EXPECT_EQ(events[2], 4);
+}
+
+TEST(EventFifoTest, ClearCountsDropped) {
+  EventFifo<int64_t> fifo;
+  fifo.setCapacity(4);
+  fifo.setMaxReportLatency(kMaxReportLatencyNs);
+  fifo.push(0, 0);
+  fifo.push(1, 1);
+  fifo.clear();
+  EXPECT_EQ(fifo.size(), 0u);
+  EXPECT_EQ(fifo.getDropped(), 2u);
+}
+
+}  // namespace
+}  // namespace hwctl
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace rb
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <gtest/gtest.h>
+#include <stdlib.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "iioBuffer.h"
+
+namespace rb {
+namespace hardware {
+namespace sensors {
+namespace hwctl {
+namespace {
+
+TEST(IioBufferTest, ParseTypeWithRepeat) {
+  IioChannel channel;
+  ASSERT_EQ(IioBuffer::parseType("le:s12/16X2>>4", channel), 0);
+  EXPECT_FALSE(channel.isBigEndian);
+  EXPECT_TRUE(channel.isSigned);
+  EXPECT_EQ(channel.realBits, 12u);
+  EXPECT_EQ(channel.storageBits, 16u);
+  EXPECT_EQ(channel.repeat, 2u);
+  EXPECT_EQ(channel.shift, 4u);
+}
+
+TEST(IioBufferTest, ParseTypeWithoutRepeat) {
+  IioChannel channel;
+  ASSERT_EQ(IioBuffer::parseType("be:u24/32>>0", channel), 0);
+  EXPECT_TRUE(channel.isBigEndian);
+  EXPECT_FALSE(channel.isSigned);
+  EXPECT_EQ(channel.realBits, 24u);
+  EXPECT_EQ(channel.storageBits, 32u);
+  EXPECT_EQ(channel.repeat, 1u);
+  EXPECT_EQ(channel.shift, 0u);
+}
+
+TEST(IioBufferTest, ParseTypeRejectsInvalid) {
+  IioChannel channel;
+  EXPECT_LT(IioBuffer::parseType("", channel), 0);
+  EXPECT_LT(IioBuffer::parseType("xe:s16/16>>0", channel), 0);
+  EXPECT_LT(IioBuffer::parseType("le:s16/12>>0", channel), 0);
+  EXPECT_LT(IioBuffer::parseType("le:s12/16>>8", channel), 0);
+  EXPECT_LT(IioBuffer::parseType("le:s16/16X0>>0", channel), 0);
+  EXPECT_LT(IioBuffer::parseType("le:s16/16X9>>0", channel), 0);
+}
+
+TEST(IioBufferTest, DecodeRepeatedElements) {
+  IioChannel channel;
+  ASSERT_EQ(IioBuffer::parseType("le:s12/16X2>>4", channel), 0);
+  channel.offset = 2;
+
+  // -3 and 100 as 12 bit values shifted by 4, after two bytes of another channel
+  const uint8_t scan[] = {0xAA, 0xAA, 0xD0, 0xFF, 0x40, 0x06};
+  EXPECT_EQ(IioBuffer::decode(scan, channel, 0), -3);
+  EXPECT_EQ(IioBuffer::decode(scan, channel, 1), 100);
+}
+
+TEST(IioBufferTest, DecodeBigEndianUnsigned) {
+  IioChannel channel;
+  ASSERT_EQ(IioBuffer::parseType("be:u16/16>>0", channel), 0);
+
+  const uint8_t scan[] = {0xFF, 0xFE};
+  EXPECT_EQ(IioBuffer::decode(scan, channel), 0xFFFE);
+}
+
+/**
+ * Synthetic sysfs directory of a device with one repeated channel, and a regular file standing in
+ * for its character device.
+ */
+class IioBufferDeviceTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    char dir[] = "/tmp/iioBufferTest.XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    mRoot = dir;
+    std::filesystem::create_directories(mRoot + "/scan_elements");
+    std::filesystem::create_directories(mRoot + "/buffer");
+    writeFile("buffer/enable", "0");
+    writeFile("buffer/length", "0");
+    writeFile("scan_elements/in_accel_en", "0");
+    writeFile("scan_elements/in_accel_index", "0");
+    writeFile("scan_elements/in_accel_type", "le:s12/16X2>>4");
+  }
+
+  void TearDown() override { std::filesystem::remove_all(mRoot); }
+
+  void writeFile(const std::string& name, const std::string& data) {
+    std::ofstream file(mRoot + "/" + name, std::ios::binary | std::ios::trunc);
+    file << data;
+  }
+
+  std::string readFile(const std::string& name) {
+    std::ifstream file(mRoot + "/" + name);
+    std::string data;
+    std::getline(file, data);
+    return data;
+  }
+
+  std::string mRoot;
+};
+
+TEST_F(IioBufferDeviceTest, ReadFramesOfRepeatedChannel) {
+  const uint8_t scans[] = {0xD0, 0xFF, 0x40, 0x06, 0x10, 0x00, 0xF0, 0x7F};
+  writeFile("dev", std::string(reinterpret_cast<const char*>(scans), sizeof(scans)));
+
+  IioBuffer buffer(mRoot, mRoot + "/dev", {"in_accel"});
+  ASSERT_EQ(buffer.start(), 0);
+  EXPECT_EQ(readFile("scan_elements/in_accel_en"), "1");
+  EXPECT_EQ(readFile("buffer/enable"), "1");
+  EXPECT_FALSE(buffer.hasTimestamp());
+  EXPECT_EQ(buffer.getScanSize(), 4u);
+
+  IioFrame frames[4];
+  ASSERT_EQ(buffer.readFrames(frames, 4), 2);
+  EXPECT_EQ(frames[0].values[0], -3);
+  EXPECT_EQ(frames[0].values[1], 100);
+  EXPECT_EQ(frames[1].values[0], 1);
+  EXPECT_EQ(frames[1].values[1], 2047);
+
+  buffer.stop();
+  EXPECT_EQ(readFile("buffer/enable"), "0");
+}
+
+TEST_F(IioBufferDeviceTest, ReadAvailableDeliversEveryScanOnce) {
+  const uint8_t scans[] = {0xD0, 0xFF, 0x40, 0x06, 0x10, 0x00, 0xF0, 0x7F};
+  writeFile("dev", std::string(reinterpret_cast<const char*>(scans), sizeof(scans)));
+
+  IioBuffer buffer(mRoot, mRoot + "/dev", {"in_accel"});
+  ASSERT_EQ(buffer.start(), 0);
+
+  IioFrame frames[4];
+  ASSERT_EQ(buffer.readAvailable(frames, 4), 2);
+  EXPECT_EQ(frames[0].values[0], -3);
+  EXPECT_EQ(frames[1].values[0], 1);
+
+  // Nothing new, the previous scans must not be delivered again
+  EXPECT_EQ(buffer.readAvailable(frames, 4), -EAGAIN);
+
+  const uint8_t next[] = {0x20, 0x00, 0x30, 0x00};
+  std::ofstream(mRoot + "/dev", std::ios::binary | std::ios::app)
+    .write(reinterpret_cast<const char*>(next), sizeof(next));
+  ASSERT_EQ(buffer.readAvailable(frames, 4), 1);
+  EXPECT_EQ(frames[0].values[0], 2);
+  EXPECT_EQ(frames[0].values[1], 3);
+
+  buffer.stop();
+  EXPECT_LT(buffer.readAvailable(frames, 4), 0);
+}
+
+TEST_F(IioBufferDeviceTest, RejectsEmptyScan) {
+  writeFile("dev", "");
+
+  IioBuffer buffer(mRoot, mRoot + "/dev", {});
+  EXPECT_LT(buffer.start(), 0);
+  IioFrame frame;
+  EXPECT_LT(buffer.readFrames(&frame, 1), 0);
+  buffer.stop();
+}
+
+}  // namespace
+}  // namespace hwctl
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace rb
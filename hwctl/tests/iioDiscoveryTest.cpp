@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "iioDiscovery.h"
+#include "iioFiles.h"
+
+namespace rb {
+namespace hardware {
+namespace sensors {
+namespace hwctl {
+namespace {
+
+/**
+ * Synthetic /sys/bus/iio/devices tree.
+ */
+class IioDiscoveryTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    char dir[] = "/tmp/iioDiscoveryTest.XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    mRoot = dir;
+  }
+
+  void TearDown() override { std::filesystem::remove_all(mRoot); }
+
+  void writeFile(const std::string& name, const std::string& data) {
+    std::filesystem::create_directories(std::filesystem::path(mRoot + "/" + name).parent_path());
+    std::ofstream file(mRoot + "/" + name, std::ios::trunc);
+    file << data;
+  }
+
+  std::string mRoot;
+};
+
+TEST_F(IioDiscoveryTest, FindsDevicesInDeviceNumberOrder) {
+  writeFile("iio:device10/name", "smi240\n");
+  writeFile("iio:device2/name", "smi240\n");
+  writeFile("iio:device1/name", "other\n");
+  writeFile("iio:device3/in_accel_scale", "0.1\n");
+  writeFile("trigger0/name", "smi240\n");
+
+  std::vector<IioDevice> devices = IioDiscovery::scan(mRoot, "/dev");
+  ASSERT_EQ(devices.size(), 3u);
+  EXPECT_EQ(devices[0].name, "other");
+  EXPECT_EQ(devices[0].instance, 0u);
+  EXPECT_EQ(devices[1].name, "smi240");
+  EXPECT_EQ(devices[1].instance, 0u);
+  EXPECT_EQ(devices[1].sysfsDir, mRoot + "/iio:device2");
+  EXPECT_EQ(devices[1].devNode, "/dev/iio:device2");
+  EXPECT_EQ(devices[2].name, "smi240");
+  EXPECT_EQ(devices[2].instance, 1u);
+  EXPECT_EQ(devices[2].sysfsDir, mRoot + "/iio:device10");
+}
+
+TEST_F(IioDiscoveryTest, ReadsScales) {
+  writeFile("iio:device0/name", "smi240\n");
+  writeFile("iio:device0/in_accel_scale", "0.000250\n");
+  writeFile("iio:device0/in_anglvel_scale", "0\n");
+
+  std::vector<IioDevice> devices = IioDiscovery::scan(mRoot, "/dev");
+  ASSERT_EQ(devices.size(), 1u);
+  const IioDevice& device = devices[0];
+  EXPECT_FLOAT_EQ(device.getScale(SMI240ACC_SCALE, 1.0f), 0.00025f);
+  // A missing or zero scale falls back to the default
+  EXPECT_FLOAT_EQ(device.getScale(SMI240GYRO_SCALE, 2.0f), 2.0f);
+  EXPECT_FLOAT_EQ(device.getScale("in_temp_scale", 3.0f), 3.0f);
+}
+
+TEST(IioScaleTest, ConvertsToAndroidUnits) {
+  EXPECT_FLOAT_EQ(toAndroidScale(1.0f, IioScaleUnit::kStandardGravity), 9.80665f);
+  EXPECT_FLOAT_EQ(toAndroidScale(180.0f, IioScaleUnit::kDegreesPerSecond), static_cast<float>(M_PI));
+  EXPECT_FLOAT_EQ(toAndroidScale(0.5f, IioScaleUnit::kMetersPerSecondSquared), 0.5f);
+  EXPECT_FLOAT_EQ(toAndroidScale(0.5f, IioScaleUnit::kRadiansPerSecond), 0.5f);
+}
+
+TEST(IioScaleTest, Smi240DefaultRanges) {
+  float accelResolution = toAndroidScale(SMI240ACC_DEFAULT_SCALE, SMI240ACC_SCALE_UNIT);
+  EXPECT_FLOAT_EQ(accelResolution * SMI240ACC_FULL_SCALE_RAW, 16.0f * 9.80665f);
+
+  float gyroResolution = toAndroidScale(SMI240GYRO_DEFAULT_SCALE, SMI240GYRO_SCALE_UNIT);
+  EXPECT_FLOAT_EQ(gyroResolution * SMI240GYRO_FULL_SCALE_RAW, 300.0f * static_cast<float>(M_PI / 180.0));
+}
+
+}  // namespace
+}  // namespace hwctl
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace rb
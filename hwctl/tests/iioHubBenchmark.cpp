@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "iioHub.h"
+#include "periodicTimer.h"
+
+namespace rb {
+namespace hardware {
+namespace sensors {
+namespace hwctl {
+namespace {
+
+constexpr int64_t kStreamingPeriodNs = 2500 * 1000;
+constexpr int64_t kControlPeriodNs = 5 * 1000 * 1000;
+constexpr int64_t kCallIntervalNs = 100 * 1000;
+
+/**
+ * Synthetic sysfs directory of a device without IIO buffer, which the hub
+ * samples through its raw attribute.
+ */
+class SyntheticDevice {
+public:
+  SyntheticDevice() {
+    char dir[] = "/tmp/iioHubBenchmark.XXXXXX";
+    if (mkdtemp(dir) != nullptr) {
+      mDevice.name = "smi240";
+      mDevice.sysfsDir = dir;
+      mDevice.devNode = mDevice.sysfsDir + "/dev";
+      writeFile("in_accel_x&y&z_raw", "-1234 567 16384\n");
+      writeFile("sampling_frequency", "400\n");
+      writeFile("sampling_frequency_available", "100 200 400 800\n");
+    }
+  }
+
+  ~SyntheticDevice() {
+    if (!mDevice.sysfsDir.empty()) {
+      std::filesystem::remove_all(mDevice.sysfsDir);
+    }
+  }
+
+  const IioDevice& get() const { return mDevice; }
+
+private:
+  void writeFile(const std::string& name, const std::string& data) {
+    std::ofstream file(mDevice.getPath(name), std::ios::trunc);
+    file << data;
+  }
+
+  IioDevice mDevice;
+};
+
+/**
+ * Listener whose callback takes as long as posting the sample would.
+ */
+class StreamingListener : public ISampleCallback {
+public:
+  explicit StreamingListener(int64_t callbackNs) : mCallbackNs(callbackNs) {}
+
+  void onSample(const IioSample& /* sample */) override {
+    if (mCallbackNs > 0) {
+      std::this_thread::sleep_for(std::chrono::nanoseconds(mCallbackNs));
+    }
+  }
+
+private:
+  const int64_t mCallbackNs;
+};
+
+void setLatencyCounters(benchmark::State& state, std::vector<int64_t>& latencies) {
+  if (latencies.empty()) {
+    return;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  state.counters["p50_us"] = latencies[latencies.size() / 2] / 1000.0;
+  state.counters["p99_us"] = latencies[latencies.size() * 99 / 100] / 1000.0;
+  state.counters["max_us"] = latencies.back() / 1000.0;
+}
+
+/**
+ * Measures one control call per iteration while a 400 Hz listener is streaming
+ * with callbacks of state.range(0) microseconds.
+ */
+template <class ControlCall>
+void measureControlCall(benchmark::State& state, ControlCall call) {
+  SyntheticDevice device;
+  if (device.get().sysfsDir.empty()) {
+    state.SkipWithError("no temporary directory");
+    return;
+  }
+  IioHub hub(device.get(), {}, {"in_accel_x&y&z_raw"});
+  StreamingListener streaming(state.range(0) * 1000);
+  StreamingListener control(0);
+  hub.subscribe(&streaming, kStreamingPeriodNs);
+
+  std::vector<int64_t> latencies;
+  latencies.reserve(state.max_iterations);
+  bool toggle = false;
+  for (auto _ : state) {
+    int64_t startNs = PeriodicTimer::now();
+    call(hub, control, toggle);
+    int64_t latencyNs = PeriodicTimer::now() - startNs;
+    state.SetIterationTime(latencyNs / 1e9);
+    latencies.push_back(latencyNs);
+    toggle = !toggle;
+    std::this_thread::sleep_for(std::chrono::nanoseconds(kCallIntervalNs));
+  }
+
+  hub.unsubscribe(&control);
+  hub.unsubscribe(&streaming);
+  hub.waitForDispatch(&control);
+  hub.waitForDispatch(&streaming);
+  setLatencyCounters(state, latencies);
+}
+
+/**
+ * activate(): subscribing and unsubscribing a second sensor of the device.
+ */
+void BM_ActivateUnderLoad(benchmark::State& state) {
+  measureControlCall(state, [](IioHub& hub, ISampleCallback& listener, bool enable) {
+    if (enable) {
+      hub.subscribe(&listener, kControlPeriodNs);
+    } else {
+      hub.unsubscribe(&listener);
+    }
+  });
+}
+
+/**
+ * batch(): changing the sampling period of a second sensor of the device.
+ */
+void BM_BatchUnderLoad(benchmark::State& state) {
+  measureControlCall(state, [subscribed = false](IioHub& hub, ISampleCallback& listener, bool slow) mutable {
+    if (!subscribed) {
+      hub.subscribe(&listener, kControlPeriodNs);
+      subscribed = true;
+    }
+    hub.setSamplingPeriod(&listener, slow ? 2 * kControlPeriodNs : kControlPeriodNs);
+  });
+}
+
+BENCHMARK(BM_ActivateUnderLoad)->Arg(0)->Arg(2000)->Iterations(2000)->UseManualTime()->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_BatchUnderLoad)->Arg(0)->Arg(2000)->Iterations(2000)->UseManualTime()->Unit(benchmark::kMicrosecond);
+
+}  // namespace
+}  // namespace hwctl
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace rb
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "iioHwctl.h"
+
+namespace rb {
+namespace hardware {
+namespace sensors {
+namespace hwctl {
+namespace {
+
+/**
+ * Raw triplet attribute in a memfd, i.e. a tmpfs file, opened by path through
+ * /proc/self/fd.
+ */
+class TmpfsAttribute {
+public:
+  TmpfsAttribute() : mFd(memfd_create("iioHwctlBenchmark", MFD_CLOEXEC)) {
+    static const char kData[] = "-1234 567 16384\n";
+    if (mFd >= 0 && ::write(mFd, kData, sizeof(kData) - 1) == sizeof(kData) - 1) {
+      mPath = "/proc/self/fd/" + std::to_string(mFd);
+    }
+  }
+
+  ~TmpfsAttribute() {
+    if (mFd >= 0) {
+      close(mFd);
+    }
+  }
+
+  const std::string& getPath() const { return mPath; }
+
+private:
+  int mFd;
+  std::string mPath;
+};
+
+/**
+ * One sample read the former way: a new stream and a new string per read.
+ */
+void BM_ReadFromFile(benchmark::State& state) {
+  TmpfsAttribute attribute;
+  std::string path = attribute.getPath();
+  if (path.empty()) {
+    state.SkipWithError("memfd not available");
+    return;
+  }
+
+  for (auto _ : state) {
+    std::string data;
+    if (readFromFile(&path, data) != 0) {
+      state.SkipWithError("read failed");
+      break;
+    }
+    benchmark::DoNotOptimize(data.data());
+  }
+}
+
+/**
+ * One sample read through the persistent descriptor into a stack buffer.
+ */
+void BM_SysfsAttributeRead(benchmark::State& state) {
+  TmpfsAttribute attribute;
+  if (attribute.getPath().empty()) {
+    state.SkipWithError("memfd not available");
+    return;
+  }
+  SysfsAttribute sysfsAttribute(attribute.getPath());
+
+  for (auto _ : state) {
+    char buf[64];
+    if (sysfsAttribute.read(buf, sizeof(buf)) <= 0) {
+      state.SkipWithError("read failed");
+      break;
+    }
+    benchmark::DoNotOptimize(buf);
+  }
+}
+
+BENCHMARK(BM_ReadFromFile);
+BENCHMARK(BM_SysfsAttributeRead);
+
+}  // namespace
+}  // namespace hwctl
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace rb
@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+/**
+ * Stand-in for the libpower header of the host tests, whose wake lock
+ * functions are defined by the tests to count the kernel wake lock writes.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+  PARTIAL_WAKE_LOCK = 1,
+  FULL_WAKE_LOCK = 2,
+};
+
+int acquire_wake_lock(int lock, const char* id);
+int release_wake_lock(const char* id);
+
+#ifdef __cplusplus
+}
+#endif
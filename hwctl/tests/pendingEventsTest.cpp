@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "pendingEvents.h"
+
+namespace rb {
+namespace hardware {
+namespace sensors {
+namespace hwctl {
+namespace {
+
+struct TestEvent {
+  int32_t sensor = 0;
+  int64_t timestamp = 0;
+};
+
+constexpr int32_t kUndroppableSensor = 0;
+
+std::vector<TestEvent> makeEvents(int32_t sensor, size_t count, int64_t firstTimestamp) {
+  std::vector<TestEvent> events(count);
+  for (size_t i = 0; i < count; i++) {
+    events[i].sensor = sensor;
+    events[i].timestamp = firstTimestamp + static_cast<int64_t>(i);
+  }
+  return events;
+}
+
+size_t push(PendingEvents<TestEvent>& pending, const std::vector<TestEvent>& events, bool wakeup) {
+  return pending.push(events.data(), events.size(), wakeup,
+                      [](const TestEvent& event) { return event.sensor != kUndroppableSensor; });
+}
+
+std::vector<TestEvent> drain(PendingEvents<TestEvent>& pending) {
+  std::vector<TestEvent> events;
+  while (!pending.empty()) {
+    size_t count;
+    const TestEvent* front = pending.front(&count);
+    events.insert(events.end(), front, front + count);
+    pending.pop(count);
+  }
+  return events;
+}
+
+TEST(PendingEventsTest, KeepsOrderAcrossWrap) {
+  PendingEvents<TestEvent> pending(4);
+  EXPECT_EQ(push(pending, makeEvents(1, 3, 0), false), 0u);
+  pending.pop(2);
+  EXPECT_EQ(push(pending, makeEvents(1, 3, 3), false), 0u);
+  EXPECT_EQ(pending.size(), 4u);
+
+  std::vector<TestEvent> events = drain(pending);
+  ASSERT_EQ(events.size(), 4u);
+  for (size_t i = 0; i < events.size(); i++) {
+    EXPECT_EQ(events[i].timestamp, static_cast<int64_t>(i) + 2);
+  }
+  EXPECT_EQ(pending.getDropped(), 0u);
+}
+
+TEST(PendingEventsTest, DropsDroppableOldestFirst) {
+  PendingEvents<TestEvent> pending(4);
+  push(pending, makeEvents(kUndroppableSensor, 1, 0), false);
+  push(pending, makeEvents(1, 3, 1), false);
+  EXPECT_EQ(push(pending, makeEvents(1, 2, 4), false), 0u);
+
+  std::vector<TestEvent> events = drain(pending);
+  ASSERT_EQ(events.size(), 4u);
+  EXPECT_EQ(events[0].sensor, kUndroppableSensor);
+  EXPECT_EQ(events[1].timestamp, 3);
+  EXPECT_EQ(events[2].timestamp, 4);
+  EXPECT_EQ(events[3].timestamp, 5);
+  EXPECT_EQ(pending.getDropped(), 2u);
+  EXPECT_EQ(pending.getUndroppableDropped(), 0u);
+}
+
+TEST(PendingEventsTest, NonWakeUpBatchReportsEvictedWakeUps) {
+  PendingEvents<TestEvent> pending(4);
+  EXPECT_EQ(push(pending, makeEvents(1, 3, 0), true), 0u);
+
+  // The wake-up events evicted by a non wake-up batch must still be reported,
+  // or the wake lock held for them is never released
+  EXPECT_EQ(push(pending, makeEvents(2, 3, 3), false), 2u);
+  EXPECT_EQ(pending.size(), 4u);
+  EXPECT_EQ(pending.getDropped(), 2u);
+
+  // Only the remaining wake-up event is left to be released on clear
+  EXPECT_EQ(pending.clear(), 1u);
+  EXPECT_TRUE(pending.empty());
+}
+
+TEST(PendingEventsTest, CountsNewWakeUpsDroppedWhenFullOfUndroppable) {
+  PendingEvents<TestEvent> pending(2);
+  push(pending, makeEvents(kUndroppableSensor, 2, 0), false);
+  EXPECT_EQ(push(pending, makeEvents(1, 3, 2), true), 3u);
+  EXPECT_EQ(pending.size(), 2u);
+  EXPECT_EQ(pending.getDropped(), 3u);
+  EXPECT_EQ(pending.clear(), 0u);
+  EXPECT_EQ(pending.getUndroppableDropped(), 2u);
+}
+
+}  // namespace
+}  // namespace hwctl
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace rb
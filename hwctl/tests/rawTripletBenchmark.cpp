@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <stdlib.h>
+
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "rawTriplet.h"
+
+namespace rb {
+namespace hardware {
+namespace sensors {
+namespace hwctl {
+namespace {
+
+constexpr char kRawData[] = "-1234 567 16384\n";
+constexpr float kResolution = 1.0f / 2000.0f;
+
+/**
+ * The former payload parsing of the sensors: tokenized by a stream into
+ * strings, then converted as floats.
+ */
+bool parseWithStream(const std::string& data, float scale, float values[3]) {
+  std::istringstream iss(data);
+  std::vector<std::string> results(std::istream_iterator<std::string>{iss}, std::istream_iterator<std::string>());
+  if (results.size() <= 2) {
+    return false;
+  }
+  values[0] = ::atof(results[0].c_str()) * scale;
+  values[1] = ::atof(results[1].c_str()) * scale;
+  values[2] = ::atof(results[2].c_str()) * scale;
+  return true;
+}
+
+void BM_ParseWithStream(benchmark::State& state) {
+  std::string data(kRawData);
+  float values[3];
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(parseWithStream(data, kResolution, values));
+    benchmark::DoNotOptimize(values);
+  }
+}
+
+void BM_ParseScaledTriplet(benchmark::State& state) {
+  float values[3];
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(parseScaledTriplet(kRawData, kResolution, values));
+    benchmark::DoNotOptimize(values);
+  }
+}
+
+void BM_ParseRawTriplet(benchmark::State& state) {
+  int32_t values[3];
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(parseRawTriplet(kRawData, values));
+    benchmark::DoNotOptimize(values);
+  }
+}
+
+BENCHMARK(BM_ParseWithStream);
+BENCHMARK(BM_ParseScaledTriplet);
+BENCHMARK(BM_ParseRawTriplet);
+
+}  // namespace
+}  // namespace hwctl
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace rb
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include "rawTriplet.h"
+
+namespace rb {
+namespace hardware {
+namespace sensors {
+namespace hwctl {
+namespace {
+
+TEST(RawTripletTest, ParsesSeparators) {
+  int32_t values[3];
+  ASSERT_TRUE(parseRawTriplet("12 -34 +56\n", values));
+  EXPECT_EQ(values[0], 12);
+  EXPECT_EQ(values[1], -34);
+  EXPECT_EQ(values[2], 56);
+
+  ASSERT_TRUE(parseRawTriplet("1,2\t3", values));
+  EXPECT_EQ(values[0], 1);
+  EXPECT_EQ(values[1], 2);
+  EXPECT_EQ(values[2], 3);
+}
+
+TEST(RawTripletTest, ParsesInt32Limits) {
+  int32_t values[3];
+  ASSERT_TRUE(parseRawTriplet("2147483647 -2147483648 0", values));
+  EXPECT_EQ(values[0], INT32_MAX);
+  EXPECT_EQ(values[1], INT32_MIN);
+  EXPECT_EQ(values[2], 0);
+}
+
+TEST(RawTripletTest, RejectsMalformedInput) {
+  int32_t values[3];
+  EXPECT_FALSE(parseRawTriplet("", values));
+  EXPECT_FALSE(parseRawTriplet("1 2", values));
+  EXPECT_FALSE(parseRawTriplet("1 2 \n", values));
+  EXPECT_FALSE(parseRawTriplet("1 x 3", values));
+  EXPECT_FALSE(parseRawTriplet("1 2.5 3", values));
+  EXPECT_FALSE(parseRawTriplet("1 - 3", values));
+  EXPECT_FALSE(parseRawTriplet("1 --2 3", values));
+  EXPECT_FALSE(parseRawTriplet("1 2 3x", values));
+  EXPECT_FALSE(parseRawTriplet("0x10 2 3", values));
+}
+
+TEST(RawTripletTest, RejectsOverflow) {
+  int32_t values[3];
+  EXPECT_FALSE(parseRawTriplet("2147483648 0 0", values));
+  EXPECT_FALSE(parseRawTriplet("0 -2147483649 0", values));
+  EXPECT_FALSE(parseRawTriplet("0 0 99999999999999999999", values));
+}
+
+TEST(RawTripletTest, ScalesValues) {
+  float values[3];
+  ASSERT_TRUE(parseScaledTriplet("2000 -1000 0", 1.0f / 2000.0f, values));
+  EXPECT_FLOAT_EQ(values[0], 1.0f);
+  EXPECT_FLOAT_EQ(values[1], -0.5f);
+  EXPECT_FLOAT_EQ(values[2], 0.0f);
+
+  EXPECT_FALSE(parseScaledTriplet("1 2", 1.0f, values));
+}
+
+}  // namespace
+}  // namespace hwctl
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace rb
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "periodicTimer.h"
+#include "sensorScheduler.h"
+
+namespace rb {
+namespace hardware {
+namespace sensors {
+namespace hwctl {
+namespace {
+
+constexpr int64_t kNanosecondsInSeconds = 1000 * 1000 * 1000;
+constexpr int64_t kSamplingPeriodNs = 5 * 1000 * 1000;
+constexpr int64_t kRunNs = 200 * 1000 * 1000;
+
+/**
+ * Simulated sensor that only counts its deadlines.
+ */
+class CountingJob : public IScheduledJob {
+public:
+  void onDeadline(int64_t /* deadlineNs */, int64_t /* nowNs */) override { mDeadlines++; }
+
+  std::atomic<uint64_t> mDeadlines{0};
+};
+
+/**
+ * Process wide CPU time and voluntary context switches, i.e. the wakeups of
+ * threads that slept.
+ */
+struct Usage {
+  int64_t cpuNs;
+  int64_t wakeups;
+
+  static Usage get() {
+    rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+    timespec cpu = {};
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+    return {cpu.tv_sec * kNanosecondsInSeconds + cpu.tv_nsec, usage.ru_nvcsw};
+  }
+};
+
+void setCounters(benchmark::State& state, const std::vector<std::unique_ptr<CountingJob>>& jobs, const Usage& total) {
+  uint64_t deadlines = 0;
+  for (const auto& job : jobs) {
+    deadlines += job->mDeadlines;
+  }
+  double runNs = static_cast<double>(state.iterations() * kRunNs);
+  state.counters["deadlines/s"] = deadlines * kNanosecondsInSeconds / runNs;
+  state.counters["wakeups/s"] = total.wakeups * kNanosecondsInSeconds / runNs;
+  state.counters["cpu%"] = total.cpuNs * 100.0 / runNs;
+}
+
+/**
+ * All sensors are jobs of one SensorScheduler thread.
+ */
+void BM_SharedScheduler(benchmark::State& state) {
+  std::vector<std::unique_ptr<CountingJob>> jobs;
+  for (int64_t i = 0; i < state.range(0); i++) {
+    jobs.push_back(std::make_unique<CountingJob>());
+  }
+  SensorScheduler scheduler;
+  Usage total = {};
+
+  for (auto _ : state) {
+    Usage before = Usage::get();
+    for (auto& job : jobs) {
+      scheduler.schedule(job.get(), kSamplingPeriodNs);
+    }
+    std::this_thread::sleep_for(std::chrono::nanoseconds(kRunNs));
+    for (auto& job : jobs) {
+      scheduler.remove(job.get());
+    }
+    Usage after = Usage::get();
+    total.cpuNs += after.cpuNs - before.cpuNs;
+    total.wakeups += after.wakeups - before.wakeups;
+  }
+  setCounters(state, jobs, total);
+}
+
+/**
+ * The former model: every sensor samples on its own thread, sleeping until
+ * its next deadline.
+ */
+void BM_ThreadPerSensor(benchmark::State& state) {
+  std::vector<std::unique_ptr<CountingJob>> jobs;
+  for (int64_t i = 0; i < state.range(0); i++) {
+    jobs.push_back(std::make_unique<CountingJob>());
+  }
+  Usage total = {};
+
+  for (auto _ : state) {
+    Usage before = Usage::get();
+    std::atomic_bool run(true);
+    std::vector<std::thread> threads;
+    for (auto& job : jobs) {
+      threads.emplace_back([&run, job = job.get()] {
+        int64_t deadlineNs = PeriodicTimer::now();
+        while (run) {
+          timespec deadline = {static_cast<time_t>(deadlineNs / kNanosecondsInSeconds),
+                               static_cast<long>(deadlineNs % kNanosecondsInSeconds)};
+          clock_nanosleep(CLOCK_BOOTTIME, TIMER_ABSTIME, &deadline, nullptr);
+          job->onDeadline(deadlineNs, PeriodicTimer::now());
+          deadlineNs += kSamplingPeriodNs;
+        }
+      });
+    }
+    std::this_thread::sleep_for(std::chrono::nanoseconds(kRunNs));
+    run = false;
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    Usage after = Usage::get();
+    total.cpuNs += after.cpuNs - before.cpuNs;
+    total.wakeups += after.wakeups - before.wakeups;
+  }
+  setCounters(state, jobs, total);
+}
+
+BENCHMARK(BM_SharedScheduler)->Arg(2)->Arg(8)->Arg(32)->Iterations(5)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ThreadPerSensor)->Arg(2)->Arg(8)->Arg(32)->Iterations(5)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+}  // namespace
+}  // namespace hwctl
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace rb
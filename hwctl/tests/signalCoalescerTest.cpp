@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <iterator>
+#include <mutex>
+#include <thread>
+
+#include "signalCoalescer.h"
+
+namespace rb {
+namespace hardware {
+namespace sensors {
+namespace hwctl {
+namespace {
+
+constexpr int64_t kLongWindowNs = 1000 * 1000 * 1000;
+constexpr int64_t kShortWindowNs = 10 * 1000 * 1000;
+constexpr size_t kNoMaxPending = 0;
+
+/**
+ * Counts the signals sent from the background thread of the coalescer.
+ */
+class SignalCoalescerTest : public ::testing::Test {
+protected:
+  std::function<void()> getSignal() {
+    return [this] {
+      std::lock_guard<std::mutex> lock(mLock);
+      mThreadSignals++;
+      mSignalled.notify_all();
+    };
+  }
+
+  int getThreadSignals() {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mThreadSignals;
+  }
+
+  bool waitForThreadSignals(int count) {
+    std::unique_lock<std::mutex> lock(mLock);
+    return mSignalled.wait_for(lock, std::chrono::seconds(2), [&] { return mThreadSignals >= count; });
+  }
+
+  static size_t getThreadCount() {
+    auto tasks = std::filesystem::directory_iterator("/proc/self/task");
+    return static_cast<size_t>(std::distance(begin(tasks), end(tasks)));
+  }
+
+  std::mutex mLock;
+  std::condition_variable mSignalled;
+  int mThreadSignals = 0;
+};
+
+TEST_F(SignalCoalescerTest, UrgentWriteSignalsImmediately) {
+  SignalCoalescer coalescer(getSignal(), kLongWindowNs, kNoMaxPending);
+  EXPECT_FALSE(coalescer.onWrite(4, false));
+  EXPECT_TRUE(coalescer.onWrite(1, true));
+
+  SignalCoalescerStats stats = coalescer.getStats();
+  EXPECT_EQ(stats.events, 5u);
+  EXPECT_EQ(stats.signals, 1u);
+  EXPECT_LT(stats.maxDelayNs, kLongWindowNs);
+  EXPECT_EQ(getThreadSignals(), 0);
+}
+
+TEST_F(SignalCoalescerTest, MaxPendingSignals) {
+  SignalCoalescer coalescer(getSignal(), kLongWindowNs, 4 /* maxPending */);
+  EXPECT_FALSE(coalescer.onWrite(2, false));
+  EXPECT_FALSE(coalescer.onWrite(1, false));
+  EXPECT_TRUE(coalescer.onWrite(1, false));
+  EXPECT_FALSE(coalescer.onWrite(1, false));
+  EXPECT_TRUE(coalescer.onWrite(8, false));
+
+  SignalCoalescerStats stats = coalescer.getStats();
+  EXPECT_EQ(stats.events, 13u);
+  EXPECT_EQ(stats.signals, 2u);
+  EXPECT_EQ(getThreadSignals(), 0);
+}
+
+TEST_F(SignalCoalescerTest, WindowDeadlineSignalsFromThread) {
+  SignalCoalescer coalescer(getSignal(), kShortWindowNs, kNoMaxPending);
+  EXPECT_FALSE(coalescer.onWrite(2, false));
+  EXPECT_FALSE(coalescer.onWrite(3, false));
+  ASSERT_TRUE(waitForThreadSignals(1));
+
+  SignalCoalescerStats stats = coalescer.getStats();
+  EXPECT_EQ(stats.events, 5u);
+  EXPECT_EQ(stats.signals, 1u);
+  EXPECT_GE(stats.maxDelayNs, kShortWindowNs);
+  EXPECT_GE(stats.meanDelayNs, kShortWindowNs);
+
+  // The next write starts a new window
+  EXPECT_FALSE(coalescer.onWrite(1, false));
+  ASSERT_TRUE(waitForThreadSignals(2));
+  EXPECT_EQ(coalescer.getStats().signals, 2u);
+}
+
+TEST_F(SignalCoalescerTest, ClearForgetsPendingEvents) {
+  SignalCoalescer coalescer(getSignal(), kShortWindowNs, kNoMaxPending);
+  EXPECT_FALSE(coalescer.onWrite(1, false));
+  coalescer.clear();
+  std::this_thread::sleep_for(std::chrono::nanoseconds(3 * kShortWindowNs));
+  EXPECT_EQ(getThreadSignals(), 0);
+  EXPECT_EQ(coalescer.getStats().signals, 0u);
+}
+
+TEST_F(SignalCoalescerTest, ZeroWindowSignalsEveryWriteWithoutThread) {
+  size_t threads = getThreadCount();
+  SignalCoalescer coalescer(getSignal(), 0 /* windowNs */, kNoMaxPending);
+  EXPECT_EQ(getThreadCount(), threads);
+
+  EXPECT_TRUE(coalescer.onWrite(1, false));
+  EXPECT_TRUE(coalescer.onWrite(3, false));
+  SignalCoalescerStats stats = coalescer.getStats();
+  EXPECT_EQ(stats.events, 4u);
+  EXPECT_EQ(stats.signals, 2u);
+  EXPECT_EQ(stats.maxDelayNs, 0);
+  EXPECT_EQ(getThreadSignals(), 0);
+}
+
+}  // namespace
+}  // namespace hwctl
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace rb
@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <hardware_legacy/power.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "periodicTimer.h"
+#include "wakeLock.h"
+
+namespace {
+
+int gAcquireCalls = 0;
+int gReleaseCalls = 0;
+
+}  // namespace
+
+int acquire_wake_lock(int /* lock */, const char* /* id */) {
+  gAcquireCalls++;
+  return 0;
+}
+
+int release_wake_lock(const char* /* id */) {
+  gReleaseCalls++;
+  return 0;
+}
+
+namespace rb {
+namespace hardware {
+namespace sensors {
+namespace hwctl {
+namespace {
+
+constexpr int64_t kTimeoutNs = 1000 * 1000 * 1000;
+constexpr int64_t kLingerNs = 20 * 1000 * 1000;
+
+class WakeLockTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    gAcquireCalls = 0;
+    gReleaseCalls = 0;
+  }
+
+  static void sleepNs(int64_t durationNs) { std::this_thread::sleep_for(std::chrono::nanoseconds(durationNs)); }
+};
+
+TEST_F(WakeLockTest, ReleasesAfterLingerExpiry) {
+  WakeLock wakeLock("wakeLockTest", kTimeoutNs, kLingerNs);
+  int64_t beforeNs = PeriodicTimer::now();
+  int64_t deadlineNs = wakeLock.update(2, 0);
+  EXPECT_GE(deadlineNs, beforeNs + kTimeoutNs);
+  EXPECT_TRUE(wakeLock.getStats().isHeld);
+  EXPECT_EQ(gAcquireCalls, 1);
+
+  // All events handled, the lock lingers
+  deadlineNs = wakeLock.update(0, 2);
+  EXPECT_GT(deadlineNs, 0);
+  EXPECT_LE(deadlineNs, PeriodicTimer::now() + kLingerNs);
+  EXPECT_TRUE(wakeLock.getStats().isHeld);
+  EXPECT_EQ(gReleaseCalls, 0);
+
+  sleepNs(deadlineNs - PeriodicTimer::now());
+  EXPECT_EQ(wakeLock.update(0, 0), 0);
+  WakeLockStats stats = wakeLock.getStats();
+  EXPECT_FALSE(stats.isHeld);
+  EXPECT_EQ(stats.acquisitions, 1u);
+  EXPECT_EQ(stats.releases, 1u);
+  EXPECT_EQ(stats.autoReleases, 0u);
+  EXPECT_EQ(gReleaseCalls, 1);
+}
+
+TEST_F(WakeLockTest, ReacquireWithinLingerKeepsLock) {
+  WakeLock wakeLock("wakeLockTest", kTimeoutNs, kLingerNs);
+  for (int i = 0; i < 10; i++) {
+    wakeLock.update(1, 0);
+    wakeLock.update(0, 1);
+  }
+  WakeLockStats stats = wakeLock.getStats();
+  EXPECT_TRUE(stats.isHeld);
+  EXPECT_EQ(stats.acquisitions, 1u);
+  EXPECT_EQ(stats.releases, 0u);
+  EXPECT_EQ(gAcquireCalls, 1);
+  EXPECT_EQ(gReleaseCalls, 0);
+
+  // A new event restarts the linger period
+  sleepNs(kLingerNs / 2);
+  wakeLock.update(1, 0);
+  sleepNs(kLingerNs / 2);
+  wakeLock.update(0, 1);
+  EXPECT_TRUE(wakeLock.getStats().isHeld);
+}
+
+TEST_F(WakeLockTest, ReleasesWhenCountReachesZeroWithoutLinger) {
+  WakeLock wakeLock("wakeLockTest", kTimeoutNs, 0 /* lingerNs */);
+  wakeLock.update(3, 0);
+  EXPECT_GT(wakeLock.update(0, 2), 0);
+  EXPECT_TRUE(wakeLock.getStats().isHeld);
+
+  EXPECT_EQ(wakeLock.update(0, 1), 0);
+  EXPECT_FALSE(wakeLock.getStats().isHeld);
+  EXPECT_EQ(gAcquireCalls, 1);
+  EXPECT_EQ(gReleaseCalls, 1);
+
+  // More handled events than written ones do not underflow the count
+  EXPECT_EQ(wakeLock.update(0, 5), 0);
+  EXPECT_GT(wakeLock.update(1, 0), 0);
+  EXPECT_EQ(wakeLock.update(0, 1), 0);
+  EXPECT_EQ(gAcquireCalls, 2);
+}
+
+TEST_F(WakeLockTest, AutoReleaseDiscardsLateHandledCounts) {
+  constexpr int64_t kShortTimeoutNs = 100 * 1000 * 1000;
+  WakeLock wakeLock("wakeLockTest", kShortTimeoutNs, 0 /* lingerNs */);
+  wakeLock.update(2, 0);
+  sleepNs(kShortTimeoutNs);
+  EXPECT_EQ(wakeLock.update(0, 0), 0);
+  WakeLockStats stats = wakeLock.getStats();
+  EXPECT_FALSE(stats.isHeld);
+  EXPECT_EQ(stats.autoReleases, 1u);
+
+  // The late counts of the auto released events must not release the lock
+  // held for a newer one
+  wakeLock.update(1, 0);
+  EXPECT_GT(wakeLock.update(0, 2), 0);
+  EXPECT_TRUE(wakeLock.getStats().isHeld);
+  EXPECT_EQ(wakeLock.update(0, 1), 0);
+  EXPECT_FALSE(wakeLock.getStats().isHeld);
+}
+
+TEST_F(WakeLockTest, WaitUntilHeld) {
+  WakeLock wakeLock("wakeLockTest", kTimeoutNs, kLingerNs);
+  std::atomic_bool keepWaiting(true);
+  std::thread waiter([&] { wakeLock.waitUntilHeld(keepWaiting); });
+  wakeLock.update(1, 0);
+  waiter.join();
+
+  wakeLock.update(0, 1);
+  sleepNs(kLingerNs);
+  wakeLock.update(0, 0);
+  ASSERT_FALSE(wakeLock.getStats().isHeld);
+  waiter = std::thread([&] { wakeLock.waitUntilHeld(keepWaiting); });
+  keepWaiting = false;
+  wakeLock.wakeWaiters();
+  waiter.join();
+}
+
+}  // namespace
+}  // namespace hwctl
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace rb
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wakeLock.h"
+
+#include <hardware_legacy/power.h>
+#include <inttypes.h>
+#include <log/log.h>
+
+#include <algorithm>
+
+#include "periodicTimer.h"
+
+namespace rb {
+namespace hardware {
+namespace sensors {
+namespace hwctl {
+
+constexpr int64_t kNanosecondsInSeconds = 1000 * 1000 * 1000;
+
+WakeLock::WakeLock(const std::string& name, int64_t timeoutNs, int64_t lingerNs)
+  : mName(name),
+    mTimeoutNs(timeoutNs),
+    mLingerNs(lingerNs),
+    mCreateTimeNs(PeriodicTimer::now()),
+    mIsHeld(false),
+    mOutstanding(0),
+    mLastWriteNs(0),
+    mIdleSinceNs(0),
+    mAutoReleased(0),
+    mAutoReleaseNs(0),
+    mAcquisitions(0),
+    mReleases(0),
+    mAutoReleases(0) {}
+
+WakeLock::~WakeLock() {
+  if (mIsHeld) {
+    release_wake_lock(mName.c_str());
+  }
+}
+
+int64_t WakeLock::update(int32_t eventsWritten, int32_t eventsHandled) {
+  std::lock_guard<std::mutex> lock(mLock);
+  int64_t nowNs = PeriodicTimer::now();
+
+  // The framework handles events in order, so the late counts of auto
+  // released events come before the ones of newer events
+  if (mAutoReleased > 0 && nowNs - mAutoReleaseNs >= mTimeoutNs) {
+    mAutoReleased = 0;
+  }
+  int64_t lateHandled = std::min<int64_t>(std::max(eventsHandled, 0), mAutoReleased);
+  mAutoReleased -= lateHandled;
+  eventsHandled -= static_cast<int32_t>(lateHandled);
+
+  bool wasIdle = mOutstanding == 0;
+  mOutstanding = std::max<int64_t>(mOutstanding + eventsWritten - eventsHandled, 0);
+  if (eventsWritten > 0) {
+    mLastWriteNs = nowNs;
+  }
+  if (mOutstanding == 0 && !wasIdle) {
+    mIdleSinceNs = nowNs;
+  }
+
+  if (!mIsHeld) {
+    if (mOutstanding > 0 && acquire_wake_lock(PARTIAL_WAKE_LOCK, mName.c_str()) == 0) {
+      mIsHeld = true;
+      mAcquisitions++;
+      mHeldCondition.notify_all();
+    } else {
+      return 0;
+    }
+  }
+
+  if (mOutstanding > 0 && nowNs - mLastWriteNs >= mTimeoutNs) {
+    ALOGD("No events read from wake lock FMQ for %" PRId64 " ms, auto releasing wake lock",
+          mTimeoutNs / 1000 / 1000);
+    mAutoReleased += mOutstanding;
+    mAutoReleaseNs = nowNs;
+    mOutstanding = 0;
+    mIdleSinceNs = nowNs - mLingerNs;
+    mAutoReleases++;
+  }
+
+  if (mOutstanding == 0 && nowNs - mIdleSinceNs >= mLingerNs) {
+    if (release_wake_lock(mName.c_str()) == 0) {
+      mIsHeld = false;
+      mReleases++;
+      return 0;
+    }
+  }
+  return mOutstanding == 0 ? mIdleSinceNs + mLingerNs : mLastWriteNs + mTimeoutNs;
+}
+
+void WakeLock::waitUntilHeld(const std::atomic_bool& keepWaiting) {
+  std::unique_lock<std::mutex> lock(mLock);
+  mHeldCondition.wait(lock, [&] { return mIsHeld || !keepWaiting.load(); });
+}
+
+void WakeLock::wakeWaiters() {
+  std::lock_guard<std::mutex> lock(mLock);
+  mHeldCondition.notify_all();
+}
+
+WakeLockStats WakeLock::getStats() {
+  std::lock_guard<std::mutex> lock(mLock);
+  WakeLockStats stats;
+  int64_t elapsedNs = PeriodicTimer::now() - mCreateTimeNs;
+
+  stats.isHeld = mIsHeld;
+  stats.acquisitions = mAcquisitions;
+  stats.releases = mReleases;
+  stats.autoReleases = mAutoReleases;
+  stats.acquisitionRateHz =
+    elapsedNs > 0 ? static_cast<float>(mAcquisitions) * kNanosecondsInSeconds / elapsedNs : 0.0f;
+  return stats;
+}
+
+}  // namespace hwctl
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace rb
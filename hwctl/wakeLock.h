@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+namespace rb {
+namespace hardware {
+namespace sensors {
+namespace hwctl {
+
+struct WakeLockStats {
+  bool isHeld;
+  // Kernel wake lock writes since the holder was created
+  uint64_t acquisitions;
+  uint64_t releases;
+  // Releases forced because the framework did not handle the events in time
+  uint64_t autoReleases;
+  float acquisitionRateHz;
+};
+
+/**
+ * Wake lock held while WAKE_UP events have not been handled by the framework.
+ *
+ * The lock is acquired with the first outstanding event, but only released
+ * once no event has been outstanding for the linger time. A stream of wake-up
+ * events therefore keeps the lock held instead of toggling it, and with it a
+ * sysfs write pair, per event. If the framework does not handle the events
+ * within the timeout after the last write, the lock is released anyway. The
+ * events released that way are remembered for another timeout, so that their
+ * late handled counts are discarded instead of being taken from the events of
+ * the next hold.
+ *
+ * Thread safe.
+ */
+class WakeLock {
+public:
+  static constexpr int64_t kDefaultLingerNs = 200 * 1000 * 1000;
+
+  WakeLock(const std::string& name, int64_t timeoutNs, int64_t lingerNs = kDefaultLingerNs);
+  ~WakeLock();
+
+  /**
+   * Accounts the events written to and handled by the framework, acquiring or
+   * releasing the lock as needed. Returns the CLOCK_BOOTTIME time of the next
+   * release deadline, at which update() must be called again, or 0 if the lock
+   * is not held.
+   */
+  int64_t update(int32_t eventsWritten, int32_t eventsHandled);
+
+  /**
+   * Blocks until the lock is acquired, or until keepWaiting is cleared and
+   * wakeWaiters() is called.
+   */
+  void waitUntilHeld(const std::atomic_bool& keepWaiting);
+
+  /**
+   * Wakes up the waitUntilHeld() callers to recheck their keepWaiting flag.
+   */
+  void wakeWaiters();
+
+  WakeLockStats getStats();
+
+private:
+  const std::string mName;
+  const int64_t mTimeoutNs;
+  const int64_t mLingerNs;
+  const int64_t mCreateTimeNs;
+
+  std::mutex mLock;
+  std::condition_variable mHeldCondition;
+  bool mIsHeld;
+  int64_t mOutstanding;
+  int64_t mLastWriteNs;
+  int64_t mIdleSinceNs;
+  // Events dropped by the last auto release, and when
+  int64_t mAutoReleased;
+  int64_t mAutoReleaseNs;
+
+  uint64_t mAcquisitions;
+  uint64_t mReleases;
+  uint64_t mAutoReleases;
+};
+
+}  // namespace hwctl
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace rb
@@ -23,6 +23,9 @@
 #define IIO_NAME_MAXLEN 30
 #define MAX_FILENAME_LEN 256
 
+#define IIO_SYSFS_ROOT "/sys/bus/iio/devices"
+#define IIO_DEVICE_PREFIX "iio:device"
+
 static inline int wr_sysfs_twoint(const char *filename, char *basedir, int val1,
                                   int val2) {
   FILE *fp;
@@ -100,4 +103,87 @@ static inline int rd_sysfs_oneint(const char *filename, char *basedir,
   return 0;
 }
 
+/*
+ * Writes val to a sysfs attribute through a descriptor that is opened on the
+ * first call and kept in *pfd, instead of reopening the file on every write.
+ * The write is skipped if *pcached already holds val.
+ */
+static inline int wr_sysfs_cached_oneint(int *pfd, int *pcached,
+                                         const char *filename, char *basedir,
+                                         int val) {
+  char fname_buf[MAX_FILENAME_LEN + 1];
+  char val_buf[16];
+  int len;
+
+  if (*pfd >= 0 && *pcached == val) {
+    return 0;
+  }
+
+  if (*pfd < 0) {
+    snprintf(fname_buf, MAX_FILENAME_LEN, "%s/%s", basedir, filename);
+    *pfd = open(fname_buf, O_WRONLY | O_CLOEXEC);
+    if (*pfd < 0) {
+      return -errno;
+    }
+  }
+
+  len = snprintf(val_buf, sizeof(val_buf), "%d", val);
+  if (pwrite(*pfd, val_buf, len, 0) < 0) {
+    int err = -errno;
+    close(*pfd);
+    *pfd = -1;
+    return err;
+  }
+  *pcached = val;
+
+  return 0;
+}
+
+/*
+ * Looks up the IIO device whose name attribute matches name and stores its
+ * sysfs directory in basedir. If several devices match, the one with the
+ * lowest device number is used.
+ */
+static inline int find_iio_device(const char *name, char *basedir,
+                                  size_t len) {
+  DIR *dir;
+  struct dirent *entry;
+  FILE *fp;
+  char fname_buf[MAX_FILENAME_LEN + 1];
+  char dev_name[IIO_NAME_MAXLEN + 1];
+  int dev_num;
+  int found_num = -1;
+
+  dir = opendir(IIO_SYSFS_ROOT);
+  if (NULL == dir) {
+    return -errno;
+  }
+
+  while ((entry = readdir(dir)) != NULL) {
+    if (strncmp(entry->d_name, IIO_DEVICE_PREFIX,
+                strlen(IIO_DEVICE_PREFIX)) != 0) {
+      continue;
+    }
+    dev_num = atoi(entry->d_name + strlen(IIO_DEVICE_PREFIX));
+    if (found_num >= 0 && dev_num >= found_num) {
+      continue;
+    }
+
+    snprintf(fname_buf, MAX_FILENAME_LEN, "%s/%s/name", IIO_SYSFS_ROOT,
+             entry->d_name);
+    fp = fopen(fname_buf, "r");
+    if (NULL == fp) {
+      continue;
+    }
+    if (1 == fscanf(fp, "%30s", dev_name) && 0 == strcmp(dev_name, name)) {
+      snprintf(basedir, len, "%s/%s", IIO_SYSFS_ROOT, entry->d_name);
+      found_num = dev_num;
+    }
+    fclose(fp);
+  }
+  closedir(dir);
+
+  return (found_num >= 0) ? 0 : -ENODEV;
+}
+
 #endif /* __SENSORD_HWCNTL_IIO_H */
@@ -72,8 +72,18 @@
 #define SAMPLING_INTERVAL_OFFSET 600
 static uint32_t sampling_interval = US_PER_SEC;
 
+#define SMI240_IIO_NAME "smi240"
+#define SMI240_IIO_DEFAULT_DIR IIO_SYSFS_ROOT "/" IIO_DEVICE_PREFIX "0"
+
 [[maybe_unused]] static int32_t gyro_scan_size;
 static int acc_fd = -1;
+static char smi240_dir[MAX_FILENAME_LEN + 1];
+
+/* Accel and gyro share the ODR of the chip, which follows the faster one */
+static int32_t acc_odr_Hz = 0;
+static int32_t gyr_odr_Hz = 0;
+static int smi240_odr_fd = -1;
+static int smi240_odr_Hz = 0;
 
 [[maybe_unused]] static int gyr_fd = -1;
 [[maybe_unused]] static int gyr_device_num = 0;
@@ -179,19 +189,36 @@ static inline int32_t SMI240_convert_ODR(int32_t bsx_list_inx, float Hz) {
   return 0;
 }
 
-static void ap_config_phyACC(bsx_f32_t sample_rate, uint16_t fifo_data_len) {
-  int32_t odr_Hz;
+static void ap_apply_smi240_odr() {
+  int32_t odr_Hz = (acc_odr_Hz > gyr_odr_Hz) ? acc_odr_Hz : gyr_odr_Hz;
+  int ret;
+
+  if (0 == odr_Hz) {
+    return;
+  }
+
+  sampling_interval = US_PER_SEC / odr_Hz;
+  ret = wr_sysfs_cached_oneint(&smi240_odr_fd, &smi240_odr_Hz,
+                               "sampling_frequency", smi240_dir, odr_Hz);
+  if (ret) {
+    PERR("set smi240 odr %d failed: %d", odr_Hz, ret);
+  } else {
+    PDEBUG("set smi240 odr: %d", odr_Hz);
+  }
+}
 
+static void ap_config_phyACC(bsx_f32_t sample_rate, uint16_t fifo_data_len) {
   if (ACC_CHIP_SMI240 == accl_chip) {
     if (SAMPLE_RATE_DISABLED == sample_rate) {
       PDEBUG("shutdown acc");
+      acc_odr_Hz = 0;
     } else {
       PDEBUG("set acc active");
       PINFO("set physical ACC rate %f", sample_rate);
-      odr_Hz = SMI240_convert_ODR(SENSORLIST_INX_ACCELEROMETER, sample_rate);
-      PDEBUG("set acc odr: %f", odr_Hz);
-      sampling_interval = US_PER_SEC / odr_Hz;
+      acc_odr_Hz =
+          SMI240_convert_ODR(SENSORLIST_INX_ACCELEROMETER, sample_rate);
     }
+    ap_apply_smi240_odr();
   }
 
   return;
@@ -201,10 +228,13 @@ static void ap_config_phyGYR(bsx_f32_t sample_rate, uint16_t fifo_data_len) {
   if (GYR_CHIP_SMI240 == gyro_chip) {
     if (SAMPLE_RATE_DISABLED == sample_rate) {
       PDEBUG("shutdown gyro");
+      gyr_odr_Hz = 0;
     } else {
       PDEBUG("set gyro active");
-      PINFO("set physical GYRO rate aligned with ACC");
+      PINFO("set physical GYRO rate %f", sample_rate);
+      gyr_odr_Hz = SMI240_convert_ODR(SENSORLIST_INX_GYROSCOPE, sample_rate);
     }
+    ap_apply_smi240_odr();
   }
 
   return;
@@ -508,12 +538,15 @@ static void ap_hw_poll_smi240acc(BoschSimpleList *dest_list_acc) {
   int32_t ret, x, y, z;
   char data[100];
   HW_DATA_UNION *p_hwdata;
-  struct timespec timestamp;
+  int64_t read_start, timestamp;
 
+  /* Android event timestamps are CLOCK_BOOTTIME. The middle of the sysfs read
+   * is used as capture time so that the read latency does not add to it. */
+  read_start = sensord_get_tmstmp_ns();
   while ((ret = read(acc_fd, data, sizeof(data))) > 0) {
     data[ret] = '\0';
 
-    clock_gettime(CLOCK_MONOTONIC, &timestamp);
+    timestamp = read_start + (sensord_get_tmstmp_ns() - read_start) / 2;
     sysfs_extract_numbers(data, &x, &y, &z);
     PNOTE("acc data: x %d, y %d, z %d", x, y, z);
 
@@ -527,7 +560,7 @@ static void ap_hw_poll_smi240acc(BoschSimpleList *dest_list_acc) {
     p_hwdata->x = x;
     p_hwdata->y = y;
     p_hwdata->z = z;
-    p_hwdata->timestamp = timestamp.tv_sec * 1000000000LL + timestamp.tv_nsec;
+    p_hwdata->timestamp = timestamp;
 
     ret = dest_list_acc->list_add_rear((void *)p_hwdata);
     if (ret) {
@@ -550,12 +583,15 @@ static void ap_hw_poll_smi240gyro(BoschSimpleList *dest_list) {
   int32_t ret, x, y, z;
   char data[100];
   HW_DATA_UNION *p_hwdata;
-  struct timespec timestamp;
+  int64_t read_start, timestamp;
 
+  /* Android event timestamps are CLOCK_BOOTTIME. The middle of the sysfs read
+   * is used as capture time so that the read latency does not add to it. */
+  read_start = sensord_get_tmstmp_ns();
   while ((ret = read(gyr_fd, data, sizeof(data))) > 0) {
     data[ret] = '\0';
 
-    clock_gettime(CLOCK_MONOTONIC, &timestamp);
+    timestamp = read_start + (sensord_get_tmstmp_ns() - read_start) / 2;
     sysfs_extract_numbers(data, &x, &y, &z);
     PNOTE("gyro data: x %d, y %d, z %d", x, y, z);
 
@@ -569,7 +605,7 @@ static void ap_hw_poll_smi240gyro(BoschSimpleList *dest_list) {
     p_hwdata->x_uncalib = x;
     p_hwdata->y_uncalib = y;
     p_hwdata->z_uncalib = z;
-    p_hwdata->timestamp = timestamp.tv_sec * 1000000000LL + timestamp.tv_nsec;
+    p_hwdata->timestamp = timestamp;
 
     hw_remap_sensor_data(&(p_hwdata->x_uncalib), &(p_hwdata->y_uncalib),
                          &(p_hwdata->z_uncalib), g_place_g);
@@ -758,10 +794,24 @@ static void ap_show_ver() {
   return;
 }
 
+static int32_t ap_hwcntl_open_smi240(const char *attr) {
+  char fname_buf[MAX_FILENAME_LEN + 1];
+
+  if ('\0' == smi240_dir[0]) {
+    if (find_iio_device(SMI240_IIO_NAME, smi240_dir, sizeof(smi240_dir))) {
+      PWARN("no IIO device named %s, using %s", SMI240_IIO_NAME,
+            SMI240_IIO_DEFAULT_DIR);
+      snprintf(smi240_dir, sizeof(smi240_dir), "%s", SMI240_IIO_DEFAULT_DIR);
+    }
+  }
+
+  snprintf(fname_buf, MAX_FILENAME_LEN, "%s/%s", smi240_dir, attr);
+  return open(fname_buf, O_RDONLY | O_NONBLOCK);
+}
+
 static int32_t ap_hwcntl_init_ACC() {
   if (ACC_CHIP_SMI240 == accl_chip) {
-    acc_fd = open("/sys/bus/iio/devices/iio:device0/in_accel_x&y&z_raw",
-                  O_RDONLY | O_NONBLOCK);
+    acc_fd = ap_hwcntl_open_smi240("in_accel_x&y&z_raw");
     if (-1 == acc_fd) {
       PERR("Failed to open file\n");
       return -ENODEV;
@@ -774,9 +824,7 @@ static int32_t ap_hwcntl_init_ACC() {
 
 static int32_t ap_hwcntl_init_GYRO() {
   if (GYR_CHIP_SMI240 == gyro_chip) {
-    gyr_fd = open("/sys/bus/iio/devices/iio:device0/in_anglvel_x&y&z_raw",
-                  O_RDONLY | O_NONBLOCK);
-    ;
+    gyr_fd = ap_hwcntl_open_smi240("in_anglvel_x&y&z_raw");
 
     if (-1 == gyr_fd) {
       PERR("Failed to open dir\n");
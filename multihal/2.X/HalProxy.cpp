@@ -17,6 +17,7 @@
 #include "HalProxy.h"
 
 #include <android-base/file.h>
+#include <android-base/properties.h>
 #include <android/hardware/sensors/2.0/types.h>
 #include <dlfcn.h>
 
@@ -39,6 +40,7 @@ using ::android::hardware::sensors::V2_0::EventQueueFlagBits;
 using ::android::hardware::sensors::V2_0::WakeLockQueueFlagBits;
 using ::android::hardware::sensors::V2_0::implementation::getTimeNow;
 using ::android::hardware::sensors::V2_0::implementation::kWakelockTimeoutNs;
+using ::android::hardware::sensors::V2_0::implementation::WakeupSensorBitmap;
 
 typedef V2_0::implementation::ISensorsSubHal*(SensorsHalGetSubHalFunc)(uint32_t*);
 typedef V2_1::implementation::ISensorsSubHal*(SensorsHalGetSubHalV2_1Func)(uint32_t*);
@@ -80,7 +82,10 @@ int64_t msFromNs(int64_t nanos) {
 
 HalProxy::HalProxy() {
   const char* kMultiHalConfigFile = "/vendor/etc/sensors/hals.conf";
+  int64_t loadStart = elapsedRealtimeNano();
   initializeSubHalListFromConfigFile(kMultiHalConfigFile);
+  mSubHalLoadDurationNs = elapsedRealtimeNano() - loadStart;
+  ALOGI("Loaded %zu subhals in %" PRId64 " ms", mSubHalList.size(), msFromNs(mSubHalLoadDurationNs));
   init();
 }
 
@@ -107,6 +112,7 @@ HalProxy::HalProxy(std::vector<ISensorsSubHalV2_0*>& subHalList, std::vector<ISe
 HalProxy::~HalProxy() { stopThreads(); }
 
 Return<void> HalProxy::getSensorsList_2_1(ISensorsV2_1::getSensorsList_2_1_cb _hidl_cb) {
+  logFirstSensorsList();
   std::vector<V2_1::SensorInfo> sensors;
   for (const auto& iter : mSensors) {
     sensors.push_back(iter.second);
@@ -116,6 +122,7 @@ Return<void> HalProxy::getSensorsList_2_1(ISensorsV2_1::getSensorsList_2_1_cb _h
 }
 
 Return<void> HalProxy::getSensorsList(ISensorsV2_0::getSensorsList_cb _hidl_cb) {
+  logFirstSensorsList();
   std::vector<V1_0::SensorInfo> sensors;
   for (const auto& iter : mSensors) {
     if (iter.second.type != SensorType::HINGE_ANGLE) {
@@ -201,10 +208,6 @@ Return<Result> HalProxy::initializeCommon(std::unique_ptr<EventMessageQueueWrapp
   // again we do not get new events until after initialize resets the subhals.
   disableAllSensors();
 
-  // Clears the queue if any events were pending write before.
-  mPendingWriteEventsQueue = std::queue<std::pair<std::vector<V2_1::Event>, size_t>>();
-  mSizePendingWriteEventsQueue = 0;
-
   // Clears previously connected dynamic sensors
   mDynamicSensors.clear();
 
@@ -213,6 +216,15 @@ Return<Result> HalProxy::initializeCommon(std::unique_ptr<EventMessageQueueWrapp
   // Create the Event FMQ from the eventQueueDescriptor. Reset the read/write positions.
   mEventQueue = std::move(eventQueue);
 
+  // Clears the queue if any events were pending write before, and sizes it to hold a number of
+  // full event fmqs instead of the maximum.
+  size_t pendingWriteEventsQueueSize = kMaxSizePendingWriteEventsQueue;
+  if (mEventQueue != nullptr && mEventQueue->getQuantumCount() > 0) {
+    pendingWriteEventsQueueSize = std::min(mEventQueue->getQuantumCount() * kPendingWriteEventsQueueFmqCount,
+                                           kMaxSizePendingWriteEventsQueue);
+  }
+  mPendingWriteEventsQueue.reset(pendingWriteEventsQueueSize);
+
   // Create the Wake Lock FMQ that is used by the framework to communicate whenever WAKE_UP
   // events have been successfully read and handled by the framework.
   mWakeLockQueue = std::move(wakeLockQueue);
@@ -343,13 +355,14 @@ Return<void> HalProxy::debug(const hidl_handle& fd, const hidl_vec<hidl_string>&
   stream << "  Wakelock timeout reset time: " << msFromNs(now - mWakelockTimeoutResetTime) << " ms ago" << std::endl;
   // TODO(b/142969448): Add logging for history of wakelock acquisition per subhal.
   stream << "  Wakelock ref count: " << mWakelockRefCount << std::endl;
-  stream << "  # of events on pending write writes queue: " << mSizePendingWriteEventsQueue << std::endl;
+  stream << "  # of events on pending write writes queue: " << mPendingWriteEventsQueue.getNumQueued() << std::endl;
+  stream << "  Capacity of pending write events queue: " << mPendingWriteEventsQueue.capacity() << std::endl;
   stream << " Most events seen on pending write events queue: " << mMostEventsObservedPendingWriteEventsQueue
          << std::endl;
-  if (!mPendingWriteEventsQueue.empty()) {
-    stream << "  Size of events list on front of pending writes queue: "
-           << mPendingWriteEventsQueue.front().first.size() << std::endl;
-  }
+  stream << "  # of events dropped on a full pending write events queue: " << mDroppedPendingWriteEvents
+         << std::endl;
+  stream << "  Subhals loaded in: " << msFromNs(mSubHalLoadDurationNs) << " ms" << std::endl;
+  stream << "  Sensor list collected in: " << msFromNs(mSensorListDurationNs) << " ms" << std::endl;
   stream << "  # of non-dynamic sensors across all subhals: " << mSensors.size() << std::endl;
   stream << "  # of dynamic sensors across all subhals: " << mDynamicSensors.size() << std::endl;
   stream << "SubHals (" << mSubHalList.size() << "):" << std::endl;
@@ -378,6 +391,11 @@ Return<void> HalProxy::onDynamicSensorsConnected(const hidl_vec<SensorInfo>& dyn
         sensors.push_back(sensor);
       }
     }
+    auto wakeupSensors = std::make_shared<WakeupSensorBitmap>(*getWakeupSensorBitmap(subHalIndex));
+    for (const SensorInfo& sensor : sensors) {
+      wakeupSensors->set(sensor.sensorHandle, (sensor.flags & V1_0::SensorFlagBits::WAKE_UP) != 0);
+    }
+    std::atomic_store(&mWakeupSensorBitmaps[subHalIndex], std::shared_ptr<const WakeupSensorBitmap>(wakeupSensors));
   }
   mDynamicSensorsCallback->onDynamicSensorsConnected(sensors);
   return Return<void>();
@@ -400,6 +418,11 @@ Return<void> HalProxy::onDynamicSensorsDisconnected(const hidl_vec<int32_t>& dyn
         }
       }
     }
+    auto wakeupSensors = std::make_shared<WakeupSensorBitmap>(*getWakeupSensorBitmap(subHalIndex));
+    for (int32_t sensorHandle : sensorHandles) {
+      wakeupSensors->set(sensorHandle, false /* isWakeup */);
+    }
+    std::atomic_store(&mWakeupSensorBitmaps[subHalIndex], std::shared_ptr<const WakeupSensorBitmap>(wakeupSensors));
   }
   mDynamicSensorsCallback->onDynamicSensorsDisconnected(sensorHandles);
   return Return<void>();
@@ -410,68 +433,126 @@ void HalProxy::initializeSubHalListFromConfigFile(const char* configFileName) {
   if (!subHalConfigStream) {
     ALOGE("Failed to load subHal config file: %s", configFileName);
   } else {
+    std::vector<std::string> subHalLibraryFiles;
     std::string subHalLibraryFile;
     while (subHalConfigStream >> subHalLibraryFile) {
-      void* handle = getHandleForSubHalSharedObject(subHalLibraryFile);
-      if (handle == nullptr) {
-        ALOGE("dlopen failed for library: %s", subHalLibraryFile.c_str());
+      subHalLibraryFiles.push_back(subHalLibraryFile);
+    }
+
+    // Symbols of the subhals are only resolved on first use if requested, which trades a
+    // slower first call for a faster startup.
+    int dlopenFlags = base::GetBoolProperty(kLazyBindingProperty, false) ? RTLD_LAZY : RTLD_NOW;
+
+    // The subhals are loaded concurrently, but added in the order of the config file, so that
+    // their indices and thus the sensor handles do not depend on which one finished first.
+    std::vector<std::shared_ptr<ISubHalWrapperBase>> subHals(subHalLibraryFiles.size());
+    std::vector<std::thread> loaders;
+    for (size_t i = 0; i < subHalLibraryFiles.size(); i++) {
+      loaders.emplace_back([&, i] { subHals[i] = loadSubHal(subHalLibraryFiles[i], dlopenFlags); });
+    }
+    for (std::thread& loader : loaders) {
+      loader.join();
+    }
+    for (std::shared_ptr<ISubHalWrapperBase>& subHal : subHals) {
+      if (subHal != nullptr) {
+        mSubHalList.push_back(std::move(subHal));
+      }
+    }
+  }
+}
+
+std::shared_ptr<ISubHalWrapperBase> HalProxy::loadSubHal(const std::string& subHalLibraryFile, int dlopenFlags) {
+  int64_t loadStart = elapsedRealtimeNano();
+  void* handle = getHandleForSubHalSharedObject(subHalLibraryFile, dlopenFlags);
+  if (handle == nullptr) {
+    ALOGE("dlopen failed for library: %s", subHalLibraryFile.c_str());
+    return nullptr;
+  }
+
+  std::shared_ptr<ISubHalWrapperBase> subHal;
+  SensorsHalGetSubHalFunc* sensorsHalGetSubHalPtr = (SensorsHalGetSubHalFunc*)dlsym(handle, "sensorsHalGetSubHal");
+  if (sensorsHalGetSubHalPtr != nullptr) {
+    std::function<SensorsHalGetSubHalFunc> sensorsHalGetSubHal = *sensorsHalGetSubHalPtr;
+    uint32_t version;
+    ISensorsSubHalV2_0* subHalV2_0 = sensorsHalGetSubHal(&version);
+    if (version != SUB_HAL_2_0_VERSION) {
+      ALOGE("SubHal version was not 2.0 for library: %s", subHalLibraryFile.c_str());
+    } else {
+      subHal = std::make_shared<SubHalWrapperV2_0>(subHalV2_0);
+    }
+  } else {
+    SensorsHalGetSubHalV2_1Func* getSubHalV2_1Ptr =
+      (SensorsHalGetSubHalV2_1Func*)dlsym(handle, "sensorsHalGetSubHal_2_1");
+
+    if (getSubHalV2_1Ptr == nullptr) {
+      ALOGE("Failed to locate sensorsHalGetSubHal function for library: %s", subHalLibraryFile.c_str());
+    } else {
+      std::function<SensorsHalGetSubHalV2_1Func> sensorsHalGetSubHal_2_1 = *getSubHalV2_1Ptr;
+      uint32_t version;
+      ISensorsSubHalV2_1* subHalV2_1 = sensorsHalGetSubHal_2_1(&version);
+      if (version != SUB_HAL_2_1_VERSION) {
+        ALOGE("SubHal version was not 2.1 for library: %s", subHalLibraryFile.c_str());
       } else {
-        SensorsHalGetSubHalFunc* sensorsHalGetSubHalPtr =
-          (SensorsHalGetSubHalFunc*)dlsym(handle, "sensorsHalGetSubHal");
-        if (sensorsHalGetSubHalPtr != nullptr) {
-          std::function<SensorsHalGetSubHalFunc> sensorsHalGetSubHal = *sensorsHalGetSubHalPtr;
-          uint32_t version;
-          ISensorsSubHalV2_0* subHal = sensorsHalGetSubHal(&version);
-          if (version != SUB_HAL_2_0_VERSION) {
-            ALOGE("SubHal version was not 2.0 for library: %s", subHalLibraryFile.c_str());
-          } else {
-            ALOGV("Loaded SubHal from library: %s", subHalLibraryFile.c_str());
-            mSubHalList.push_back(std::make_unique<SubHalWrapperV2_0>(subHal));
-          }
-        } else {
-          SensorsHalGetSubHalV2_1Func* getSubHalV2_1Ptr =
-            (SensorsHalGetSubHalV2_1Func*)dlsym(handle, "sensorsHalGetSubHal_2_1");
-
-          if (getSubHalV2_1Ptr == nullptr) {
-            ALOGE("Failed to locate sensorsHalGetSubHal function for library: %s", subHalLibraryFile.c_str());
-          } else {
-            std::function<SensorsHalGetSubHalV2_1Func> sensorsHalGetSubHal_2_1 = *getSubHalV2_1Ptr;
-            uint32_t version;
-            ISensorsSubHalV2_1* subHal = sensorsHalGetSubHal_2_1(&version);
-            if (version != SUB_HAL_2_1_VERSION) {
-              ALOGE("SubHal version was not 2.1 for library: %s", subHalLibraryFile.c_str());
-            } else {
-              ALOGV("Loaded SubHal from library: %s", subHalLibraryFile.c_str());
-              mSubHalList.push_back(std::make_unique<SubHalWrapperV2_1>(subHal));
-            }
-          }
-        }
+        subHal = std::make_shared<SubHalWrapperV2_1>(subHalV2_1);
       }
     }
   }
+  if (subHal != nullptr) {
+    ALOGV("Loaded SubHal from library: %s in %" PRId64 " ms", subHalLibraryFile.c_str(),
+          msFromNs(elapsedRealtimeNano() - loadStart));
+  }
+  return subHal;
 }
 
 void HalProxy::initializeSensorList() {
+  int64_t listStart = elapsedRealtimeNano();
+
+  // The subhals are queried concurrently, but their sensors are added in subhal order, as the
+  // direct channel subhal is the first one that reports a direct channel sensor.
+  std::vector<std::vector<SensorInfo>> subHalSensors(mSubHalList.size());
+  std::vector<std::thread> queries;
   for (size_t subHalIndex = 0; subHalIndex < mSubHalList.size(); subHalIndex++) {
-    auto result = mSubHalList[subHalIndex]->getSensorsList([&](const auto& list) {
-      for (SensorInfo sensor : list) {
-        if (!subHalIndexIsClear(sensor.sensorHandle)) {
-          ALOGE("SubHal sensorHandle's first byte was not 0");
-        } else {
-          ALOGV("Loaded sensor: %s", sensor.name.c_str());
-          sensor.sensorHandle = setSubHalIndex(sensor.sensorHandle, subHalIndex);
-          setDirectChannelFlags(&sensor, mSubHalList[subHalIndex]);
-          mSensors[sensor.sensorHandle] = sensor;
-        }
+    queries.emplace_back([&, subHalIndex] {
+      auto result = mSubHalList[subHalIndex]->getSensorsList(
+        [&](const auto& list) { subHalSensors[subHalIndex].assign(list.begin(), list.end()); });
+      if (!result.isOk()) {
+        ALOGE("getSensorsList call failed for SubHal: %s", mSubHalList[subHalIndex]->getName().c_str());
       }
     });
-    if (!result.isOk()) {
-      ALOGE("getSensorsList call failed for SubHal: %s", mSubHalList[subHalIndex]->getName().c_str());
+  }
+  for (std::thread& query : queries) {
+    query.join();
+  }
+
+  mWakeupSensorBitmaps.clear();
+  for (size_t subHalIndex = 0; subHalIndex < mSubHalList.size(); subHalIndex++) {
+    auto wakeupSensors = std::make_shared<WakeupSensorBitmap>();
+    for (SensorInfo sensor : subHalSensors[subHalIndex]) {
+      if (!subHalIndexIsClear(sensor.sensorHandle)) {
+        ALOGE("SubHal sensorHandle's first byte was not 0");
+      } else {
+        ALOGV("Loaded sensor: %s", sensor.name.c_str());
+        sensor.sensorHandle = setSubHalIndex(sensor.sensorHandle, subHalIndex);
+        setDirectChannelFlags(&sensor, mSubHalList[subHalIndex]);
+        mSensors[sensor.sensorHandle] = sensor;
+        wakeupSensors->set(sensor.sensorHandle, (sensor.flags & V1_0::SensorFlagBits::WAKE_UP) != 0);
+      }
     }
+    mWakeupSensorBitmaps.push_back(std::move(wakeupSensors));
+  }
+
+  mSensorListDurationNs = elapsedRealtimeNano() - listStart;
+  ALOGI("Collected %zu sensors from %zu subhals in %" PRId64 " ms", mSensors.size(), mSubHalList.size(),
+        msFromNs(mSensorListDurationNs));
+}
+
+void HalProxy::logFirstSensorsList() {
+  if (!mSensorsListReported.exchange(true)) {
+    ALOGI("First getSensorsList %" PRId64 " ms after start", msFromNs(elapsedRealtimeNano() - mCreateTimeNs));
   }
 }
 
-void* HalProxy::getHandleForSubHalSharedObject(const std::string& filename) {
+void* HalProxy::getHandleForSubHalSharedObject(const std::string& filename, int dlopenFlags) {
   static const std::string kSubHalShareObjectLocations[] = {"",  // Default locations will be searched
 #ifdef __LP64__
                                                             "/vendor/lib64/hw/", "/odm/lib64/hw/"
@@ -481,7 +562,7 @@ void* HalProxy::getHandleForSubHalSharedObject(const std::string& filename) {
   };
 
   for (const std::string& dir : kSubHalShareObjectLocations) {
-    void* handle = dlopen((dir + filename).c_str(), RTLD_NOW);
+    void* handle = dlopen((dir + filename).c_str(), dlopenFlags);
     if (handle != nullptr) {
       return handle;
     }
@@ -505,7 +586,11 @@ void HalProxy::stopThreads() {
     mWakelockQueueFlag->wake(static_cast<uint32_t>(WakeLockQueueFlagBits::DATA_WRITTEN));
   }
   mWakelockCV.notify_one();
-  mEventQueueWriteCV.notify_one();
+  {
+    // Under the lock, so the wakeup can not slip in between the check and the wait
+    std::lock_guard<std::mutex> lock(mEventQueueWriteMutex);
+    mEventQueueWriteCV.notify_one();
+  }
   if (mPendingWritesThread.joinable()) {
     mPendingWritesThread.join();
   }
@@ -529,37 +614,33 @@ void HalProxy::disableAllSensors() {
 void HalProxy::startPendingWritesThread(HalProxy* halProxy) { halProxy->handlePendingWrites(); }
 
 void HalProxy::handlePendingWrites() {
-  // TODO(b/143302327): Find a way to optimize locking strategy maybe using two mutexes instead of
-  // one.
-  std::unique_lock<std::mutex> lock(mEventQueueWriteMutex);
   while (mThreadsRun.load()) {
-    mEventQueueWriteCV.wait(lock, [&] { return !mPendingWriteEventsQueue.empty() || !mThreadsRun.load(); });
-    if (mThreadsRun.load()) {
-      std::vector<Event>& pendingWriteEvents = mPendingWriteEventsQueue.front().first;
-      size_t numWakeupEvents = mPendingWriteEventsQueue.front().second;
-      size_t eventQueueSize = mEventQueue->getQuantumCount();
-      size_t numToWrite = std::min(pendingWriteEvents.size(), eventQueueSize);
-      lock.unlock();
-      if (!mEventQueue->writeBlocking(
-            pendingWriteEvents.data(), numToWrite, static_cast<uint32_t>(EventQueueFlagBits::EVENTS_READ),
-            static_cast<uint32_t>(EventQueueFlagBits::READ_AND_PROCESS), kPendingWriteTimeoutNs, mEventQueueFlag)) {
-        ALOGE("Dropping %zu events after blockingWrite failed.", numToWrite);
-        if (numWakeupEvents > 0) {
-          if (pendingWriteEvents.size() > eventQueueSize) {
-            decrementRefCountAndMaybeReleaseWakelock(countNumWakeupEvents(pendingWriteEvents, eventQueueSize));
-          } else {
-            decrementRefCountAndMaybeReleaseWakelock(numWakeupEvents);
-          }
-        }
-      }
-      lock.lock();
-      mSizePendingWriteEventsQueue -= numToWrite;
-      if (pendingWriteEvents.size() > eventQueueSize) {
-        // TODO(b/143302327): Check if this erase operation is too inefficient. It will copy
-        // all the events ahead of it down to fill gap off array at front after the erase.
-        pendingWriteEvents.erase(pendingWriteEvents.begin(), pendingWriteEvents.begin() + eventQueueSize);
-      } else {
-        mPendingWriteEventsQueue.pop();
+    size_t numCollected = mPendingWriteEventsQueue.collect();
+    if (numCollected == 0) {
+      std::unique_lock<std::mutex> lock(mEventQueueWriteMutex);
+      mPendingWritesIdle.store(true);
+      mEventQueueWriteCV.wait(lock,
+                              [&] { return mPendingWriteEventsQueue.collect() > 0 || !mThreadsRun.load(); });
+      mPendingWritesIdle.store(false);
+      continue;
+    }
+    if (numCollected > mMostEventsObservedPendingWriteEventsQueue.load(std::memory_order_relaxed)) {
+      mMostEventsObservedPendingWriteEventsQueue.store(numCollected, std::memory_order_relaxed);
+    }
+
+    // Only this thread writes to the fmq, so the lock is not needed for the blocking write
+    size_t numToWrite;
+    const Event* pendingWriteEvents = mPendingWriteEventsQueue.front(&numToWrite);
+    numToWrite = std::min(numToWrite, mEventQueue->getQuantumCount());
+    bool success = mEventQueue->writeBlocking(
+      pendingWriteEvents, numToWrite, static_cast<uint32_t>(EventQueueFlagBits::EVENTS_READ),
+      static_cast<uint32_t>(EventQueueFlagBits::READ_AND_PROCESS), kPendingWriteTimeoutNs, mEventQueueFlag);
+    size_t numWakeupEvents =
+      mPendingWriteEventsQueue.pop(numToWrite, [this](const Event& event) { return isWakeupEvent(event); });
+    if (!success) {
+      ALOGE("Dropping %zu events after blockingWrite failed.", numToWrite);
+      if (numWakeupEvents > 0) {
+        decrementRefCountAndMaybeReleaseWakelock(numWakeupEvents);
       }
     }
   }
@@ -610,30 +691,25 @@ void HalProxy::resetSharedWakelock() {
 
 void HalProxy::postEventsToMessageQueue(const std::vector<Event>& events, size_t numWakeupEvents,
                                         V2_0::implementation::ScopedWakelock wakelock) {
-  size_t numToWrite = 0;
-  std::lock_guard<std::mutex> lock(mEventQueueWriteMutex);
-  if (wakelock.isLocked()) {
-    incrementRefCountAndMaybeAcquireWakelock(numWakeupEvents);
-  }
-  if (mPendingWriteEventsQueue.empty()) {
-    numToWrite = std::min(events.size(), mEventQueue->availableToWrite());
-    if (numToWrite > 0) {
-      if (mEventQueue->write(events.data(), numToWrite)) {
-        // TODO(b/143302327): While loop if mEventQueue->avaiableToWrite > 0 to possibly fit
-        // in more writes immediately
-        mEventQueueFlag->wake(static_cast<uint32_t>(EventQueueFlagBits::READ_AND_PROCESS));
-      } else {
-        numToWrite = 0;
-      }
+  int64_t timeoutStart = -1;
+  bool refCounted = wakelock.isLocked() && incrementRefCountAndMaybeAcquireWakelock(numWakeupEvents, &timeoutStart);
+  if (!mPendingWriteEventsQueue.push(events.data(), events.size(), numWakeupEvents)) {
+    // The events will never be written, so nothing will release their wake lock references
+    if (refCounted) {
+      decrementRefCountAndMaybeReleaseWakelock(numWakeupEvents, timeoutStart);
+    }
+    uint64_t dropped = mDroppedPendingWriteEvents.fetch_add(events.size(), std::memory_order_relaxed) + events.size();
+    int64_t now = getTimeNow();
+    int64_t lastLog = mLastDroppedEventsLogTime.load(std::memory_order_relaxed);
+    if ((lastLog == 0 || now - lastLog >= kDroppedEventsLogIntervalNs) &&
+        mLastDroppedEventsLogTime.compare_exchange_strong(lastLog, now, std::memory_order_relaxed)) {
+      ALOGE("Pending write events queue is full, dropped %zu events (%" PRIu64 " in total)", events.size(), dropped);
     }
+    return;
   }
-  size_t numLeft = events.size() - numToWrite;
-  if (numToWrite < events.size() && mSizePendingWriteEventsQueue + numLeft <= kMaxSizePendingWriteEventsQueue) {
-    std::vector<Event> eventsLeft(events.begin() + numToWrite, events.end());
-    mPendingWriteEventsQueue.push({eventsLeft, numWakeupEvents});
-    mSizePendingWriteEventsQueue += numLeft;
-    mMostEventsObservedPendingWriteEventsQueue =
-      std::max(mMostEventsObservedPendingWriteEventsQueue, mSizePendingWriteEventsQueue);
+  // The lock is only taken to wake up the pending writes thread if it went idle
+  if (mPendingWritesIdle.load()) {
+    std::lock_guard<std::mutex> lock(mEventQueueWriteMutex);
     mEventQueueWriteCV.notify_one();
   }
 }
@@ -687,15 +763,11 @@ bool HalProxy::isSubHalIndexValid(int32_t sensorHandle) {
   return extractSubHalIndex(sensorHandle) < mSubHalList.size();
 }
 
-size_t HalProxy::countNumWakeupEvents(const std::vector<Event>& events, size_t n) {
-  size_t numWakeupEvents = 0;
-  for (size_t i = 0; i < n; i++) {
-    int32_t sensorHandle = events[i].sensorHandle;
-    if (mSensors[sensorHandle].flags & static_cast<uint32_t>(V1_0::SensorFlagBits::WAKE_UP)) {
-      numWakeupEvents++;
-    }
+bool HalProxy::isWakeupEvent(const Event& event) {
+  if (!isSubHalIndexValid(event.sensorHandle)) {
+    return false;
   }
-  return numWakeupEvents;
+  return getWakeupSensorBitmap(extractSubHalIndex(event.sensorHandle))->test(event.sensorHandle);
 }
 
 int32_t HalProxy::clearSubHalIndex(int32_t sensorHandle) { return sensorHandle & (~kSensorHandleSubHalIndexMask); }
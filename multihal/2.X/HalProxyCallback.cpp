@@ -41,7 +41,7 @@ int32_t setSubHalIndex(int32_t sensorHandle, size_t subHalIndex) {
 void HalProxyCallbackBase::postEvents(const std::vector<V2_1::Event>& events, ScopedWakelock wakelock) {
   if (events.empty() || !mCallback->areThreadsRunning()) return;
   size_t numWakeupEvents;
-  std::vector<V2_1::Event> processedEvents = processEvents(events, &numWakeupEvents);
+  const std::vector<V2_1::Event>& processedEvents = processEvents(events, &numWakeupEvents);
   if (numWakeupEvents > 0) {
     ALOG_ASSERT(wakelock.isLocked(),
                 "Wakeup events posted while wakelock unlocked for subhal"
@@ -61,20 +61,21 @@ ScopedWakelock HalProxyCallbackBase::createScopedWakelock(bool lock) {
   return wakelock;
 }
 
-std::vector<V2_1::Event> HalProxyCallbackBase::processEvents(const std::vector<V2_1::Event>& events,
-                                                             size_t* numWakeupEvents) const {
+const std::vector<V2_1::Event>& HalProxyCallbackBase::processEvents(const std::vector<V2_1::Event>& events,
+                                                                    size_t* numWakeupEvents) const {
+  // Reused by all posts from the calling thread, the events are copied out before it returns
+  static thread_local std::vector<V2_1::Event> eventsOut;
+  std::shared_ptr<const WakeupSensorBitmap> wakeupSensors = mCallback->getWakeupSensorBitmap(mSubHalIndex);
   *numWakeupEvents = 0;
-  std::vector<V2_1::Event> eventsOut;
-  for (V2_1::Event event : events) {
+  eventsOut.assign(events.begin(), events.end());
+  for (V2_1::Event& event : eventsOut) {
+    if (wakeupSensors->test(event.sensorHandle)) {
+      (*numWakeupEvents)++;
+    }
     event.sensorHandle = setSubHalIndex(event.sensorHandle, mSubHalIndex);
     if (event.sensorType == V2_1::SensorType::DYNAMIC_SENSOR_META) {
       event.u.dynamic.sensorHandle = setSubHalIndex(event.u.dynamic.sensorHandle, mSubHalIndex);
     }
-    eventsOut.push_back(event);
-    const V2_1::SensorInfo& sensor = mCallback->getSensorInfo(event.sensorHandle);
-    if ((sensor.flags & V1_0::SensorFlagBits::WAKE_UP) != 0) {
-      (*numWakeupEvents)++;
-    }
   }
   return eventsOut;
 }
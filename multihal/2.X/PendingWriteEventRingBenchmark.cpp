@@ -0,0 +1,307 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android/hardware/sensors/2.1/types.h>
+#include <benchmark/benchmark.h>
+#include <fmq/MessageQueue.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "PendingWriteEventRing.h"
+
+using ::android::hardware::kSynchronizedReadWrite;
+using ::android::hardware::MessageQueue;
+using ::android::hardware::sensors::V2_1::Event;
+using ::android::hardware::sensors::V2_1::implementation::PendingWriteEventRing;
+using EventQueue = MessageQueue<Event, kSynchronizedReadWrite>;
+
+namespace {
+
+// Size of the event fmq created by the framework
+constexpr size_t kFmqSize = 256;
+// Bursts of kBurstSize events are posted every kPostInterval, twice as fast as the reader
+// stand-in drains the fmq with kReadSize events per kReadInterval
+constexpr size_t kBurstSize = 16;
+constexpr auto kPostInterval = std::chrono::microseconds(250);
+constexpr size_t kReadSize = 32;
+constexpr auto kReadInterval = std::chrono::milliseconds(1);
+constexpr auto kFullFmqRetryInterval = std::chrono::microseconds(100);
+constexpr int64_t kPosts = 4000;
+// Every producer stands for a subhal posting small bursts back to back
+constexpr size_t kStressBurstSize = 4;
+constexpr size_t kStressPostsPerProducer = 20000;
+
+int64_t now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+
+}  // namespace
+
+/**
+ * Posts bursts while the pending writes thread of HalProxy writes them to an event fmq that a
+ * slow framework keeps saturated. The pending write events queue only delays the drops, and the
+ * events it holds are delivered the later the larger it is.
+ */
+static void BM_PostToSaturatedFmq(benchmark::State& state) {
+  size_t capacity = static_cast<size_t>(state.range(0));
+  EventQueue queue(kFmqSize);
+  PendingWriteEventRing<Event> ring(capacity);
+  std::atomic_bool run(true);
+  std::atomic<int64_t> maxAgeNs(0);
+
+  std::thread writer([&] {
+    while (run.load()) {
+      if (ring.collect() == 0) {
+        std::this_thread::yield();
+        continue;
+      }
+      size_t count;
+      const Event* events = ring.front(&count);
+      count = std::min(count, queue.availableToWrite());
+      if (count == 0) {
+        std::this_thread::sleep_for(kFullFmqRetryInterval);
+        continue;
+      }
+      queue.write(events, count);
+      ring.pop(count, [](const Event&) { return false; });
+    }
+  });
+
+  std::thread reader([&] {
+    std::vector<Event> events(kReadSize);
+    while (run.load()) {
+      size_t count = std::min(queue.availableToRead(), kReadSize);
+      if (count > 0 && queue.read(events.data(), count)) {
+        int64_t ageNs = now() - events[0].timestamp;
+        if (ageNs > maxAgeNs.load(std::memory_order_relaxed)) {
+          maxAgeNs.store(ageNs, std::memory_order_relaxed);
+        }
+      }
+      std::this_thread::sleep_for(kReadInterval);
+    }
+  });
+
+  std::vector<Event> burst(kBurstSize);
+  uint64_t dropped = 0;
+  auto nextPost = std::chrono::steady_clock::now();
+  for (auto _ : state) {
+    int64_t startNs = now();
+    for (auto& event : burst) {
+      event.timestamp = startNs;
+    }
+    if (!ring.push(burst.data(), burst.size(), 0 /* numWakeupEvents */)) {
+      dropped += burst.size();
+    }
+    state.SetIterationTime((now() - startNs) / 1e9);
+    nextPost += kPostInterval;
+    std::this_thread::sleep_until(nextPost);
+  }
+
+  run.store(false);
+  writer.join();
+  reader.join();
+
+  uint64_t posted = state.iterations() * kBurstSize;
+  state.counters["dropped%"] = posted > 0 ? dropped * 100.0 / posted : 0.0;
+  state.counters["max_age_ms"] = maxAgeNs.load() / 1e6;
+  state.counters["queue_kB"] = capacity * sizeof(Event) / 1024.0;
+}
+
+/**
+ * Reads everything written to the fmq, like a framework keeping up with the events.
+ */
+class FastReader {
+public:
+  explicit FastReader(EventQueue& queue) : mThread([this, &queue] { run(queue); }) {}
+
+  ~FastReader() {
+    mRun.store(false);
+    mThread.join();
+  }
+
+private:
+  void run(EventQueue& queue) {
+    std::vector<Event> events(kFmqSize);
+    while (mRun.load()) {
+      size_t count = queue.availableToRead();
+      if (count == 0 || !queue.read(events.data(), count)) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  std::atomic_bool mRun{true};
+  std::thread mThread;
+};
+
+/**
+ * Runs state.range(0) producers that post kStressPostsPerProducer bursts each through post, and
+ * reports the p50 and p99 latency of a post.
+ */
+template <class Post>
+void runProducers(benchmark::State& state, Post post) {
+  size_t numProducers = static_cast<size_t>(state.range(0));
+  std::vector<std::vector<int64_t>> latencies(numProducers);
+
+  int64_t startNs = now();
+  std::vector<std::thread> producers;
+  for (size_t i = 0; i < numProducers; i++) {
+    producers.emplace_back([&post, &latencies = latencies[i]] {
+      std::vector<Event> burst(kStressBurstSize);
+      latencies.reserve(kStressPostsPerProducer);
+      for (size_t j = 0; j < kStressPostsPerProducer; j++) {
+        int64_t postStartNs = now();
+        post(burst);
+        latencies.push_back(now() - postStartNs);
+      }
+    });
+  }
+  for (auto& producer : producers) {
+    producer.join();
+  }
+  state.SetIterationTime((now() - startNs) / 1e9);
+
+  std::vector<int64_t> all;
+  for (const auto& producerLatencies : latencies) {
+    all.insert(all.end(), producerLatencies.begin(), producerLatencies.end());
+  }
+  std::sort(all.begin(), all.end());
+  state.SetItemsProcessed(all.size() * kStressBurstSize);
+  state.counters["p50_ns"] = all[all.size() / 2];
+  state.counters["p99_ns"] = all[all.size() * 99 / 100];
+}
+
+/**
+ * The former path: every post takes the lock shared with the pending writes thread and writes
+ * to the fmq directly, or queues the events behind the pending ones.
+ */
+static void BM_MultiProducerDirectWrite(benchmark::State& state) {
+  for (auto _ : state) {
+    EventQueue queue(kFmqSize);
+    std::mutex lock;
+    std::condition_variable pendingCV;
+    std::vector<Event> pending;
+    bool run = true;
+
+    std::thread writer([&] {
+      std::unique_lock<std::mutex> writerLock(lock);
+      while (run) {
+        pendingCV.wait(writerLock, [&] { return !pending.empty() || !run; });
+        size_t count = std::min(pending.size(), queue.availableToWrite());
+        if (count > 0 && queue.write(pending.data(), count)) {
+          pending.erase(pending.begin(), pending.begin() + count);
+        } else {
+          writerLock.unlock();
+          std::this_thread::yield();
+          writerLock.lock();
+        }
+      }
+    });
+
+    {
+      FastReader reader(queue);
+      runProducers(state, [&](const std::vector<Event>& events) {
+        std::lock_guard<std::mutex> postLock(lock);
+        size_t numWritten = 0;
+        if (pending.empty()) {
+          numWritten = std::min(events.size(), queue.availableToWrite());
+          if (numWritten > 0 && !queue.write(events.data(), numWritten)) {
+            numWritten = 0;
+          }
+        }
+        if (numWritten < events.size()) {
+          pending.insert(pending.end(), events.begin() + numWritten, events.end());
+          pendingCV.notify_one();
+        }
+      });
+
+      {
+        std::lock_guard<std::mutex> stopLock(lock);
+        run = false;
+        pendingCV.notify_one();
+      }
+      writer.join();
+    }
+  }
+}
+
+/**
+ * The staged path of HalProxy: posts push to the ring without a lock, and only take the lock to
+ * wake up the pending writes thread if it went idle.
+ */
+static void BM_MultiProducerStaged(benchmark::State& state) {
+  for (auto _ : state) {
+    EventQueue queue(kFmqSize);
+    PendingWriteEventRing<Event> ring(kFmqSize * 16);
+    std::mutex lock;
+    std::condition_variable pendingCV;
+    std::atomic_bool idle(false);
+    std::atomic_bool run(true);
+
+    std::thread writer([&] {
+      while (run.load()) {
+        if (ring.collect() == 0) {
+          std::unique_lock<std::mutex> writerLock(lock);
+          idle.store(true);
+          pendingCV.wait(writerLock, [&] { return ring.collect() > 0 || !run.load(); });
+          idle.store(false);
+          continue;
+        }
+        size_t count;
+        const Event* events = ring.front(&count);
+        count = std::min(count, queue.availableToWrite());
+        if (count > 0 && queue.write(events, count)) {
+          ring.pop(count, [](const Event&) { return false; });
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+
+    {
+      FastReader reader(queue);
+      runProducers(state, [&](const std::vector<Event>& events) {
+        while (!ring.push(events.data(), events.size(), 0 /* numWakeupEvents */)) {
+          std::this_thread::yield();
+        }
+        if (idle.load()) {
+          std::lock_guard<std::mutex> postLock(lock);
+          pendingCV.notify_one();
+        }
+      });
+
+      {
+        std::lock_guard<std::mutex> stopLock(lock);
+        run.store(false);
+        pendingCV.notify_one();
+      }
+      writer.join();
+    }
+  }
+}
+
+BENCHMARK(BM_PostToSaturatedFmq)->Arg(kFmqSize * 16)->Arg(100000)->Iterations(kPosts)->UseManualTime();
+BENCHMARK(BM_MultiProducerDirectWrite)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Iterations(1)->UseManualTime();
+BENCHMARK(BM_MultiProducerStaged)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Iterations(1)->UseManualTime();
+
+BENCHMARK_MAIN();
@@ -22,17 +22,19 @@
 #include <hardware_legacy/power.h>
 #include <hidl/MQDescriptor.h>
 #include <hidl/Status.h>
+#include <utils/SystemClock.h>
 
 #include <atomic>
 #include <condition_variable>
 #include <map>
+#include <memory>
 #include <mutex>
-#include <queue>
 #include <thread>
 #include <utility>
 
 #include "EventMessageQueueWrapper.h"
 #include "HalProxyCallback.h"
+#include "PendingWriteEventRing.h"
 #include "ISensorsCallbackWrapper.h"
 #include "SubHalWrapper.h"
 #include "V2_0/ScopedWakelock.h"
@@ -124,6 +126,10 @@ public:
 
   const SensorInfo& getSensorInfo(int32_t sensorHandle) override { return mSensors[sensorHandle]; }
 
+  std::shared_ptr<const V2_0::implementation::WakeupSensorBitmap> getWakeupSensorBitmap(int32_t subHalIndex) override {
+    return std::atomic_load(&mWakeupSensorBitmaps[subHalIndex]);
+  }
+
   bool areThreadsRunning() override { return mThreadsRun.load(); }
 
   // Below methods are from IScopedWakelockRefCounter interface
@@ -179,6 +185,13 @@ private:
   //! Map of the dynamic sensors that have been added to halproxy.
   std::map<int32_t, SensorInfo> mDynamicSensors;
 
+  /**
+   * The wakeup sensors of each subhal, indexed by subhal index. The bitmaps are built in
+   * initializeSensorList and replaced atomically when dynamic sensors are (dis)connected, so the
+   * subhal threads classify their events without taking a lock.
+   */
+  std::vector<std::shared_ptr<const V2_0::implementation::WakeupSensorBitmap>> mWakeupSensorBitmaps;
+
   //! The current operation mode for all subhals.
   OperationMode mCurrentOperationMode = OperationMode::NORMAL;
 
@@ -191,27 +204,40 @@ private:
   //! The bit mask used to get the subhal index from a sensor handle.
   static constexpr int32_t kSensorHandleSubHalIndexMask = 0xFF000000;
 
+  //! The max number of events allowed in the pending write events queue
+  static constexpr size_t kMaxSizePendingWriteEventsQueue = 100000;
+
+  //! The size of the pending write events queue in number of event fmqs
+  static constexpr size_t kPendingWriteEventsQueueFmqCount = 16;
+
   /**
-   * A FIFO queue of pairs of vector of events and the number of wakeup events in that vector
-   * which are waiting to be written to the events fmq in the background thread.
+   * The events posted by the subhals, together with the number of wakeup events among them. They
+   * are queued without locking and written to the events fmq by the pending writes thread only.
+   * The queue is sized to the events fmq on initialize.
    */
-  std::queue<std::pair<std::vector<Event>, size_t>> mPendingWriteEventsQueue;
+  PendingWriteEventRing<Event> mPendingWriteEventsQueue;
 
   //! The most events observed on the pending write events queue for debug purposes.
-  size_t mMostEventsObservedPendingWriteEventsQueue = 0;
+  std::atomic<size_t> mMostEventsObservedPendingWriteEventsQueue = 0;
 
-  //! The max number of events allowed in the pending write events queue
-  static constexpr size_t kMaxSizePendingWriteEventsQueue = 100000;
+  //! The minimum time between two logs of events dropped on a full pending write events queue
+  static constexpr int64_t kDroppedEventsLogIntervalNs = 10 * INT64_C(1000000000) /* 10 seconds */;
+
+  //! The events dropped because the pending write events queue was full, for debug purposes.
+  std::atomic<uint64_t> mDroppedPendingWriteEvents = 0;
 
-  //! The number of events in the pending write events queue
-  size_t mSizePendingWriteEventsQueue = 0;
+  //! When events dropped on a full pending write events queue were last logged, 0 if never
+  std::atomic<int64_t> mLastDroppedEventsLogTime = 0;
 
-  //! The mutex protecting writing to the fmq and the pending events queue
+  //! The mutex the pending writes thread sleeps on while the pending events queue is empty
   std::mutex mEventQueueWriteMutex;
 
   //! The condition variable waiting on pending write events to stack up
   std::condition_variable mEventQueueWriteCV;
 
+  //! Whether the pending writes thread is about to wait or waits on mEventQueueWriteCV
+  std::atomic_bool mPendingWritesIdle = false;
+
   //! The thread object ptr that handles pending writes
   std::thread mPendingWritesThread;
 
@@ -241,6 +267,21 @@ private:
 
   const char* kWakelockName = "SensorsHAL_WAKEUP";
 
+  //! The property that selects lazy symbol binding when loading the subhal libraries.
+  static constexpr const char* kLazyBindingProperty = "vendor.sensors.multihal.lazy_binding";
+
+  //! The time the HalProxy was created at, for the startup timing.
+  const int64_t mCreateTimeNs = elapsedRealtimeNano();
+
+  //! The time spent loading the subhal libraries listed in the config file.
+  int64_t mSubHalLoadDurationNs = 0;
+
+  //! The time spent collecting the sensor lists of all subhals.
+  int64_t mSensorListDurationNs = 0;
+
+  //! Whether the time to the first getSensorsList call was logged already.
+  std::atomic_bool mSensorsListReported = false;
+
   /**
    * Initialize the list of SubHal objects in mSubHalList by reading from dynamic libraries
    * listed in a config file.
@@ -263,10 +304,25 @@ private:
    * kSubHalShareObjectLocations to get a handle for dlsym for a subhal.
    *
    * @param filename The file name to search for.
+   * @param dlopenFlags The flags passed to dlopen.
    *
    * @return The handle or nullptr if search failed.
    */
-  void* getHandleForSubHalSharedObject(const std::string& filename);
+  void* getHandleForSubHalSharedObject(const std::string& filename, int dlopenFlags);
+
+  /**
+   * Load a subhal from a dynamic library and wrap it. Called concurrently for all libraries
+   * listed in the config file, so it must not touch any member.
+   *
+   * @param subHalLibraryFile The file name of the library.
+   * @param dlopenFlags The flags passed to dlopen.
+   *
+   * @return The wrapped subhal or nullptr if loading failed.
+   */
+  std::shared_ptr<ISubHalWrapperBase> loadSubHal(const std::string& subHalLibraryFile, int dlopenFlags);
+
+  //! Log the time from construction to the first getSensorsList call, once.
+  void logFirstSensorsList();
 
   /**
    * Calls the helper methods that all ctors use.
@@ -347,14 +403,13 @@ private:
   bool isSubHalIndexValid(int32_t sensorHandle);
 
   /**
-   * Count the number of wakeup events in the first n events of the vector.
+   * Checks whether the event is from a wakeup sensor.
    *
-   * @param events The vector of Event objects.
-   * @param n The end index not inclusive of events to consider.
+   * @param event The Event object.
    *
-   * @return The number of wakeup events of the considered events.
+   * @return true if the sensor of the event is a wakeup sensor.
    */
-  size_t countNumWakeupEvents(const std::vector<Event>& events, size_t n);
+  bool isWakeupEvent(const Event& event);
 
   /*
    * Clear out the subhal index bytes from a sensorHandle.
@@ -20,6 +20,9 @@
 #include <android/hardware/sensors/2.1/types.h>
 #include <log/log.h>
 
+#include <memory>
+#include <vector>
+
 #include "V2_0/ScopedWakelock.h"
 #include "V2_0/SubHal.h"
 #include "V2_1/SubHal.h"
@@ -31,6 +34,35 @@ namespace sensors {
 namespace V2_0 {
 namespace implementation {
 
+/**
+ * Dense bitmap of the wakeup sensors of a subhal, indexed by the sensor handle without the
+ * subhal index byte.
+ */
+class WakeupSensorBitmap {
+public:
+  bool test(int32_t sensorHandle) const {
+    size_t index = static_cast<size_t>(sensorHandle & kSensorHandleMask);
+    return index / kBitsPerWord < mWords.size() && ((mWords[index / kBitsPerWord] >> (index % kBitsPerWord)) & 1);
+  }
+
+  void set(int32_t sensorHandle, bool isWakeup) {
+    size_t index = static_cast<size_t>(sensorHandle & kSensorHandleMask);
+    if (index / kBitsPerWord >= mWords.size()) {
+      if (!isWakeup) return;
+      mWords.resize(index / kBitsPerWord + 1);
+    }
+    uint64_t& word = mWords[index / kBitsPerWord];
+    uint64_t bit = UINT64_C(1) << (index % kBitsPerWord);
+    word = isWakeup ? (word | bit) : (word & ~bit);
+  }
+
+private:
+  static constexpr int32_t kSensorHandleMask = 0x00FFFFFF;
+  static constexpr size_t kBitsPerWord = 64;
+
+  std::vector<uint64_t> mWords;
+};
+
 /**
  * Interface used to communicate with the HalProxy when subHals interact with their provided
  * callback.
@@ -70,6 +102,16 @@ public:
    */
   virtual const V2_1::SensorInfo& getSensorInfo(int32_t sensorHandle) = 0;
 
+  /**
+   * Get the wakeup sensors of a subhal, including its connected dynamic sensors. The returned
+   * bitmap is immutable, connecting or disconnecting sensors replaces it.
+   *
+   * @param subHalIndex The index of the subhal.
+   *
+   * @return The bitmap of the wakeup sensors.
+   */
+  virtual std::shared_ptr<const WakeupSensorBitmap> getWakeupSensorBitmap(int32_t subHalIndex) = 0;
+
   virtual bool areThreadsRunning() = 0;
 };
 
@@ -93,7 +135,8 @@ protected:
   int32_t mSubHalIndex;
 
 private:
-  std::vector<V2_1::Event> processEvents(const std::vector<V2_1::Event>& events, size_t* numWakeupEvents) const;
+  const std::vector<V2_1::Event>& processEvents(const std::vector<V2_1::Event>& events,
+                                               size_t* numWakeupEvents) const;
 };
 
 class HalProxyCallbackV2_0 : public HalProxyCallbackBase, public V2_0::implementation::IHalProxyCallback {
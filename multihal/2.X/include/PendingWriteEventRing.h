@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+/**
+ * Fixed capacity FIFO staging the events of the subhals for the thread that writes them to the
+ * event fmq.
+ *
+ * Any number of producers push batches of events without taking a lock: a producer reserves
+ * its range of slots with a compare and swap on the tail, copies the events and publishes the
+ * batch by tagging the header slot at its start with its position. A single consumer collects
+ * the published batches in order, so a producer that is still copying only holds back the
+ * batches behind its own, never the other producers.
+ *
+ * The storage is only allocated when the capacity is set, so queueing a burst only copies the
+ * events. Without a capacity, every push fails. Instead of a wakeup flag per event, every batch
+ * header records its number of wakeup events, so the wakeup events of the popped events only
+ * have to be counted one by one when a batch with wakeup events is split.
+ */
+template <typename EventT>
+class PendingWriteEventRing {
+public:
+  explicit PendingWriteEventRing(size_t capacity = 0) { reset(capacity); }
+
+  size_t capacity() const { return mCapacity; }
+
+  /**
+   * Drops all queued events and reallocates the storage if the capacity changes. Consumer only,
+   * and must not race with producers.
+   */
+  void reset(size_t capacity) {
+    if (capacity != mCapacity) {
+      mEvents.reset(capacity > 0 ? new EventT[capacity] : nullptr);
+      mHeaders.reset(capacity > 0 ? new Header[capacity] : nullptr);
+      mCapacity = capacity;
+    }
+    clear();
+  }
+
+  /**
+   * Queues count events, numWakeupEvents of which are wakeup events. Thread safe.
+   *
+   * @return false if the events do not fit, in which case none of them is queued.
+   */
+  bool push(const EventT* events, size_t count, size_t numWakeupEvents) {
+    if (count == 0) {
+      return true;
+    }
+    uint64_t start = mTail.load(std::memory_order_relaxed);
+    do {
+      if (start + count - mFreed.load(std::memory_order_acquire) > mCapacity) {
+        return false;
+      }
+    } while (!mTail.compare_exchange_weak(start, start + count, std::memory_order_relaxed));
+
+    size_t index = start % mCapacity;
+    size_t first = std::min(count, mCapacity - index);
+    std::copy(events, events + first, mEvents.get() + index);
+    std::copy(events + first, events + count, mEvents.get());
+
+    Header& header = mHeaders[index];
+    header.numEvents = static_cast<uint32_t>(count);
+    header.numWakeupEvents = static_cast<uint32_t>(std::min(numWakeupEvents, count));
+    // Sequentially consistent, so that a consumer going idle either sees the batch or is seen
+    // idle by the producer
+    header.tag.store(start + 1);
+    return true;
+  }
+
+  /**
+   * Returns the number of events queued, including the ones still being pushed. Thread safe.
+   */
+  size_t getNumQueued() const {
+    return static_cast<size_t>(mTail.load(std::memory_order_relaxed) - mFreed.load(std::memory_order_relaxed));
+  }
+
+  /**
+   * Collects the batches published since the last call. Consumer only.
+   *
+   * @return The number of events collected and not popped yet.
+   */
+  size_t collect() {
+    while (mCapacity > 0) {
+      const Header& header = mHeaders[mCollected % mCapacity];
+      if (header.tag.load() != mCollected + 1) {
+        break;
+      }
+      mCollected += header.numEvents;
+    }
+    return size();
+  }
+
+  /**
+   * Returns the number of events collected and not popped yet. Consumer only.
+   */
+  size_t size() const { return static_cast<size_t>(mCollected - mHead); }
+
+  /**
+   * Returns the oldest collected events that are contiguous in memory and sets count to their
+   * number. Consumer only.
+   */
+  const EventT* front(size_t* count) const {
+    size_t index = mHead % mCapacity;
+    *count = std::min(size(), mCapacity - index);
+    return mEvents.get() + index;
+  }
+
+  /**
+   * Removes the count oldest collected events and frees their slots for the producers.
+   * isWakeup(event) is only called for the events of a batch with wakeup events that is removed
+   * partially. Consumer only.
+   *
+   * @return The number of wakeup events among the removed events.
+   */
+  template <class IsWakeup>
+  size_t pop(size_t count, IsWakeup isWakeup) {
+    size_t numWakeupEvents = 0;
+    count = std::min(count, size());
+    while (count > 0) {
+      if (mBatchEventsLeft == 0) {
+        const Header& header = mHeaders[mHead % mCapacity];
+        mBatchEventsLeft = header.numEvents;
+        mBatchWakeupEventsLeft = header.numWakeupEvents;
+      }
+      size_t numPopped = std::min(count, mBatchEventsLeft);
+      if (numPopped == mBatchEventsLeft) {
+        numWakeupEvents += mBatchWakeupEventsLeft;
+        mBatchWakeupEventsLeft = 0;
+      } else {
+        size_t numSplitWakeupEvents = 0;
+        for (size_t i = 0; i < numPopped && mBatchWakeupEventsLeft > 0; i++) {
+          numSplitWakeupEvents += isWakeup(mEvents[(mHead + i) % mCapacity]) ? 1 : 0;
+        }
+        numSplitWakeupEvents = std::min(numSplitWakeupEvents, mBatchWakeupEventsLeft);
+        numWakeupEvents += numSplitWakeupEvents;
+        mBatchWakeupEventsLeft -= numSplitWakeupEvents;
+      }
+      mBatchEventsLeft -= numPopped;
+      mHead += numPopped;
+      count -= numPopped;
+    }
+    mFreed.store(mHead, std::memory_order_release);
+    return numWakeupEvents;
+  }
+
+  /**
+   * Drops all queued events. Consumer only, and must not race with producers. Batches that are
+   * still being pushed are ignored when they are published.
+   */
+  void clear() {
+    mHead = mTail.load();
+    mCollected = mHead;
+    mBatchEventsLeft = 0;
+    mBatchWakeupEventsLeft = 0;
+    mFreed.store(mHead, std::memory_order_release);
+  }
+
+private:
+  struct Header {
+    // Position of the batch starting at this slot plus one, 0 if none was published yet
+    std::atomic<uint64_t> tag{0};
+    uint32_t numEvents = 0;
+    uint32_t numWakeupEvents = 0;
+  };
+
+  size_t mCapacity = 0;
+  std::unique_ptr<EventT[]> mEvents;
+  std::unique_ptr<Header[]> mHeaders;
+
+  // Positions count the events ever pushed and only grow, so a stale tag can not match
+  std::atomic<uint64_t> mTail{0};
+  std::atomic<uint64_t> mFreed{0};
+
+  // Consumer state
+  uint64_t mHead = 0;
+  uint64_t mCollected = 0;
+  size_t mBatchEventsLeft = 0;
+  size_t mBatchWakeupEventsLeft = 0;
+};
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
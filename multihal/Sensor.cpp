@@ -20,7 +20,9 @@
 #include <log/log.h>
 #include <utils/SystemClock.h>
 
-#include "iioHwctl.h"
+#include <algorithm>
+#include <memory>
+#include <new>
 
 namespace android {
 namespace hardware {
@@ -34,47 +36,80 @@ using ::android::hardware::sensors::V1_0::MetaDataEventType;
 using ::android::hardware::sensors::V1_0::OperationMode;
 using ::android::hardware::sensors::V1_0::Result;
 using ::android::hardware::sensors::V1_0::SensorFlagBits;
+using ::android::hardware::sensors::V1_0::SensorFlagShift;
 using ::android::hardware::sensors::V1_0::SensorStatus;
 using ::android::hardware::sensors::V2_1::Event;
 using ::android::hardware::sensors::V2_1::SensorInfo;
 using ::android::hardware::sensors::V2_1::SensorType;
 
 Sensor::Sensor(ISensorsEventCallback* callback)
-  : mIsEnabled(false), mSamplingPeriodNs(0), mLastSampleTimeNs(0), mCallback(callback) {
-  mRunThread = std::thread(startThread, this);
-}
+  : mIsEnabled(false), mMaxReportLatencyNs(0), mSamplingPeriodNs(0), mCallback(callback) {}
 
 Sensor::~Sensor() {
-  // Ensure that lock is unlocked before calling mRunThread.join() or a
-  // deadlock will occur.
-  {
-    std::unique_lock<std::mutex> lock(mRunMutex);
-    mStopThread = true;
-    mIsEnabled = false;
-    mWaitCV.notify_all();
+  if (mIioHub != nullptr) {
+    mIioHub->unsubscribe(this);
+    mIioHub->waitForDispatch(this);
+  } else {
+    ::rb::hardware::sensors::hwctl::SensorScheduler::get().remove(this);
   }
-  mRunThread.join();
 }
 
 const SensorInfo& Sensor::getSensorInfo() const { return mSensorInfo; }
 
-void Sensor::batch(int64_t samplingPeriodNs) {
+void Sensor::batch(int64_t samplingPeriodNs, int64_t maxReportLatencyNs) {
   samplingPeriodNs = std::clamp(samplingPeriodNs, static_cast<int64_t>(mSensorInfo.minDelay) * 1000,
                                 static_cast<int64_t>(mSensorInfo.maxDelay) * 1000);
 
+  std::unique_lock<std::mutex> lock(mRunMutex);
   if (mSamplingPeriodNs != samplingPeriodNs) {
     mSamplingPeriodNs = samplingPeriodNs;
-    // Wake up the 'run' thread to check if a new event should be generated now
-    mWaitCV.notify_all();
+    updateSampling();
   }
+  // Applied to the FIFO by the sampler with the next event
+  mMaxReportLatencyNs = maxReportLatencyNs;
 }
 
 void Sensor::activate(bool enable) {
   ALOGD("Sensor activate %s %d", mSensorInfo.name.c_str(), enable);
+  std::unique_lock<std::mutex> lock(mRunMutex);
   if (mIsEnabled != enable) {
-    std::unique_lock<std::mutex> lock(mRunMutex);
     mIsEnabled = enable;
-    mWaitCV.notify_all();
+    updateSampling();
+
+    if (!enable) {
+      // Only this final delivery may wait for an event write in progress
+      std::lock_guard<std::mutex> fifoLock(mFifoLock);
+      deliverFifo();
+    }
+  }
+}
+
+void Sensor::configDirectReport(const std::shared_ptr<::rb::hardware::sensors::hwctl::DirectChannel>& channel,
+                                int32_t reportToken, int64_t periodNs) {
+  if (periodNs > 0) {
+    periodNs = std::max(periodNs, static_cast<int64_t>(mSensorInfo.minDelay) * 1000);
+  }
+
+  std::unique_lock<std::mutex> lock(mRunMutex);
+  mDirectReports.configure(channel, reportToken, periodNs);
+  updateSampling();
+}
+
+void Sensor::updateSampling() {
+  int64_t samplingPeriodNs = mIsEnabled ? getSamplingPeriodNs() : 0;
+  int64_t directPeriodNs = mDirectReports.getPeriod();
+  if (directPeriodNs > 0 && (samplingPeriodNs == 0 || directPeriodNs < samplingPeriodNs)) {
+    samplingPeriodNs = directPeriodNs;
+  }
+
+  if (mIioHub == nullptr) {
+    // A period of 0 pauses the sensor
+    ::rb::hardware::sensors::hwctl::SensorScheduler::get().schedule(this, samplingPeriodNs);
+  } else if (samplingPeriodNs > 0) {
+    // Sensors backed by an IIO device are sampled by the hub of the device
+    mIioHub->subscribe(this, samplingPeriodNs);
+  } else {
+    mIioHub->unsubscribe(this);
   }
 }
 
@@ -85,59 +120,123 @@ Result Sensor::flush() {
     return Result::BAD_VALUE;
   }
 
-  // Note: If a sensor supports batching, write all of the currently batched
-  // events for the sensor to the Event FMQ prior to writing the flush complete
-  // event.
+  // Write all of the currently batched events for the sensor to the Event FMQ
+  // prior to writing the flush complete event.
   Event ev;
   ev.sensorHandle = mSensorInfo.sensorHandle;
   ev.sensorType = SensorType::META_DATA;
   ev.u.meta.what = MetaDataEventType::META_DATA_FLUSH_COMPLETE;
-  std::vector<Event> evs{ev};
-  mCallback->postEvents(evs, isWakeUpSensor());
+  std::lock_guard<std::mutex> fifoLock(mFifoLock);
+  size_t count = mFifo.size() + 1;
+  Event* events = mCallback->beginWrite(count);
+  if (events != nullptr) {
+    mFifo.drain(events);
+    new (&events[count - 1]) Event(ev);
+    mCallback->commitWrite(count, isWakeUpSensor());
+  } else {
+    mFifo.clear();
+  }
 
   return Result::OK;
 }
 
-void Sensor::startThread(Sensor* sensor) { sensor->run(); }
+void Sensor::onDeadline(int64_t /* deadlineNs */, int64_t /* nowNs */) {
+  if (mIsEnabled) {
+    size_t count = readEvents(mReadEvents.data(), mReadEvents.size());
+    report(mReadEvents.data(), count);
+  }
+}
 
-void Sensor::run() {
-  std::unique_lock<std::mutex> runLock(mRunMutex);
-  constexpr int64_t kNanosecondsInSeconds = 1000 * 1000 * 1000;
+void Sensor::report(const Event* events, size_t count) {
+  std::lock_guard<std::mutex> lock(mFifoLock);
+  applyReportLatency();
+  if (!mFifo.isBatching()) {
+    post(events, count);
+    return;
+  }
 
-  while (!mStopThread) {
-    if (!mIsEnabled) {
-      mWaitCV.wait(runLock, [&] { return (mIsEnabled || mStopThread); });
-    } else {
-      timespec curTime;
-      clock_gettime(CLOCK_BOOTTIME, &curTime);
-      int64_t now = (curTime.tv_sec * kNanosecondsInSeconds) + curTime.tv_nsec;
-      int64_t nextSampleTime = mLastSampleTimeNs + mSamplingPeriodNs;
+  bool isDue = false;
+  for (size_t i = 0; i < count; i++) {
+    isDue = mFifo.push(events[i], events[i].timestamp) || isDue;
+  }
+  if (isDue) {
+    deliverFifo();
+  }
+}
 
-      if (now >= nextSampleTime) {
-        mLastSampleTimeNs = now;
-        nextSampleTime = mLastSampleTimeNs + mSamplingPeriodNs;
-        mCallback->postEvents(readEvents(), isWakeUpSensor());
-      }
+void Sensor::post(const Event* events, size_t count) {
+  Event* slots = mCallback->beginWrite(count);
+  if (slots != nullptr) {
+    std::uninitialized_copy_n(events, count, slots);
+    mCallback->commitWrite(count, isWakeUpSensor());
+  }
+}
+
+void Sensor::deliverFifo() {
+  size_t count = mFifo.size();
+  if (count == 0) {
+    return;
+  }
+  Event* events = mCallback->beginWrite(count);
+  if (events == nullptr) {
+    mFifo.clear();
+    return;
+  }
+  mFifo.drain(events);
+  mCallback->commitWrite(count, isWakeUpSensor());
+}
 
-      mWaitCV.wait_for(runLock, std::chrono::nanoseconds(nextSampleTime - now));
+void Sensor::applyReportLatency() {
+  int64_t maxReportLatencyNs = mMaxReportLatencyNs;
+  if (mFifo.getMaxReportLatency() != maxReportLatencyNs) {
+    // Deliver what was batched with the previous configuration before applying
+    // the new one. The FIFO is only allocated once batching is requested.
+    deliverFifo();
+    if (maxReportLatencyNs > 0 && mFifo.getCapacity() == 0) {
+      mFifo.setCapacity(mSensorInfo.fifoMaxEventCount);
     }
+    mFifo.setMaxReportLatency(maxReportLatencyNs);
+  }
+}
+
+::rb::hardware::sensors::hwctl::PeriodicTimerStats Sensor::getSamplingStats() {
+  if (mIioHub != nullptr) {
+    return mIioHub->getStats();
   }
+  return ::rb::hardware::sensors::hwctl::SensorScheduler::get().getStats(this);
 }
 
 bool Sensor::isWakeUpSensor() { return mSensorInfo.flags & static_cast<uint32_t>(SensorFlagBits::WAKE_UP); }
 
-std::vector<Event> Sensor::readEvents() {
-  std::vector<Event> events;
-  Event event;
+size_t Sensor::readEvents(Event* events, size_t count) {
+  if (count == 0) {
+    return 0;
+  }
+  Event& event = events[0];
   event.sensorHandle = mSensorInfo.sensorHandle;
   event.sensorType = mSensorInfo.type;
   event.timestamp = ::android::elapsedRealtimeNano();
   event.u.vec3.x = 0;
   event.u.vec3.y = 0;
   event.u.vec3.z = 0;
-  readEventPayload(event.u);
-  events.push_back(event);
-  return events;
+  return 1;
+}
+
+uint32_t Sensor::getDirectReportFlags() const {
+  // Direct reports are written from the samples of the IIO hub
+  int32_t rateLevel = mIioHub != nullptr
+                        ? ::rb::hardware::sensors::hwctl::getMaxDirectRateLevel(mSensorInfo.minDelay * 1000LL)
+                        : ::rb::hardware::sensors::hwctl::kDirectRateStop;
+  if (rateLevel == ::rb::hardware::sensors::hwctl::kDirectRateStop) {
+    return 0;
+  }
+  return static_cast<uint32_t>(SensorFlagBits::DIRECT_CHANNEL_ASHMEM) |
+         (rateLevel << static_cast<uint8_t>(SensorFlagShift::DIRECT_REPORT));
+}
+
+int64_t Sensor::getSamplingPeriodNs() const {
+  // Use the slowest rate until the framework has configured the sensor
+  return mSamplingPeriodNs > 0 ? mSamplingPeriodNs : mSensorInfo.maxDelay * 1000LL;
 }
 
 bool Sensor::supportsDataInjection() const {
@@ -149,20 +248,58 @@ Result Sensor::injectEvent(const Event& event) {
   return Result::INVALID_OPERATION;
 }
 
-void Sensor::readEventPayload(EventPayload& payload) {
-  std::string values;
-  if (0 == ::rb::hardware::sensors::hwctl::readFromFile(&mIioFileName, values)) {
-    std::istringstream iss(values);
-    std::vector<std::string> results(std::istream_iterator<std::string>{iss}, std::istream_iterator<std::string>());
-    if (results.size() > 2) {
-      payload.vec3.x = ::atof(results[0].c_str()) * mSensorInfo.resolution;
-      payload.vec3.y = ::atof(results[1].c_str()) * mSensorInfo.resolution;
-      payload.vec3.z = ::atof(results[2].c_str()) * mSensorInfo.resolution;
-      payload.vec3.status = SensorStatus::ACCURACY_HIGH;
+void Sensor::onSample(const ::rb::hardware::sensors::hwctl::IioSample& sample) {
+  // Direct reports are written straight from the sampler, without going
+  // through the HalProxy
+  writeDirectReports(sample);
+  if (!mIsEnabled) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mFifoLock);
+  applyReportLatency();
+  if (mFifo.isBatching()) {
+    Event event;
+    fillEvent(event, sample);
+    if (mFifo.push(event, event.timestamp)) {
+      deliverFifo();
     }
+    return;
+  }
+
+  // Build the event directly in the event queue
+  Event* event = mCallback->beginWrite(1);
+  if (event != nullptr) {
+    fillEvent(*new (event) Event(), sample);
+    mCallback->commitWrite(1, isWakeUpSensor());
   }
 }
 
+void Sensor::fillEvent(Event& event, const ::rb::hardware::sensors::hwctl::IioSample& sample) {
+  event.sensorHandle = mSensorInfo.sensorHandle;
+  event.sensorType = mSensorInfo.type;
+  event.timestamp = sample.timestamp;
+  fillPayload(event.u, &sample.values[mIioSlot]);
+}
+
+void Sensor::writeDirectReports(const ::rb::hardware::sensors::hwctl::IioSample& sample) {
+  ::rb::hardware::sensors::hwctl::DirectReportEvent event = {};
+  event.type = static_cast<int32_t>(mSensorInfo.type);
+  event.timestamp = sample.timestamp;
+  event.u.vector.x = sample.values[mIioSlot] * mSensorInfo.resolution;
+  event.u.vector.y = sample.values[mIioSlot + 1] * mSensorInfo.resolution;
+  event.u.vector.z = sample.values[mIioSlot + 2] * mSensorInfo.resolution;
+  event.u.vector.status = static_cast<int8_t>(SensorStatus::ACCURACY_HIGH);
+  mDirectReports.write(event);
+}
+
+void Sensor::fillPayload(EventPayload& payload, const int64_t* data) {
+  payload.vec3.x = data[0] * mSensorInfo.resolution;
+  payload.vec3.y = data[1] * mSensorInfo.resolution;
+  payload.vec3.z = data[2] * mSensorInfo.resolution;
+  payload.vec3.status = SensorStatus::ACCURACY_HIGH;
+}
+
 }  // namespace implementation
 }  // namespace subhal
 }  // namespace V2_1
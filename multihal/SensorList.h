@@ -32,8 +32,10 @@ template <class SubHalVersion>
 class SensorsSubHal : public SubHalVersion {
 public:
   SensorsSubHal() {
-    ISensorsSubHalBase::AddSensor<bosch::sensors::Smi240Accel<Sensor, ISensorsEventCallback, SensorType>>();
-    ISensorsSubHalBase::AddSensor<bosch::sensors::Smi240Gyro<Sensor, ISensorsEventCallback, SensorType>>();
+    for (const auto& device : bosch::sensors::getSmi240Devices()) {
+      ISensorsSubHalBase::AddSensor<bosch::sensors::Smi240Accel<Sensor, ISensorsEventCallback, SensorType>>(device);
+      ISensorsSubHalBase::AddSensor<bosch::sensors::Smi240Gyro<Sensor, ISensorsEventCallback, SensorType>>(device);
+    }
   }
 };
 
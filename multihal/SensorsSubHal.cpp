@@ -18,6 +18,7 @@
 #include "SensorsSubHal.h"
 
 #include <log/log.h>
+#include <unistd.h>
 
 namespace android {
 namespace hardware {
@@ -30,19 +31,27 @@ using ::android::hardware::Void;
 using ::android::hardware::sensors::V1_0::OperationMode;
 using ::android::hardware::sensors::V1_0::RateLevel;
 using ::android::hardware::sensors::V1_0::Result;
+using ::android::hardware::sensors::V1_0::SensorFlagBits;
+using ::android::hardware::sensors::V1_0::SensorFlagShift;
+using ::android::hardware::sensors::V1_0::SharedMemFormat;
 using ::android::hardware::sensors::V1_0::SharedMemInfo;
+using ::android::hardware::sensors::V1_0::SharedMemType;
 using ::android::hardware::sensors::V2_0::SensorTimeout;
 using ::android::hardware::sensors::V2_0::WakeLockQueueFlagBits;
 using ::android::hardware::sensors::V2_0::implementation::ScopedWakelock;
 using ::android::hardware::sensors::V2_1::Event;
+using ::rb::hardware::sensors::hwctl::DirectChannel;
+using ::rb::hardware::sensors::hwctl::DirectReportEvent;
+using ::rb::hardware::sensors::hwctl::getDirectReportPeriodNs;
+using ::rb::hardware::sensors::hwctl::kDirectRateStop;
 
-ISensorsSubHalBase::ISensorsSubHalBase() : mCallback(nullptr), mNextHandle(1) {}
+ISensorsSubHalBase::ISensorsSubHalBase() : mCallback(nullptr), mNextChannelHandle(1) {}
 
 // Methods from ::android::hardware::sensors::V2_0::ISensors follow.
 Return<void> ISensorsSubHalBase::getSensorsList(V2_1::ISensors::getSensorsList_2_1_cb _hidl_cb) {
   std::vector<SensorInfo> sensors;
   for (const auto& sensor : mSensors) {
-    sensors.push_back(sensor.second->getSensorInfo());
+    sensors.push_back(sensor->getSensorInfo());
   }
 
   _hidl_cb(sensors);
@@ -58,58 +67,136 @@ Return<Result> ISensorsSubHalBase::setOperationMode(OperationMode mode) {
 }
 
 Return<Result> ISensorsSubHalBase::activate(int32_t sensorHandle, bool enabled) {
-  auto sensor = mSensors.find(sensorHandle);
-  if (sensor != mSensors.end()) {
-    sensor->second->activate(enabled);
+  auto* sensor = mSensors.find(sensorHandle);
+  if (sensor != nullptr) {
+    sensor->activate(enabled);
     return Result::OK;
   }
   return Result::BAD_VALUE;
 }
 
 Return<Result> ISensorsSubHalBase::batch(int32_t sensorHandle, int64_t samplingPeriodNs,
-                                         int64_t /* maxReportLatencyNs */) {
-  auto sensor = mSensors.find(sensorHandle);
-  if (sensor != mSensors.end()) {
-    sensor->second->batch(samplingPeriodNs);
+                                         int64_t maxReportLatencyNs) {
+  auto* sensor = mSensors.find(sensorHandle);
+  if (sensor != nullptr) {
+    sensor->batch(samplingPeriodNs, maxReportLatencyNs);
     return Result::OK;
   }
   return Result::BAD_VALUE;
 }
 
 Return<Result> ISensorsSubHalBase::flush(int32_t sensorHandle) {
-  auto sensor = mSensors.find(sensorHandle);
-  if (sensor != mSensors.end()) {
-    return sensor->second->flush();
+  auto* sensor = mSensors.find(sensorHandle);
+  if (sensor != nullptr) {
+    return sensor->flush();
   }
   return Result::BAD_VALUE;
 }
 
 Return<Result> ISensorsSubHalBase::injectSensorData(const Event& event) {
-  auto sensor = mSensors.find(event.sensorHandle);
-  if (sensor != mSensors.end()) {
-    return sensor->second->injectEvent(event);
+  auto* sensor = mSensors.find(event.sensorHandle);
+  if (sensor != nullptr) {
+    return sensor->injectEvent(event);
   }
 
   return Result::BAD_VALUE;
 }
 
-Return<void> ISensorsSubHalBase::registerDirectChannel(const SharedMemInfo& /* mem */,
+Return<void> ISensorsSubHalBase::registerDirectChannel(const SharedMemInfo& mem,
                                                        V2_0::ISensors::registerDirectChannel_cb _hidl_cb) {
-  _hidl_cb(Result::INVALID_OPERATION, -1 /* channelHandle */);
+  if (mem.type != SharedMemType::ASHMEM || mem.format != SharedMemFormat::SENSORS_EVENT) {
+    _hidl_cb(Result::INVALID_OPERATION, -1 /* channelHandle */);
+    return Return<void>();
+  }
+  if (mem.memoryHandle.getNativeHandle() == nullptr || mem.memoryHandle->numFds < 1 ||
+      mem.size < sizeof(DirectReportEvent)) {
+    _hidl_cb(Result::BAD_VALUE, -1 /* channelHandle */);
+    return Return<void>();
+  }
+
+  auto channel = std::make_shared<DirectChannel>(dup(mem.memoryHandle->data[0]), mem.size);
+  if (!channel->isValid()) {
+    _hidl_cb(Result::NO_MEMORY, -1 /* channelHandle */);
+    return Return<void>();
+  }
+
+  int32_t channelHandle;
+  {
+    std::lock_guard<std::mutex> lock(mDirectChannelLock);
+    channelHandle = mNextChannelHandle++;
+    mDirectChannels[channelHandle] = channel;
+  }
+  _hidl_cb(Result::OK, channelHandle);
   return Return<void>();
 }
 
-Return<Result> ISensorsSubHalBase::unregisterDirectChannel(int32_t /* channelHandle */) {
-  return Result::INVALID_OPERATION;
+Return<Result> ISensorsSubHalBase::unregisterDirectChannel(int32_t channelHandle) {
+  std::shared_ptr<DirectChannel> channel;
+  {
+    std::lock_guard<std::mutex> lock(mDirectChannelLock);
+    auto it = mDirectChannels.find(channelHandle);
+    if (it == mDirectChannels.end()) {
+      return Result::OK;
+    }
+    channel = it->second;
+    mDirectChannels.erase(it);
+  }
+
+  // The shared memory is unmapped once the last sensor has let go of it
+  for (const auto& sensor : mSensors) {
+    sensor->configDirectReport(channel, 0 /* reportToken */, 0 /* periodNs */);
+  }
+  return Result::OK;
 }
 
-Return<void> ISensorsSubHalBase::configDirectReport(int32_t /* sensorHandle */, int32_t /* channelHandle */,
-                                                    RateLevel /* rate */,
+Return<void> ISensorsSubHalBase::configDirectReport(int32_t sensorHandle, int32_t channelHandle, RateLevel rate,
                                                     V2_0::ISensors::configDirectReport_cb _hidl_cb) {
-  _hidl_cb(Result::INVALID_OPERATION, 0 /* reportToken */);
+  std::shared_ptr<DirectChannel> channel = getDirectChannel(channelHandle);
+  if (channel == nullptr) {
+    _hidl_cb(Result::BAD_VALUE, 0 /* reportToken */);
+    return Return<void>();
+  }
+
+  int32_t rateLevel = static_cast<int32_t>(rate);
+  if (sensorHandle == -1) {
+    // All sensors of a channel can only be stopped together
+    if (rateLevel != kDirectRateStop) {
+      _hidl_cb(Result::BAD_VALUE, 0 /* reportToken */);
+      return Return<void>();
+    }
+    for (const auto& sensor : mSensors) {
+      sensor->configDirectReport(channel, 0 /* reportToken */, 0 /* periodNs */);
+    }
+    _hidl_cb(Result::OK, 0 /* reportToken */);
+    return Return<void>();
+  }
+
+  auto* sensor = mSensors.find(sensorHandle);
+  if (sensor == nullptr) {
+    _hidl_cb(Result::BAD_VALUE, 0 /* reportToken */);
+    return Return<void>();
+  }
+  uint32_t flags = sensor->getSensorInfo().flags;
+  int32_t maxRateLevel = (flags & static_cast<uint32_t>(SensorFlagBits::MASK_DIRECT_REPORT)) >>
+                         static_cast<uint8_t>(SensorFlagShift::DIRECT_REPORT);
+  if (!(flags & static_cast<uint32_t>(SensorFlagBits::DIRECT_CHANNEL_ASHMEM)) || rateLevel > maxRateLevel) {
+    _hidl_cb(Result::BAD_VALUE, 0 /* reportToken */);
+    return Return<void>();
+  }
+
+  // The sensor handle is unique within a channel and serves as report token. A
+  // sensor may report to several channels, each at its own rate level.
+  sensor->configDirectReport(channel, sensorHandle, getDirectReportPeriodNs(rateLevel));
+  _hidl_cb(Result::OK, rateLevel != kDirectRateStop ? sensorHandle : 0 /* reportToken */);
   return Return<void>();
 }
 
+std::shared_ptr<DirectChannel> ISensorsSubHalBase::getDirectChannel(int32_t channelHandle) {
+  std::lock_guard<std::mutex> lock(mDirectChannelLock);
+  auto it = mDirectChannels.find(channelHandle);
+  return it != mDirectChannels.end() ? it->second : nullptr;
+}
+
 Return<void> ISensorsSubHalBase::debug(const hidl_handle& fd, const hidl_vec<hidl_string>& args) {
   if (fd.getNativeHandle() == nullptr || fd->numFds < 1) {
     ALOGE("%s: missing fd for writing", __FUNCTION__);
@@ -127,11 +214,15 @@ Return<void> ISensorsSubHalBase::debug(const hidl_handle& fd, const hidl_vec<hid
 
   std::ostringstream stream;
   stream << "Available sensors:" << std::endl;
-  for (auto sensor : mSensors) {
-    SensorInfo info = sensor.second->getSensorInfo();
+  for (const auto& sensor : mSensors) {
+    const SensorInfo& info = sensor->getSensorInfo();
     stream << "Name: " << info.name << std::endl;
     stream << "Min delay: " << info.minDelay << std::endl;
     stream << "Flags: " << info.flags << std::endl;
+    ::rb::hardware::sensors::hwctl::PeriodicTimerStats stats = sensor->getSamplingStats();
+    stream << "Achieved rate: " << stats.achievedRateHz << " Hz" << std::endl;
+    stream << "Lateness: mean " << stats.meanLatenessNs << " ns, max " << stats.maxLatenessNs << " ns" << std::endl;
+    stream << "Samples: " << stats.samples << ", skipped " << stats.skipped << std::endl;
   }
   stream << std::endl;
 
@@ -152,6 +243,21 @@ void ISensorsSubHalBase::postEvents(const std::vector<Event>& events, bool wakeu
   mCallback->postEvents(events, std::move(wakelock));
 }
 
+Event* ISensorsSubHalBase::beginWrite(size_t count) {
+  mStagingLock.lock();
+  if (mCallback == nullptr || count == 0) {
+    mStagingLock.unlock();
+    return nullptr;
+  }
+  mStaging.resize(count);
+  return mStaging.data();
+}
+
+void ISensorsSubHalBase::commitWrite(size_t /* count */, bool wakeup) {
+  std::lock_guard<std::mutex> lock(mStagingLock, std::adopt_lock);
+  postEvents(mStaging, wakeup);
+}
+
 }  // namespace implementation
 }  // namespace subhal
 }  // namespace V2_1
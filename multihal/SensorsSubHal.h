@@ -19,10 +19,14 @@
 
 #include <log/log.h>
 
+#include <map>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 #include "IHalProxyCallbackWrapper.h"
 #include "Sensor.h"
+#include "SensorTable.h"
 #include "V2_0/SubHal.h"
 #include "V2_1/SubHal.h"
 
@@ -75,20 +79,23 @@ public:
 
   // Method from ISensorsEventCallback.
   void postEvents(const std::vector<Event>& events, bool wakeup) override;
+  Event* beginWrite(size_t count) override;
+  void commitWrite(size_t count, bool wakeup) override;
 
 protected:
-  template <class SensorType>
-  void AddSensor() {
+  template <class SensorType, typename... Args>
+  void AddSensor(Args&&... args) {
     std::shared_ptr<SensorType> sensor =
-      std::make_shared<SensorType>(mNextHandle++ /* sensorHandle */, this /* callback */);
-    mSensors[sensor->getSensorInfo().sensorHandle] = sensor;
+      std::make_shared<SensorType>(mSensors.getNextHandle() /* sensorHandle */, this /* callback */,
+                                   std::forward<Args>(args)...);
+    mSensors.add(sensor);
     ALOGD("AddSensor[%d] %s", sensor->getSensorInfo().sensorHandle, sensor->getSensorInfo().name.c_str());
   }
 
   /**
-   * A map of the available sensors
+   * The available sensors, indexed by handle
    */
-  std::map<int32_t, std::shared_ptr<Sensor>> mSensors;
+  bosch::sensors::SensorTable<Sensor> mSensors;
 
   /**
    * Callback used to communicate to the HalProxy when dynamic sensors are
@@ -98,6 +105,8 @@ protected:
   std::unique_ptr<IHalProxyCallbackWrapperBase> mCallback;
 
 private:
+  std::shared_ptr<::rb::hardware::sensors::hwctl::DirectChannel> getDirectChannel(int32_t channelHandle);
+
   /**
    * The current operation mode of the multihal framework. Ensures that all
    * subhals are set to the same operation mode.
@@ -105,9 +114,19 @@ private:
   OperationMode mCurrentOperationMode = OperationMode::NORMAL;
 
   /**
-   * The next available sensor handle
+   * The registered direct channels and the next available channel handle,
+   * protected by mDirectChannelLock
+   */
+  std::map<int32_t, std::shared_ptr<::rb::hardware::sensors::hwctl::DirectChannel>> mDirectChannels;
+  int32_t mNextChannelHandle;
+  std::mutex mDirectChannelLock;
+
+  /**
+   * Events built by the sensors for the HalProxy callback, which takes a
+   * vector. It is reused so that no allocation is made per write.
    */
-  int32_t mNextHandle;
+  std::vector<Event> mStaging;
+  std::mutex mStagingLock;
 };
 
 template <class SubHalClass>
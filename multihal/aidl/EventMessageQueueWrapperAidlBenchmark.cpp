@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2023 Robert Bosch GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <iterator>
+#include <memory>
+#include <vector>
+
+#include "ConvertUtils.h"
+#include "EventMessageQueueWrapperAidl.h"
+
+using ::aidl::android::hardware::common::fmq::SynchronizedReadWrite;
+using ::aidl::android::hardware::sensors::implementation::convertToAidlEvent;
+using ::aidl::android::hardware::sensors::implementation::EventMessageQueueWrapperAidl;
+using ::android::AidlMessageQueue;
+using ::android::hardware::sensors::V1_0::MetaDataEventType;
+using ::android::hardware::sensors::V1_0::SensorStatus;
+using AidlEvent = ::aidl::android::hardware::sensors::Event;
+using V2_1Event = ::android::hardware::sensors::V2_1::Event;
+using V2_1SensorType = ::android::hardware::sensors::V2_1::SensorType;
+using AidlEventQueue = AidlMessageQueue<AidlEvent, SynchronizedReadWrite>;
+
+namespace {
+
+constexpr size_t kQueueSize = 256;
+
+/**
+ * Returns count events of a typical mix of streams: accelerometer and gyroscope samples interleaved
+ * with uncalibrated gyroscope, light and occasional flush completions.
+ */
+std::vector<V2_1Event> makeMixedEvents(size_t count) {
+  static const V2_1SensorType kTypes[] = {
+    V2_1SensorType::ACCELEROMETER, V2_1SensorType::GYROSCOPE,
+    V2_1SensorType::ACCELEROMETER, V2_1SensorType::GYROSCOPE,
+    V2_1SensorType::GYROSCOPE_UNCALIBRATED, V2_1SensorType::LIGHT,
+    V2_1SensorType::ACCELEROMETER, V2_1SensorType::GYROSCOPE,
+    V2_1SensorType::META_DATA,
+  };
+
+  std::vector<V2_1Event> events(count);
+  for (size_t i = 0; i < count; i++) {
+    V2_1Event& event = events[i];
+    event.timestamp = static_cast<int64_t>(i) * 2500000;
+    event.sensorHandle = static_cast<int32_t>(i % 4) + 1;
+    event.sensorType = kTypes[i % std::size(kTypes)];
+    switch (event.sensorType) {
+      case V2_1SensorType::META_DATA:
+        event.u.meta.what = MetaDataEventType::META_DATA_FLUSH_COMPLETE;
+        break;
+      case V2_1SensorType::LIGHT:
+        event.u.scalar = 100.0f;
+        break;
+      case V2_1SensorType::GYROSCOPE_UNCALIBRATED:
+        event.u.uncal.x = 0.1f;
+        event.u.uncal.y = 0.2f;
+        event.u.uncal.z = 0.3f;
+        event.u.uncal.x_bias = 0.01f;
+        event.u.uncal.y_bias = 0.02f;
+        event.u.uncal.z_bias = 0.03f;
+        break;
+      default:
+        event.u.vec3.x = 0.1f;
+        event.u.vec3.y = 0.2f;
+        event.u.vec3.z = 9.81f;
+        event.u.vec3.status = SensorStatus::ACCURACY_HIGH;
+        break;
+    }
+  }
+  return events;
+}
+
+}  // namespace
+
+/**
+ * The per-event path: every event is converted into an intermediate buffer, which the queue copies.
+ */
+static void BM_ConvertPerEvent(benchmark::State& state) {
+  size_t count = static_cast<size_t>(state.range(0));
+  std::vector<V2_1Event> events = makeMixedEvents(count);
+  std::vector<AidlEvent> intermediate(count);
+  std::vector<AidlEvent> received(count);
+  AidlEventQueue queue(kQueueSize, true /* configureEventFlagWord */);
+
+  for (auto _ : state) {
+    for (size_t i = 0; i < count; i++) {
+      convertToAidlEvent(events[i], &intermediate[i]);
+    }
+    queue.write(intermediate.data(), count);
+    queue.read(received.data(), count);
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+}
+
+/**
+ * The bulk path of EventMessageQueueWrapperAidl: the events are converted straight into the queue.
+ */
+static void BM_ConvertIntoQueue(benchmark::State& state) {
+  size_t count = static_cast<size_t>(state.range(0));
+  std::vector<V2_1Event> events = makeMixedEvents(count);
+  std::vector<AidlEvent> received(count);
+  auto queue = std::make_unique<AidlEventQueue>(kQueueSize, true /* configureEventFlagWord */);
+  AidlEventQueue* reader = queue.get();
+  EventMessageQueueWrapperAidl wrapper(queue);
+
+  for (auto _ : state) {
+    wrapper.write(events.data(), count);
+    reader->read(received.data(), count);
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+}
+
+BENCHMARK(BM_ConvertPerEvent)->Arg(1)->Arg(16)->Arg(64)->Arg(kQueueSize);
+BENCHMARK(BM_ConvertIntoQueue)->Arg(1)->Arg(16)->Arg(64)->Arg(kQueueSize);
+
+BENCHMARK_MAIN();
@@ -43,6 +43,14 @@ void convertToHidlEvent(const ::aidl::android::hardware::sensors::Event& aidlEve
 void convertToAidlEvent(const ::android::hardware::sensors::V2_1::Event& hidlEvent,
                         ::aidl::android::hardware::sensors::Event* aidlEvent);
 
+/**
+ * Populates count AIDL Event instances based on as many HIDL V2.1 Event instances. Every payload
+ * is written as a whole, so aidlEvents may point into the memory of an event FMQ, whose previous
+ * contents are never read.
+ */
+void convertToAidlEvents(const ::android::hardware::sensors::V2_1::Event* hidlEvents, size_t count,
+                         ::aidl::android::hardware::sensors::Event* aidlEvents);
+
 }  // namespace implementation
 }  // namespace sensors
 }  // namespace hardware
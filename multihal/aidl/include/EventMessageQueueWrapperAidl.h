@@ -52,25 +52,28 @@ public:
   }
 
   bool write(const ::android::hardware::sensors::V2_1::Event* events, size_t numToWrite) override {
-    for (int i = 0; i < numToWrite; ++i) {
-      convertToAidlEvent(events[i], &mIntermediateEventBuffer[i]);
-    }
-    return mQueue->write(mIntermediateEventBuffer.data(), numToWrite);
+    return convertIntoQueue(events, numToWrite);
   }
 
   virtual bool write(const std::vector<::android::hardware::sensors::V2_1::Event>& events) override {
-    for (int i = 0; i < events.size(); ++i) {
-      convertToAidlEvent(events[i], &mIntermediateEventBuffer[i]);
-    }
-    return mQueue->write(mIntermediateEventBuffer.data(), events.size());
+    return convertIntoQueue(events.data(), events.size());
   }
 
   bool writeBlocking(const ::android::hardware::sensors::V2_1::Event* events, size_t count, uint32_t readNotification,
                      uint32_t writeNotification, int64_t timeOutNanos,
                      ::android::hardware::EventFlag* evFlag) override {
-    for (int i = 0; i < count; ++i) {
-      convertToAidlEvent(events[i], &mIntermediateEventBuffer[i]);
+    if (evFlag != nullptr && mQueue->availableToWrite() >= count) {
+      // There is room already, so nothing to wait for
+      if (!convertIntoQueue(events, count)) {
+        return false;
+      }
+      if (writeNotification != 0) {
+        evFlag->wake(writeNotification);
+      }
+      return true;
     }
+
+    convertToAidlEvents(events, count, mIntermediateEventBuffer.data());
     return mQueue->writeBlocking(mIntermediateEventBuffer.data(), count, readNotification, writeNotification,
                                  timeOutNanos, evFlag);
   }
@@ -78,9 +81,26 @@ public:
   size_t getQuantumCount() override { return mQueue->getQuantumCount(); }
 
 private:
-  std::unique_ptr<::android::AidlMessageQueue<::aidl::android::hardware::sensors::Event,
-                                              ::aidl::android::hardware::common::fmq::SynchronizedReadWrite>>
-    mQueue;
+  using AidlEventQueue = ::android::AidlMessageQueue<::aidl::android::hardware::sensors::Event,
+                                                     ::aidl::android::hardware::common::fmq::SynchronizedReadWrite>;
+
+  /**
+   * Converts the events straight into the memory of the queue, without a copy through
+   * mIntermediateEventBuffer. Nothing is written if there is not enough room for all of them.
+   */
+  bool convertIntoQueue(const ::android::hardware::sensors::V2_1::Event* events, size_t count) {
+    AidlEventQueue::MemTransaction tx;
+    if (!mQueue->beginWrite(count, &tx)) {
+      return false;
+    }
+    const auto& first = tx.getFirstRegion();
+    const auto& second = tx.getSecondRegion();
+    convertToAidlEvents(events, first.getLength(), first.getAddress());
+    convertToAidlEvents(events + first.getLength(), second.getLength(), second.getAddress());
+    return mQueue->commitWrite(count);
+  }
+
+  std::unique_ptr<AidlEventQueue> mQueue;
   std::array<::aidl::android::hardware::sensors::Event,
              ::android::hardware::sensors::V2_1::implementation::MAX_RECEIVE_BUFFER_EVENT_COUNT>
     mIntermediateEventBuffer;